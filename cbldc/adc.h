@@ -0,0 +1,68 @@
+/*
+ * adc.h
+ *
+ * Single ADC conversions for current.h and battery.h.
+ *
+ * The comparator reaches the phases through the ADC mux, and only while the ADC is disabled.
+ * run() converts between a ZC and the commutation, nobody waits for a comparator edge then.
+ * Each conversion writes ADMUX and disables the ADC when it's done. acomp_set_R/S/T() at the
+ * commutation write the whole ADMUX again, with the same reference (ADC_REFS): the first
+ * conversion after a reference switch is off until AREF settles, so it never switches once the
+ * comparator has been set up at power-up.
+ */
+
+
+#ifndef ADC_H_
+#define ADC_H_
+
+#include <avr/io.h>
+#include "globals.h"
+#include "timer.h"
+
+// ADC clock F_CPU/16. The conversion after setting ADEN holds the input 13.5 ADC clocks after
+// the start and is done at 25. 1 MHz is too fast for 10 bits, the limits don't need them.
+#define ADC_ADPS ((1<<ADPS2)|(0<<ADPS1)|(0<<ADPS0))
+#define ADC_HOLD_TICKS (27 * 16 / 2 / TIMER_PRESCALER)
+#define ADC_CONV_TICKS (25 * 16 / TIMER_PRESCALER)
+#define ADC_MARGIN US_TO_TICKS(10)					// For the interrupts on the way
+
+#define ADC_USED (CURRENT_LIMIT && CURRENT_CHANNEL >= 0 || VOLTAGE_CHANNEL >= 0)
+
+// Reference bits of every ADMUX write, the internal 2.56 V if there are conversions at all
+#if ADC_USED
+#define ADC_REFS ((1<<REFS1)|(1<<REFS0))
+#else
+#define ADC_REFS 0
+#endif
+
+// Channel against the internal reference, 1024 = 2.56 V
+#define ADC_2V56(channel) ((1<<REFS1)|(1<<REFS0)|(channel))
+
+// Does a conversion starting at 'start' end well before 'until'?
+inline uint8_t adc_fits(uint16_t start, uint16_t until)
+{
+	return (int16_t)(until - start) >= ADC_CONV_TICKS + ADC_MARGIN;
+}
+
+// Converts with this ADMUX, starting at 'start', and disables the ADC again
+static uint16_t adc_convert(uint8_t admux, uint16_t start)
+{
+	ADMUX = admux;
+	timerA_wait_until(start);
+	ADCSRA = (1<<ADEN)|(1<<ADSC)|ADC_ADPS;
+	while (BIS(ADCSRA, ADSC));
+	uint16_t adc = ADCW;
+	ADCSRA = 0;
+	return adc;
+}
+
+// After acomp_init(), before the first conversion that counts. That one would be the first
+// after the switch to ADC_REFS, taken before AREF has settled, so it's done here and dropped.
+inline void adc_init()
+{
+	#if ADC_USED
+	adc_convert(ADC_2V56(15), timer_get());				// GND
+	#endif
+}
+
+#endif /* ADC_H_ */
@@ -0,0 +1,104 @@
+/*
+ * advance.h
+ *
+ * Timing advance as a function of speed and load, see TIMING_CURVE and TIMING_AUTOTUNE in bldc.h.
+ *
+ * The curve is a PROGMEM table of the delays from ZC to commutation, two rows (no load, full
+ * pwm_range) by ADVANCE_POINTS speeds, interpolated in both directions. run() asks for a new
+ * delay once per round of its background steps, the commutation path only multiplies by it.
+ *
+ * The auto-tune correction follows half the demag angle: the time from commutation until the
+ * floating phase, clamped to a rail while its current decays, shows the PRE-ZC state.
+ */
+
+
+#ifndef ADVANCE_H_
+#define ADVANCE_H_
+
+#include <avr/pgmspace.h>
+#include "bldc.h"
+#include "globals.h"
+
+// Advance angle [] to the delay from ZC to commutation, in 1/256 of the commutation time
+#define ADV(deg) ((30 - (deg)) * 128 / 30)
+
+#if TIMING_AUTOTUNE && !TIMING_CURVE
+	#error TIMING_AUTOTUNE corrects the timing curve, needs TIMING_CURVE
+#endif
+#if TIMING_AUTOTUNE_MAX < 0 || TIMING_AUTOTUNE_MAX > 20
+	#error Invalid constant: TIMING_AUTOTUNE_MAX. 0-20 allowed.
+#endif
+
+#if TIMING_CURVE
+
+	#define ADVANCE_RPS_SHIFT 8				// A point every 256 electrical rps (15360 eRPM)
+	#define ADVANCE_POINTS 9
+
+	// Written for TIMING_ADVANCE PROG_TIMNIG_MID. Above the last point it stays flat.
+	PROGMEM const uint8_t advance_lut[2][ADVANCE_POINTS] = {
+		{ADV(10), ADV(12), ADV(14), ADV(15), ADV(16), ADV(17), ADV(18), ADV(18), ADV(18)},	// No load
+		{ADV(14), ADV(16), ADV(18), ADV(19), ADV(20), ADV(21), ADV(22), ADV(22), ADV(22)}	// Full load
+	};
+
+	#if TIMING_AUTOTUNE
+		#define _ADV_TUNE_MAX (TIMING_AUTOTUNE_MAX * 128 / 30)
+		uint8_t _adv_tune;					// Auto-tune correction, in ADV() units
+	#endif
+
+	inline int16_t _adv_lerp(uint8_t a, uint8_t b, uint8_t w)
+	{
+		return a + mulsu_16_frac8((int16_t)b - a, w);
+	}
+
+	// Delay from ZC to commutation for this speed [rps] and power [pwm_set() units]
+	static uint8_t advance_get(uint16_t rps, uint16_t power)
+	{
+		uint8_t i = rps >> ADVANCE_RPS_SHIFT;
+		uint8_t w = (uint8_t)rps;
+		if (rps >= (ADVANCE_POINTS - 1) << ADVANCE_RPS_SHIFT) {
+			i = ADVANCE_POINTS - 2;
+			w = 255;
+		}
+		uint8_t load = power >= pwm_range? 255 : mul_16_frac8(power, load_frac);
+		int16_t low = _adv_lerp(pgm_read_byte(&advance_lut[0][i]), pgm_read_byte(&advance_lut[0][i + 1]), w);
+		int16_t high = _adv_lerp(pgm_read_byte(&advance_lut[1][i]), pgm_read_byte(&advance_lut[1][i + 1]), w);
+		int16_t delay = low + mulsu_16_frac8(high - low, load);
+
+		// The programmed timing shifts the curve
+		delay += (int16_t)cfg.timing_delay - ADV(TIMING_ADVANCE);
+		#if TIMING_AUTOTUNE
+			delay -= _adv_tune;
+		#endif
+		if (delay < 0) return 0;
+		if (delay > ADV(0)) return ADV(0);
+		return delay;
+	}
+
+#else
+
+	inline uint8_t advance_get(uint16_t rps, uint16_t power)
+	{
+		return cfg.timing_delay;
+	}
+
+#endif
+
+#if TIMING_AUTOTUNE
+
+	// Once per commutation. Steps the correction towards demag/2 [ticks], that is
+	// com_duration * _adv_tune / 256, one unit at a time.
+	inline void advance_demag(uint16_t demag, uint16_t com_duration)
+	{
+		if (demag / 2 > mul_16_frac8(com_duration, _adv_tune)) {
+			if (_adv_tune < _ADV_TUNE_MAX) _adv_tune++;
+		}
+		else if (_adv_tune) _adv_tune--;
+	}
+
+#else
+
+	inline void advance_demag(uint16_t demag, uint16_t com_duration) {}
+
+#endif
+
+#endif /* ADVANCE_H_ */
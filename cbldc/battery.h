@@ -0,0 +1,150 @@
+/*
+ * battery.h
+ *
+ * Battery voltage, see VOLTAGE_CHANNEL in the board file and the battery section of bldc.h.
+ *
+ * The cell count is taken once at power-up. While running, run() gives every
+ * _BATTERY_PERIOD-th ADC slot (see adc.h) to the voltage, the current gets the others. Samples
+ * are filtered and the rest is done in the lowest priority step of run(): the compensation
+ * factor for the throttle, and the low voltage cutoff. Under the cutoff the power is capped
+ * and the cap is lowered a bit with each sample, until the voltage is back over it.
+ */
+
+
+#ifndef BATTERY_H_
+#define BATTERY_H_
+
+#include <avr/io.h>
+#include "bldc.h"
+#include "globals.h"
+#include "adc.h"
+
+#define BATTERY_SENSE (VOLTAGE_CHANNEL >= 0)
+
+#if BATTERY_SENSE
+
+#define _BATTERY_PERIOD 16							// [commutations]
+#define _BATTERY_FILTER 3							// 1/8 of each sample
+#define _BATTERY_LVC_SHIFT 8						// Cap step, 1/256 of pwm_range
+#define _BATTERY_HYST_SHIFT 5						// Back over the cutoff by 1/32
+
+// Millivolts of the battery to ADC units, 1024 = 2.56 V on the pin
+#define _BATTERY_ADC(mv) ((mv) * 1L * VOLTAGE_SENSE_GAIN / 2500)
+
+#if _BATTERY_ADC(BATTERY_CELL_MAX) < 16
+	#error VOLTAGE_SENSE_GAIN is too low for the ADC
+#endif
+
+uint8_t battery_cells;
+uint16_t _battery_sum;								// Filtered, 1<<_BATTERY_FILTER samples
+uint16_t _battery_sample;
+uint8_t _battery_new;
+uint8_t _battery_slot;
+#if LVC_CELL_VOLTAGE
+uint16_t _battery_lvc;
+uint16_t _battery_cap;
+#endif
+#if VOLTAGE_COMPENSATION
+uint16_t _battery_nominal;
+uint16_t _battery_comp;								// nominal / actual, 8.8
+#endif
+
+// After calculate_globals() and adc_init(), the motor stopped. Counts the cells from the voltage now.
+static void __attribute__((optimize("s"))) battery_init()
+{
+	uint16_t adc = 0;
+	uint8_t i;
+	for (i = 0; i < 1<<_BATTERY_FILTER; i++) {
+		adc += adc_convert(ADC_2V56(VOLTAGE_CHANNEL), timer_get());
+	}
+	_battery_sum = adc;
+	adc >>= _BATTERY_FILTER;
+	battery_cells = (adc + _BATTERY_ADC(BATTERY_CELL_MAX) - 1) / _BATTERY_ADC(BATTERY_CELL_MAX);
+	if (!battery_cells) battery_cells = 1;
+	#if LVC_CELL_VOLTAGE
+	_battery_lvc = battery_cells * _BATTERY_ADC(LVC_CELL_VOLTAGE);
+	_battery_cap = pwm_range;
+	#endif
+	#if VOLTAGE_COMPENSATION
+	_battery_nominal = battery_cells * _BATTERY_ADC(VOLTAGE_NOMINAL_CELL);
+	_battery_comp = 256;
+	#endif
+}
+
+// pwm_range changed from old_range (config_apply()), the cap keeps its share of it
+static void battery_rescale(uint16_t old_range)
+{
+	#if LVC_CELL_VOLTAGE
+	_battery_cap = _battery_cap >= old_range? pwm_range : (uint32_t)_battery_cap * pwm_range / old_range;
+	#endif
+}
+
+// In the ADC slot after the ZC, the commutation at 'until'. 1 if it took the slot.
+static uint8_t battery_sample(uint16_t until)
+{
+	if (_battery_slot < _BATTERY_PERIOD - 1) {
+		_battery_slot++;
+		return 0;
+	}
+	uint16_t now = timer_get();
+	if (!adc_fits(now, until)) return 0;			// Try again at the next one
+	_battery_slot = 0;
+	_battery_sample = adc_convert(ADC_2V56(VOLTAGE_CHANNEL), now);
+	_battery_new = 1;
+	return 1;
+}
+
+// Lowest priority step of run()
+static void battery_update()
+{
+	if (!_battery_new) return;
+	_battery_new = 0;
+	_battery_sum += _battery_sample - (_battery_sum >> _BATTERY_FILTER);
+	uint16_t v = _battery_sum >> _BATTERY_FILTER;
+	#if VOLTAGE_COMPENSATION
+	_battery_comp = v > _battery_nominal >> 1? ((uint32_t)_battery_nominal << 8) / v : 512;
+	#endif
+	#if LVC_CELL_VOLTAGE
+	if (v < _battery_lvc) {
+		if (_battery_cap == pwm_range) motor_fault(FAULT_LVC);
+		uint16_t step = pwm_range >> _BATTERY_LVC_SHIFT;
+		_battery_cap = _battery_cap > step? _battery_cap - step : 0;
+	}
+	else if (v > _battery_lvc + (_battery_lvc >> _BATTERY_HYST_SHIFT) && _battery_cap < pwm_range) {
+		_battery_cap += pwm_range >> _BATTERY_LVC_SHIFT;
+		if (_battery_cap > pwm_range) _battery_cap = pwm_range;
+	}
+	#endif
+}
+
+// Throttle power for the voltage now, as it would be at VOLTAGE_NOMINAL_CELL
+inline uint16_t battery_compensate(uint16_t power)
+{
+	#if VOLTAGE_COMPENSATION
+	return mul_16_8_sum_frac8_sat16(power, _battery_comp >> 8, _battery_comp);
+	#else
+	return power;
+	#endif
+}
+
+inline uint16_t battery_limit(uint16_t power)
+{
+	#if LVC_CELL_VOLTAGE
+	return power > _battery_cap? _battery_cap : power;
+	#else
+	return power;
+	#endif
+}
+
+#else
+
+inline void battery_init() {}
+inline void battery_rescale(uint16_t old_range) {}
+inline uint8_t battery_sample(uint16_t until) { return 0; }
+inline void battery_update() {}
+inline uint16_t battery_compensate(uint16_t power) { return power; }
+inline uint16_t battery_limit(uint16_t power) { return power; }
+
+#endif
+
+#endif /* BATTERY_H_ */
@@ -128,6 +128,9 @@ static void beep_sound(uint16_t period, uint8_t time)
 	}		
 	do {
 		_noinline_timerA_wait_until(timer_get() + MS_TO_TICKS(10));
+		#if PWM_HARDWARE
+			wdt_reset();		// Done by the PWM interrupt otherwise
+		#endif
 	} while (--time);
 	pwm_set(0);
 	pwm_set_top(pwm_range);
@@ -36,10 +36,37 @@
 // Timing advance angle
 #define TIMING_ADVANCE PROG_TIMNIG_MID	// []
 
+// Speed and load dependent timing advance, the curve is in advance.h. TIMING_ADVANCE (or the
+// programmed timing) shifts the whole curve, which is written for PROG_TIMNIG_MID.
+// 0 - fixed TIMING_ADVANCE, 1 - curve.
+#define TIMING_CURVE 0
+
+// Adds half the demagnetization angle, measured at every commutation, to the advance.
+// Long demag times under heavy load mean the phase current lags, more advance brings it back.
+// Needs TIMING_CURVE 1.
+#define TIMING_AUTOTUNE 0
+#define TIMING_AUTOTUNE_MAX 10			// []
+
 // Percent of throttle allowed per 1000 RPM.
 // The point of it is to limit current at low speeds.
 #define THROT_PER_KRPM 15				// [%]
 
+// Bus current limit, 0 - off. Needs CURRENT_CHANNEL in the board file. run() samples the current
+// every 4th commutation and cuts the duty in proportion as soon as it's over, see current.h.
+// START_MODE 1 samples before every 4th forced commutation too. START_MODE 0 isn't limited,
+// START_MAX_POWER is.
+#define CURRENT_LIMIT 0				// [A]
+
+// Battery, needs VOLTAGE_CHANNEL in the board file. The cells are counted at power-up, up to
+// BATTERY_CELL_MAX each. Under LVC_CELL_VOLTAGE the power is ramped down while running, until the
+// voltage recovers (0 - no cutoff). VOLTAGE_COMPENSATION scales the throttle by
+// VOLTAGE_NOMINAL_CELL / actual cell voltage, so that it doesn't fade as the pack discharges.
+// Not with the governor, it keeps the speed by itself. See battery.h.
+#define BATTERY_CELL_MAX 4300			// [mV]
+#define LVC_CELL_VOLTAGE 3300			// [mV]
+#define VOLTAGE_COMPENSATION 0
+#define VOLTAGE_NOMINAL_CELL 3700		// [mV]
+
 #define THOTTLE_SPEED 14
 
 // Rotation direction (0/1)
@@ -48,9 +75,65 @@
 // Software programmed limit of motor speed, the ESC will limit energy above it, not to exceed it.
 #define RPM_MAX 300000					// [RPM]
 
+// ZC time from the Timer1 input capture. The comparator output drives the capture unit (ACIC),
+// and ICR1 holds the exact edge time, not TCNT1 as read by the interrupt after its latency.
+// 0 - off, 1 - on, 2 - on with the capture noise canceler (delays the edge by 4 clock cycles).
+// Not with INPUT_SIGNAL_TYPE 3, DShot needs the capture unit.
+#define ZC_INPUT_CAPTURE 0
+
+// Comparator events through a ring, see comparator.h, against the ringing around the ZC at high
+// speed. The interrupt queues every edge and stays on after the ZC, run() takes the ZC once the
+// comparator hasn't gone back to the PRE-ZC state for ZC_EVENT_FILTER. That delays each ZC by
+// the filter time, and the interrupt takes about 30 cycles more per edge. 0 - the ZC time alone.
+#define ZC_EVENT_RING 0
+#define ZC_EVENT_FILTER 4				// [us]
+
+// PWM synchronous ZC detection, against the ringing after the FET edges at low duty.
+// Below ZC_PWM_SAMPLING [%] duty, the PWM interrupt samples the comparator at the end of every
+// on-time, and the ZC is put halfway between the last sample before it and the first one after.
+// The comparator interrupt takes over above that duty, in the blinking modes, and when there
+// would be fewer than ZC_PWM_SAMPLES_MIN samples per commutation. 0 - off. Software PWM only.
+// The ZC is quantized to +-half a PWM period (about +-1.2 at 6500 eRPM and 16 kHz), so keep the
+// threshold at the lowest duty that actually sees false ZCs.
+#define ZC_PWM_SAMPLING 0				// [%]
+#define ZC_PWM_SAMPLES_MIN 4
+
+// ZC filter and next ZC prediction in run(), see predictor.h. 0 - two tap IIR, 1 - PLL tracking
+// the speed, 2 - PLL tracking the speed and the acceleration. Gains in 1/256.
+#define ZC_PREDICTOR 0
+#define ZC_PLL_KP 192
+#define ZC_PLL_KI 160
+#define ZC_PLL_KA 48
+
 // Blind angle from commutation to ZC scan.
 #define BLIND_ANGLE 5					// []
 
+// Demagnetization. After a commutation the floating phase stays clamped to a rail through a body
+// diode until its current has decayed, and the comparator shows the ZC state meanwhile. run() then
+// watches the comparator instead of trusting BLIND_ANGLE: the ZC scan starts once the PRE-ZC
+// state has been read DEMAG_FILTER times in a row. The time is reported in the telemetry and feeds
+// TIMING_AUTOTUNE. 0 - off, 1 - on.
+// If the phase is still clamped DEMAG_CUT_ANGLE before the ZC is due, about to hide it, the power
+// is cut until the ZC. Off by default: in the PWM off state the driven phases freewheel at the
+// upper rail, the clamped winding sees almost no voltage and its current decays slower than with
+// the power on. 0 - no cut.
+#define DEMAG_DETECTION 0
+#define DEMAG_FILTER 3
+#define DEMAG_CUT_ANGLE 0				// []
+
+// Commutation by the Timer1 compare A interrupt. After a ZC, run() only schedules the commutation,
+// the interrupt commutates and begins the ZC scan when BLIND_ANGLE has passed, and the background
+// steps go on meanwhile. With DEMAG_DETECTION the demagnetization ends at the PRE-ZC event of the
+// scan instead, DEMAG_FILTER and DEMAG_CUT_ANGLE are for the busy-waiting run() (0).
+// 0 - run() waits, 1 - interrupt.
+#define COMMUTATION_INTERRUPT 0
+
+// Commutation time to speed conversion (speed.h). 0 - lookup tables, SPEED_LUT_SPLIT and
+// SPEED_LUT_STEP of the board, about 1.5 KB of flash. 1 - Newton-Raphson reciprocal of speed.s,
+// about 220 bytes, but up to 300 cycles instead of 16 to 70. "make speedbench-run" in host/
+// compares the two.
+#define SPEED_RECIPROCAL 0
+
 // [DEFAULT] Brake enabled 
 // 0/1
 #define BRAKE_ENABLED 0
@@ -63,13 +146,10 @@
 // [DEFAULT] output PWM frequency
 #define PWM_FREQUENCY PROG_PWM_FREQ_2	// [Hz]
 
-// [DEFAULT] Use synchronous PWM
+// [DEFAULT] Use synchronous (complementary) PWM: the high FET of the PWM phase conducts in the off-state,
+// blinking modes included. The dead time between the two FETs is PWM_DEAD_TIME of the board.
 #define PWM_SYNCHRONOUS 0
 
-// Delay between turning one FET off and the other on in one bridge.
-// For Synchronous PWM only.
-#define PWM_DEAD_TIME 600				// [ns]
-
 
 
 // *------------------*
@@ -93,9 +173,60 @@
 #define RC_PWM_MAX 2200					// [us]
 
 // 
+#define RC_PWM_DEADBAND 0				// [us] Still stop that far above RC_PWM_LOW, 0 - off. The short pulses jitter by a few
 #define RC_PWM_BRAKE_THRESHOLD 60		// [us]
 #define RC_PWM_TIMEOUT 100				// [cs] (centiseconds! 1cs = 10ms)
 
+// Pulse protocol. 0 - detected from the first pulses after power-up or a signal loss, 1 - servo (1-2 ms),
+// 2 - OneShot125 (125-250 us), 3 - OneShot42 (42-84 us), 4 - Multishot (5-25 us).
+// The short pulses are scaled to the servo range, so the RC_PWM_ values above apply to all of them.
+// Anything but 1 times the edges with Timer0 too, and filters the pulses with a median of 3.
+// The detection gives no throttle until RC_PWM_DETECT_PULSES pulses in a row.
+#define RC_PWM_PROTOCOL 1
+#define RC_PWM_DETECT_PULSES 8			// Same protocol in a row to take it
+#define RC_PWM_FAST_TIMEOUT 10			// [cs] OneShot and Multishot
+
+// *------------------*
+// |      DShot       |
+// *------------------*
+// INPUT_SIGNAL_TYPE 3, the signal goes to the ICP1 pin (PB0).
+
+// DShot150 or DShot300. At 300 a frame can get lost when another interrupt delays the
+// input capture one, see signal.s. Such frames fail the checks and are dropped.
+#define DSHOT_RATE 150					// [kbit/s]
+#define DSHOT_TIMEOUT 10				// [cs]
+
+#define DSHOT_THROTTLE_MIN 48			// Lower values are stop (0) and commands, not supported
+#define DSHOT_RANGE (2047 - DSHOT_THROTTLE_MIN)
+
+// Bidirectional DShot: the frames come inverted, and the ESC answers each one on the same wire
+// with the electrical period, at 5/4 of the bit rate. The 21 bits of the reply take 56 us at
+// DShot300 (112 us at 150), driven edge by edge from the Timer1 compare B interrupt, which holds
+// the other interrupts for a few us around each edge. While the motor runs, the reply only goes
+// out if the next ZC is far enough, see run().
+#define DSHOT_TELEMETRY 0
+#define DSHOT_TELEMETRY_DELAY 30		// [us] After the frame, the flight controller turns its pin around
+#define DSHOT_TELEMETRY_WINDOW 300		// [us] Dropped if it can't start by then
+
+// *------------------*
+// |       I2C        |
+// *------------------*
+// INPUT_SIGNAL_TYPE 2, TWI slave on SDA (PC4) and SCL (PC5), up to 400 kHz. The address
+// (I2C_SLAVE_ADDRESS) and I2C_PROTOCOL come from the board file.
+// A write sets the throttle, 0 is stop. Protocol 1: one byte, 0-255. Protocol 2: the 8 high
+// bits, then optionally the 3 low bits in a second byte, 0-2047.
+// A read (after a repeated start, or on its own) returns 4 bytes: motor status, fault flags,
+// speed high byte, speed low byte. Speed is in electrical revolutions per second. The fault
+// flags are cleared by the read. See MOTOR_ and FAULT_ in globals.h.
+#define I2C_TIMEOUT 10					// [cs]
+#define I2C_RANGE (I2C_PROTOCOL == 1? 255 : 2047)
+
+// *------------------*
+// |  UART telemetry  |
+// *------------------*
+// UART_TELEMETRY in the board file, binary frames on TXD (PD1), 8N1. Frame layout in telemetry.h.
+// One byte goes out per pass of run()'s calculation steps, a frame never makes it wait.
+#define UART_BAUD 250000				// [bit/s] Within 2% of F_CPU/8/n
 
 // *------------------*
 // |     Start-up     |
@@ -107,6 +238,26 @@
 #define START_STEP_US 100				// [us]
 #define START_ATTEMPTS 4
 
+// Start engine. 0 - forced commutation from START_MIN_FORCED_RPM to START_MAX_FORCED_RPM with the
+// throttle clamped to START_MIN_POWER..START_MAX_POWER, run() after 71 ZCs.
+// 1 - align and ramp. The rotor is pulled to one state for START_ALIGN_MS, the power rising to
+// START_MIN_POWER over the first half. Then forced commutation at a constant START_RAMP_ACCEL up
+// to START_RAMP_RPM, the throttle clamped as in 0 and capped by CURRENT_LIMIT. A detected ZC sets
+// the pace of the next commutation, START_HANDOFF_ZCS consistent ZCs in a row hand over to run().
+#define START_MODE 0
+#define START_ALIGN_MS 40				// [ms]
+#define START_RAMP_ACCEL 10000			// [eRPM/s], 8520 at least at 16 MHz
+#define START_RAMP_RPM 6000				// [eRPM]
+#define START_HANDOFF_ZCS 12
+
+// Catch a motor that is still turning (windmilling, after a throttle cut or a failed start):
+// before each start attempt the power stage is switched off and the back-EMF of the three phases
+// is watched. START_CATCH_ZCS consistent ZCs in the set direction go straight to run(). One
+// START_CATCH_RPM commutation time without a ZC, or the wrong direction, and the start goes on.
+#define START_CATCH 0
+#define START_CATCH_RPM 1500			// [eRPM]
+#define START_CATCH_ZCS 6
+
 
 // *------------------*
 // |     GOVERNOR     |
@@ -23,6 +23,27 @@
 #define RC_PWM_PIN_INTERRUPT 1
 
 
+// PWM generator, see n11e2.h. OC2 (PB3) drives TH on this board.
+#define PWM_HARDWARE	0
+
+// UART telemetry, see n11e2.h. TXD (PD1) drives RH on this board.
+#define UART_TELEMETRY	0
+
+// Speed lookup tables, see n11e2.h
+#define SPEED_LUT_SPLIT	512				// [ticks]
+#define SPEED_LUT_STEP	128				// [ticks]
+
+// Complementary PWM dead time, see n11e2.h
+#define PWM_DEAD_TIME	600				// [ns]
+
+// Bus current sense, see n11e2.h. There's no shunt on this board.
+#define CURRENT_CHANNEL		-1
+#define CURRENT_SENSE_GAIN	50			// [mV/A]
+
+// Battery voltage divider, none either
+#define VOLTAGE_CHANNEL		-1
+#define VOLTAGE_SENSE_GAIN	100			// [mV/V]
+
 // Power stage control pins
 // phase R
 #define RL_PIN		PD4
@@ -18,6 +18,36 @@
 
 #define RC_PWM_CHANNEL	0
 
+// PWM generator. 0 - software PWM, the low MOSFET pins are toggled by the Timer2 compare interrupt.
+// 1 - hardware PWM, the OC2 pin (PB3) gates all the low MOSFET drivers and the low pins only
+// select the phase. Needs the board to be wired that way, OC2 is taken by LED0 here.
+#define PWM_HARDWARE	0
+
+// Binary telemetry on the USART transmitter, see telemetry.h. Needs TXD (PD1) free, it drives TH
+// here.
+#define UART_TELEMETRY	0
+
+// Speed lookup tables of speed.h: commutation times below SPEED_LUT_SPLIT are read directly, slower
+// ones interpolated between points SPEED_LUT_STEP apart. 2 bytes of flash per point, see
+// "make speedbench-run" in host/ for the error at this F_CPU.
+#define SPEED_LUT_SPLIT	512			// [ticks]
+#define SPEED_LUT_STEP	128			// [ticks]
+
+// Dead time of complementary PWM (PWM_SYNCHRONOUS in bldc.h): delay between turning one MOSFET
+// off and the other one on in a bridge. Depends on the gate drivers and MOSFETs of the board.
+#define PWM_DEAD_TIME	600			// [ns]
+
+// Bus current sense, see CURRENT_LIMIT in bldc.h. ADC channel of a shunt amplifier in the ground
+// return of the bridge, -1 if there's none (as here), and its output per amp, read against the
+// internal 2.56 V reference.
+#define CURRENT_CHANNEL		-1
+#define CURRENT_SENSE_GAIN	50			// [mV/A]
+
+// Battery voltage divider, see the battery section of bldc.h. ADC channel (-1 if none, as here)
+// and its voltage per battery volt, against the internal 2.56 V reference.
+#define VOLTAGE_CHANNEL		-1
+#define VOLTAGE_SENSE_GAIN	100			// [mV/V]
+
 // Power stage control pins
 // phase R
 #define RL_PIN			1			// Low MOSFET
@@ -22,6 +22,11 @@
 #include "commutation.h"
 #include "governor.h"
 #include "config.h"
+#include "advance.h"
+#include "predictor.h"
+#include "telemetry.h"
+#include "current.h"
+#include "battery.h"
 #include <util/delay.h>
 
 #if (TIMING_ADVANCE > 30) || (TIMING_ADVANCE < 0)
@@ -37,7 +42,7 @@ typedef struct {
 uint8_t check_signal(uint8_t state)
 {
 	uint8_t cnt = 4;
-	while (cnt) {
+	while (1) {
 		wdt_reset();
 		signal_process();
 		if (signal_error()) return 0;
@@ -120,17 +125,20 @@ static uint8_t program_menu_select(uint8_t low_sounds, uint8_t high_sounds, uint
 	return 0;
 }
 
+// Stores the setting and has loop() take it over, see config_request()
 static void program_store(config* cfg, uint8_t sounds)
 {
 	config_write(cfg, &_cfg_user);
+	config_request(cfg);
 	program_beep_n(sounds, F_TO_T(BEEP_A6), 10);
 	program_delay();
 	beep_play(&beep_prog_success);
 }
 
-static void program_menu(config* cfg)
+// One round of the menu, returns 0 if nothing was selected
+static uint8_t program_menu(config* cfg)
 {
-	uint8_t s;
+	uint8_t s, selected = 0;
 	
 	// Brake
 	// beep
@@ -141,6 +149,7 @@ static void program_menu(config* cfg)
 			default: SBI(cfg->flags, CFG_BRAKE); break;
 		}
 		program_store(cfg, s);
+		selected = 1;
 	}
 	
 	// Timing
@@ -153,6 +162,7 @@ static void program_menu(config* cfg)
 			default: cfg->timing_delay = (30-PROG_TIMNIG_HIGH)*128/30; break;
 		}
 		program_store(cfg, s);
+		selected = 1;
 	}
 	
 	// Governor
@@ -164,6 +174,7 @@ static void program_menu(config* cfg)
 			default: SBI(cfg->flags, CFG_GOVERNOR); break;
 		}
 		program_store(cfg, s);
+		selected = 1;
 	}
 	
 	// Rotation direction
@@ -175,6 +186,7 @@ static void program_menu(config* cfg)
 			default: SBI(cfg->flags, CFG_DIRECTION); break;
 		}
 		program_store(cfg, s);
+		selected = 1;
 	}
 	
 	// PWM frequency and mode
@@ -189,6 +201,7 @@ static void program_menu(config* cfg)
 			default: SBI(cfg->flags, CFG_SYNCHRO_PWM); break;
 		}
 		program_store(cfg, s);
+		selected = 1;
 	}
 	
 	// Reset to default settings
@@ -200,16 +213,20 @@ static void program_menu(config* cfg)
 			default: config_load_default(cfg);
 		}
 		program_store(cfg, s);
+		selected = 1;
 	}
+	return selected;
 }
 
-static void program(config* cfg)
+// The menu goes round until a round without a choice, then the motor can be started.
+// It works on a copy, cfg is replaced by loop() once the throttle is at 0.
+static void program(const config* cfg)
 {
 	if (program_wait_choice(1, 0, 0) == PROG_SELECTED) {
 		if (program_wait_choice(0, 2, 0) == PROG_TIMEOUT) {
-			while (1) {
-				program_menu(cfg);
-			}
+			config c;
+			memcpy((void*)&c, (void*)cfg, sizeof(config));
+			while (program_menu(&c));
 		}
 	}
 }
@@ -340,6 +357,197 @@ static uint8_t __attribute__((optimize("s"))) start(const start_config* sc, timi
 	}
 }
 
+#if START_MODE == 1
+
+#if START_RAMP_RPM < 1000 || START_RAMP_RPM > 30000 || START_HANDOFF_ZCS < 2
+	#error Invalid constant: START_RAMP_RPM or START_HANDOFF_ZCS
+#endif
+
+// Forced commutations at START_RAMP_RPM without a ZC, then the start has failed
+#define START_RAMP_FAILS 36
+
+#define START_RAMP_COM_MIN RPM_TO_COM_TIME(START_RAMP_RPM)
+
+// The ramp is the stepper motor one: c(n) = c(n-1) - 2 * c(n-1) / (4n + 1), from
+// c(0) = 0.676 * sqrt(2 / acceleration) [s], the acceleration in commutations/s^2 (eRPM/s / 10).
+// In ticks * 256. c is about c(0) / (2 * sqrt(n)), so n = START_RAMP_N_K / c^2 for a given c.
+#define START_RAMP_C0 ((uint32_t)(0.676 * 256 * TICKS_PER_SECOND * sqrt(20.0 / START_RAMP_ACCEL)))
+#define START_RAMP_N_K ((uint32_t)((float)(START_RAMP_C0 >> 8) * (START_RAMP_C0 >> 8) / 4))
+
+// The first commutation time must fit 16 bits, the windows are timed on the 32 bit timerAX.
+// Not for the preprocessor, because of sqrt().
+_Static_assert((START_RAMP_C0 >> 8) <= 0xFFFF, "Invalid constant: START_RAMP_ACCEL. Too low");
+
+// Align and ramp, see START_MODE in bldc.h
+static uint8_t __attribute__((optimize("s"))) start_ramp(timing* t)
+{
+	uint32_t time = timerAX_get();
+	uint8_t i;
+	
+	// Align, the power rising in 16 steps
+	commutate();
+	for (i = 1; i <= 32; i++) {
+		if (i <= 16) pwm_set(pwm_start_min * i / 16);
+		time += MS_TO_TICKS(START_ALIGN_MS) / 32;
+		timerAX_set(time);
+		while (!timerAX_ready()) wdt_reset();
+		signal_process();
+		if (signal_get_power() == 0) {
+			pwm_set(0);
+			return STARTUP_NOSIG;
+		}
+	}
+	
+	uint32_t c = START_RAMP_C0;
+	uint16_t n = 0;
+	uint16_t com_time = c >> 8;
+	uint16_t previous_delta = 0;
+	uint8_t ok = 0;
+	uint8_t fails = 0;
+	current_init();
+	while (1) {
+		#if CURRENT_SENSE
+		// The ADC is free until the commutation, see current.h. Waiting for the sample delays it
+		// by up to two PWM periods, every _CURRENT_PERIOD commutations.
+		current_sample(timer_get() + 2 * (pwm_get_top() / TIMER_PRESCALER) + ADC_CONV_TICKS + ADC_MARGIN);
+		#endif
+		commutate();
+		wdt_reset();
+		signal_process();
+		uint16_t power = signal_get_power();
+		if (power == 0) {
+			pwm_set(0);
+			return STARTUP_NOSIG;
+		}
+		// The throttle within START_MIN_POWER..START_MAX_POWER, as in start(), then the current cap
+		start_set_power(power);
+		#if CURRENT_SENSE
+		if (pwm_get() > current_limit(pwm_get())) pwm_set(current_limit(pwm_get()));
+		#endif
+		
+		// Forced commutation at com_time. After a ZC the next one is due in about the same time,
+		// waiting at most twice that (but half of com_time at least) limits the damage of a false ZC.
+		uint32_t window = com_time;
+		if (ok) {
+			window += com_time >> 1;
+			if (window > 2 * (uint32_t)previous_delta) window = 2 * (uint32_t)previous_delta;
+			if (window < com_time >> 1) window = com_time >> 1;
+		}
+		uint8_t zc = start_wait_for_zc(time + window);
+		uint32_t zc_time = timerAX_get();
+		uint32_t elapsed = zc_time - time;
+		uint16_t delta = elapsed > 0xFFFF? 0xFFFF : elapsed;
+		time = zc_time;
+		if (zc) {
+			
+			// Taken as consistent within 1/4 of the previous commutation
+			if (ok && (uint16_t)(delta - previous_delta + (previous_delta >> 2)) <= (previous_delta >> 1)) {
+				fails = 0;
+				if (++ok >= START_HANDOFF_ZCS) {
+					t->previous_zc_time = zc_time;
+					t->predicted_zc_time = zc_time + delta;
+					t->com_duration = delta;
+					return STARTUP_OK;
+				}
+				
+				// The ramp goes on from the measured speed
+				com_time = delta;
+				c = (uint32_t)delta << 8;
+				n = START_RAMP_N_K / ((uint32_t)delta * delta);
+			}
+			else ok = 1;
+			previous_delta = delta;
+			
+			#if BLIND_ANGLE
+			_noinline_timerA_wait_until((uint16_t)zc_time + mul_16_frac8(delta, BLIND_ANGLE*128/30));
+			#endif
+		}
+		else {
+			ok = 0;
+			if (com_time <= START_RAMP_COM_MIN && ++fails >= START_RAMP_FAILS) {
+				pwm_set(0);
+				return STARTUP_FAIL;
+			}
+			n++;
+			c -= 2 * c / (4 * n + 1);
+			com_time = c >> 8;
+			if (com_time < START_RAMP_COM_MIN) {
+				com_time = START_RAMP_COM_MIN;
+				c = (uint32_t)com_time << 8;
+			}
+		}
+	}
+}
+
+#endif
+
+#if START_CATCH
+
+#if START_CATCH_RPM < 500 || START_CATCH_ZCS < 2 || START_CATCH_ZCS > 60
+	#error Invalid constant: START_CATCH_RPM or START_CATCH_ZCS
+#endif
+
+#define START_CATCH_COM_MAX RPM_TO_COM_TIME(START_CATCH_RPM)
+
+// Catch a spinning motor, see START_CATCH in bldc.h. STARTUP_FAIL if it isn't spinning right.
+static uint8_t __attribute__((optimize("s"))) start_catch(timing* t)
+{
+	uint8_t backward = BIS(cfg.flags, CFG_DIRECTION);
+	uint8_t left = 3 * START_CATCH_ZCS;
+	uint8_t ok = 0;
+	uint16_t previous_delta = 0;
+	pwm_set(0);
+	power_stage_off();
+	CBI(ACSR, ACIE);
+	uint8_t sector = commutation_sector(acomp_phases());
+	uint16_t time = timer_get();
+	while (1) {
+		wdt_reset();
+		
+		// The sectors are the phase states read twice in a row
+		uint8_t s = commutation_sector(acomp_phases());
+		uint16_t now = timer_get();
+		if (s == sector || s != commutation_sector(acomp_phases())) {
+			if ((uint16_t)(now - time) >= START_CATCH_COM_MAX) break;
+			continue;
+		}
+		uint16_t delta = now - time;
+		time = now;
+		
+		// A ZC: one sector on in the set direction, in about the time of the previous one
+		uint8_t next = backward? (sector == 0? 5 : sector - 1) : (sector == 5? 0 : sector + 1);
+		sector = s;
+		if (s != next) ok = 0;
+		else if (ok && (uint16_t)(delta - previous_delta + (previous_delta >> 2)) > (previous_delta >> 1)) ok = 1;
+		else if (++ok > START_CATCH_ZCS) {
+			commutation_seed(sector);
+			t->previous_zc_time = time;
+			t->predicted_zc_time = time + delta;
+			t->com_duration = delta;
+			return STARTUP_OK;
+		}
+		previous_delta = delta;
+		if (--left == 0) break;
+	}
+	commutation_init();
+	return STARTUP_FAIL;
+}
+
+#endif
+
+// One start attempt
+static uint8_t start_motor(timing* t)
+{
+	#if START_CATCH
+	if (start_catch(t) == STARTUP_OK) return STARTUP_OK;
+	#endif
+	#if START_MODE == 1
+	return start_ramp(t);
+	#else
+	return start(&sc_default, t);
+	#endif
+}
+
 
 // *-------------------------------------------*
 // |                    Run                    |
@@ -354,13 +562,14 @@ static uint16_t run_calculate_power(uint16_t speed)
 	uint16_t throt_inertia = pwm_get()+THOTTLE_SPEED;
 	if (limit >= throt_inertia) limit = throt_inertia;
 	if (limit >= pwm_range) limit = pwm_range;
+	limit = battery_limit(limit);
 	if (speed >= RPM_MAX/60) limit >>= 1;
 	uint16_t power;
 	if (flag_is_set(flagsB, GOVERNOR)) {
 		power = governor_get_power();
 	}
 	else {
-		power = signal_get_power();
+		power = battery_compensate(signal_get_power());
 	}
 	if (power >= limit) power = limit;
 	return power;
@@ -373,15 +582,33 @@ uint8_t __attribute__((optimize("2"))) run(const timing* t)
 	static int8_t zc_timeout;
 	static uint16_t power;
 	static uint16_t rps;
+	static uint8_t timing_delay;
+	#if TIMING_AUTOTUNE || DEMAG_DETECTION
+	static uint16_t com_time;
+	#endif
+	#if DEMAG_DETECTION
+	static uint8_t demag_cut;
+	#endif
 	uint16_t com_duration = t->com_duration;
 	uint16_t previous_zc_time = t->previous_zc_time;
 	rps = com_time_to_rps(com_duration);
+	motor_set_speed(com_duration, rps);
+	predictor_init(previous_zc_time, com_duration);
+	timing_delay = advance_get(rps, pwm_get());
+	#if ZC_PRE_ZC_TIME
+	com_time = previous_zc_time;
+	#endif
+	#if DEMAG_DETECTION
+	demag_cut = 0;
+	#endif
 	calculation_step = 0;
 	zc_timeout = 0;
+	current_init();
 	commutate();
 	zc_run_begin(); // <- opt
 	governor_begin(pwm_get());
-	timerA_set(t->predicted_zc_time+com_duration);
+	zc_timeout_set(t->predicted_zc_time+com_duration);
+	commutation_int_enable();
 	//LED0_0;
 	while (1) {
 		uint16_t zc_time;
@@ -400,9 +627,16 @@ uint8_t __attribute__((optimize("2"))) run(const timing* t)
 			switch (++calculation_step) {
 				case 1:
 					signal_process();
+					#if SIGNAL_TELEMETRY
+					/* Reply only if it ends 15 before the ZC is due, not while waiting past a missed one */
+					if (!zc_timeout) signal_telemetry(zc_timeout_remaining() - (com_duration >> 2));
+					#endif
 					if (flag_is_set(flagsB, SIGNAL_RECEIVED)) {
 						clear_flag(flagsB, SIGNAL_RECEIVED);
-						if (signal_brake()) return RUN_BRAKE;					
+						if (signal_brake()) {
+							commutation_int_disable();
+							return RUN_BRAKE;
+						}
 					}
 					else {
 						calculation_step = 4;
@@ -414,6 +648,10 @@ uint8_t __attribute__((optimize("2"))) run(const timing* t)
 					break;
 					
 				case 3:
+					power = current_limit(power);
+					#if DEMAG_DETECTION
+					if (demag_cut) break;
+					#endif
 					if (zc_timeout != 2) pwm_set(power);
 					break;
 					
@@ -423,18 +661,30 @@ uint8_t __attribute__((optimize("2"))) run(const timing* t)
 						governor_process_feedback(rps);
 					}
 					else {
-						calculation_step = 0;
+						calculation_step = 6;
 					}
 					break;
 				case 5:
 					governor_process_error(signal_get_power());
 					break;	
-				default:
+				case 6:
 					governor_process_pid();
+					break;
+				
+				/* Lowest priority, once per round */
+				default:
+					timing_delay = advance_get(rps, power);
+					telemetry_step();
+					battery_update();
 					calculation_step = 0;
 					break;
 			}
 			
+			#if COMMUTATION_INTERRUPT
+			/* The commutation or the blind time is still ahead, the ZC scan begins after them */
+			if (!commutation_int_scan()) continue;
+			#endif
+			
 			/* If comparator has detected ZC*/
 			if (zc_run_detected()) {
 				zc_time = zc_run_time();
@@ -442,7 +692,7 @@ uint8_t __attribute__((optimize("2"))) run(const timing* t)
 			}			
 			
 			/* If ZC timeout occurred*/
-			if (timerA_ready()) {
+			if (zc_timeout_ready()) {
 				
 				/* Check if we are still waiting for PRE-ZC state on the comparator.*/
 				if (flag_is_set(flagsB, AWAIT_PRE_ZC)) {
@@ -455,6 +705,7 @@ uint8_t __attribute__((optimize("2"))) run(const timing* t)
 					pwm_set(0);
 					zc_timeout = 2;
 					zc_time = previous_zc_time + com_duration;
+					telemetry_no_pre_zc();
 					break;
 				}
 				
@@ -463,43 +714,107 @@ uint8_t __attribute__((optimize("2"))) run(const timing* t)
 					if (!zc_timeout) {
 						/* If it's just the 60 timeout, let's wait 180 more degrees */
 						zc_timeout = 1;
-						timerA_set(previous_zc_time + com_duration * 4);
+						zc_timeout_set(previous_zc_time + com_duration * 4);
+						telemetry_zc_late();
 					}
 					/* If 4 commutation lengths have passed since the previous ZC, the motor must have stopped. Return. */
-					else return RUN_TIMEOUT;				
+					else {
+						commutation_int_disable();
+						return RUN_TIMEOUT;
+					}
 				}
 			}
 		}
 		
+		#if ZC_PRE_ZC_TIME
+		/* No PRE-ZC state for the whole commutation counts as demag all the way */
+		if (zc_timeout != 1) {
+			uint16_t demag = zc_timeout? com_duration : zc_run_pre_zc_delay(com_time);
+			advance_demag(demag, com_duration);
+			#if DEMAG_DETECTION
+			telemetry_demag(demag, 0);
+			#endif
+		}
+		#endif
 		zc_timeout = 0;
+		#if DEMAG_DETECTION
+		demag_cut = 0;
+		#endif
 		
 		/* ZC has been detected.
-		Filter ZC time, using simple IIR. */
-		uint16_t delta = zc_time - previous_zc_time;
-		com_duration += delta;
-		com_duration /= 2;
-		zc_time = previous_zc_time + com_duration;
-		uint16_t timing_interval = mul_16_frac8(com_duration, cfg.timing_delay);
+		Filter ZC time and predict the next one. */
+		zc_time = predictor_update(zc_time);
+		com_duration = predictor_period();
+		uint16_t timing_interval = mul_16_frac8(com_duration, timing_delay);
+		#if !COMMUTATION_INTERRUPT
 		timerA_set(zc_time + timing_interval);
+		#endif
+		#if TIMING_AUTOTUNE || DEMAG_DETECTION
+		com_time = zc_time + timing_interval;
+		#endif
 		previous_zc_time = zc_time;
 		uint16_t next_zc_timeout = zc_time + com_duration;
-		rps = com_time_to_rps(com_duration);		
+		telemetry_commutation(com_duration);
+		
+		// The ADC is free until the commutation, the battery voltage takes a turn now and then
+		if (!battery_sample(zc_time + timing_interval)) current_sample(zc_time + timing_interval);
+		
+		#if COMMUTATION_INTERRUPT
+		
+		// The interrupt commutates, the loop above begins the ZC scan, the ZC timeout follows
+		#if BLIND_ANGLE
+		uint16_t zc_scan_start = zc_time + mul_16_frac8(com_duration, BLIND_ANGLE*128/30);
+		#else
+		uint16_t zc_scan_start = zc_time;
+		#endif
+		commutation_int_schedule(zc_time + timing_interval, zc_scan_start, next_zc_timeout);
+		
+		// The speed once the commutation is scheduled, SPEED_RECIPROCAL takes a while
+		rps = com_time_to_rps(com_duration);
+		motor_set_speed(com_duration, rps);
+		wdt_reset();
+		
+		#else
 		
 		// Wait until it's time to commutate
 		timerA_wait_ready();
 		commutate();
 		wdt_reset();
 		
+		// The speed in the blind time rather than before the commutation, SPEED_RECIPROCAL takes a while
+		rps = com_time_to_rps(com_duration);
+		motor_set_speed(com_duration, rps);
+		
 		#if BLIND_ANGLE
 		uint16_t zc_scan_start = zc_time + mul_16_frac8(com_duration, BLIND_ANGLE*128/30);
 		timerA_wait_until(zc_scan_start);
 		#endif
 		
+		#if DEMAG_DETECTION
+		/* Wait for the floating phase to leave the rail. Still clamped DEMAG_CUT_ANGLE before the ZC:
+		cut the power, the current would only grow, and wait until the ZC is due. Past that it must
+		have been hidden. The commutation is at least 30 before the ZC. */
+		#if DEMAG_CUT_ANGLE
+		if (!acomp_demag_wait(next_zc_timeout - mul_16_frac8(com_duration, DEMAG_CUT_ANGLE*256/60))) {
+			pwm_set(0);
+			demag_cut = 1;
+			acomp_demag_wait(next_zc_timeout);
+		}
+		#else
+		acomp_demag_wait(next_zc_timeout);
+		#endif
+		uint16_t demag = timer_get() - com_time;
+		advance_demag(demag, com_duration);
+		telemetry_demag(demag, demag_cut);
+		#endif
+		
 		// Begin background ZC scan
 		zc_run_begin();
 		
 		// Set the ZC detection timeout, as this ZC time + commutation length.
-		timerA_set(next_zc_timeout);
+		zc_timeout_set(next_zc_timeout);
+		
+		#endif
 	}
 }
 
@@ -509,10 +824,15 @@ uint8_t __attribute__((optimize("2"))) run(const timing* t)
 
 static void brake_motor()
 {
+	motor_status = MOTOR_BRAKING;
 	cli();
 	RH_off();
 	SH_off();
 	TH_off();
+	pwm_dead_time();				// Before the low FETs go on
+	#if PWM_HARDWARE
+		pwm_set(pwm_get_top());		// Keep the low FET gate open, the loop below does the PWM
+	#endif
 	uint16_t time = timer_get();	// timer_get does sei()
 	uint16_t on_duty = 0;
 	while (1) {
@@ -531,6 +851,7 @@ static void brake_motor()
 		TL_off();
 		time += US_TO_TICKS(500);
 		signal_process();
+		telemetry_step();
 		_noinline_timerA_wait_until(time);
 		wdt_reset();
 		on_duty += 1;
@@ -543,6 +864,10 @@ static void brake_motor()
 	#if !BRAKE_REGENERATIVE
 		RL_off();
 	#endif
+	#if PWM_HARDWARE
+		pwm_set(0);
+	#endif
+	motor_status = MOTOR_STOPPED;
 }
 
 static void brake_init()
@@ -550,6 +875,29 @@ static void brake_init()
 	if (BIS(cfg.flags, CFG_BRAKE)) {
 		set_flag(flagsB, BRAKE);
 	}
+	else clear_flag(flagsB, BRAKE);
+}
+
+// Takes over a config from config_request(). Called from loop() with the motor stopped, the PWM
+// at 0 and the low FETs off, so the new PWM top and mode can't make a glitch on the bridge. Only
+// what depends on what changed is set up again, the rest of main() isn't repeated.
+static void __attribute__((optimize("s"))) config_apply()
+{
+	if (!_cfg_new_pending) return;
+	_cfg_new_pending = 0;
+	uint8_t turned = (cfg.flags ^ _cfg_new.flags) & (1<<CFG_DIRECTION);
+	uint16_t old_range = pwm_range;
+	memcpy((void*)&cfg, (void*)&_cfg_new, sizeof(config));
+	
+	calculate_globals();
+	if (pwm_range != old_range) {
+		pwm_set_top(pwm_range);
+		battery_rescale(old_range);
+	}
+	pwm_set(0);								// Synchronous PWM on or off
+	if (turned) commutation_init();			// The high FETs only
+	governor_init();
+	brake_init();
 }
 
 static uint8_t __attribute__((optimize("s"))) run_motor()
@@ -557,22 +905,35 @@ static uint8_t __attribute__((optimize("s"))) run_motor()
 	timing t;
 	uint8_t n = START_ATTEMPTS;
 	//uint8_t n = 1;
+	motor_status = MOTOR_STARTING;
 	while (n--) {
-		switch (start(&sc_default, &t)) {
+		uint8_t result = start_motor(&t);
+		telemetry_start(START_ATTEMPTS - n, result, result == STARTUP_OK? t.com_duration : 0);
+		switch (result) {
 			case STARTUP_OK:
-				run(&t);
+				motor_status = MOTOR_RUNNING;
+				result = run(&t);
+				telemetry_stop(result);
+				if (result == RUN_TIMEOUT && signal_get_power() > 0) {
+					motor_fault(FAULT_SYNC);
+				}
 				pwm_set(0);
+				motor_status = MOTOR_STOPPED;
+				motor_set_speed(0, 0);
 				return 0;
 			case STARTUP_NOSIG:
 				pwm_set(0);
+				motor_status = MOTOR_STOPPED;
 				return 0;
 		}
 	}
 	pwm_set(0);
+	motor_status = MOTOR_STOPPED;
+	motor_fault(FAULT_START);
 	return 1;
 }
 
-static void __attribute__((optimize("s"))) loop()
+static void __attribute__((optimize("s"), noreturn)) loop()
 {
 	uint8_t enabled = 0;
 	while (1) {
@@ -592,8 +953,10 @@ static void __attribute__((optimize("s"))) loop()
 		}
 		wdt_reset();
 		signal_process();
+		telemetry_step();
 		
-		if (signal_get_power() > 0) {
+		if (signal_get_power() == 0) config_apply();
+		else {
 			if (run_motor() != 0) {
 				//beep_play(&beep_start_fail);
 				//enabled = 0;
@@ -624,6 +987,7 @@ int __attribute__((optimize("s"))) main(void)
 	
 	calculate_globals();
 	signal_init();
+	telemetry_init();
 	pwm_init();
 	commutation_init();
 	
@@ -632,6 +996,8 @@ int __attribute__((optimize("s"))) main(void)
 	
 	// Now when we got configuration loaded, initialize other stuff.
 	acomp_init();
+	adc_init();
+	battery_init();
 	governor_init();
 	brake_init();
 	wdt_enable(WDTO_30MS);
@@ -9,6 +9,8 @@
 #ifndef COMMUTATION_H_
 #define COMMUTATION_H_
 
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include "comparator.h"
 #include "pwm.h"
 
@@ -205,4 +207,170 @@ inline void commutation_init()
 	}
 }
 
+// *------------------*
+// |  Spinning motor  |
+// *------------------*
+
+// The sectors between the ZCs by acomp_phases() with the power stage off, in the forward order:
+// sector n begins with the ZC the n-th forward commutation (comm_01 first) awaits. 6 - none.
+PROGMEM const uint8_t commutation_sector_lut[8] = {6, 0, 4, 5, 2, 1, 3, 6};
+
+inline uint8_t commutation_sector(uint8_t phases)
+{
+	return pgm_read_byte(&commutation_sector_lut[phases]);
+}
+
+// The rotor has just entered 'sector', turning in the set direction. Does the commutation that
+// awaited this ZC, the power at 0. The next commutate() goes on as after a ZC in run().
+static void commutation_seed(uint8_t sector)
+{
+	if (BIS(cfg.flags, CFG_DIRECTION)) {
+		switch (sector) {
+			case 0: comm_21(); break;
+			case 1: comm_32(); break;
+			case 2: comm_43(); break;
+			case 3: comm_54(); break;
+			case 4: comm_05(); break;
+			default: comm_10(); break;
+		}
+	}
+	else {
+		switch (sector) {
+			case 0: comm_01(); break;
+			case 1: comm_12(); break;
+			case 2: comm_23(); break;
+			case 3: comm_34(); break;
+			case 4: comm_45(); break;
+			default: comm_50(); break;
+		}
+	}
+}
+
+// *------------------------*
+// |  Commutation interrupt |
+// *------------------------*
+
+#if COMMUTATION_INTERRUPT && DEMAG_DETECTION && DEMAG_CUT_ANGLE
+	#error DEMAG_CUT_ANGLE needs COMMUTATION_INTERRUPT 0
+#endif
+
+#if COMMUTATION_INTERRUPT
+
+/*
+TIMER1_COMPA_vect commutates at the OCR1A set by commutation_int_schedule(), then the blind time
+runs until _com_int_scan. run() begins the ZC scan after it, see commutation_int_scan(), so the
+comparator ring keeps a single writer on each side. The interrupt stays enabled for the whole
+run(), pwm_set() changes TIMSK without disabling interrupts, so it's never touched from here.
+OCR1A keeps the time that has just matched, the next match is a whole Timer1 period away. The ZC
+timeout is in RAM meanwhile (zc_timeout_*), a compare at the ZC would delay the comparator interrupt.
+ISR_NOBLOCK: the sei comes before the prologue, the PWM and comparator interrupts wait for the
+interrupt response and that one instruction only. The commutation itself is delayed by the
+prologue and the indirect call, like commutate() from run() is by the loop around it.
+*/
+
+#define COM_INT_IDLE 0
+#define COM_INT_COMMUTATE 1
+#define COM_INT_BLIND 2
+#define COM_INT_MIN 3							// [ticks] Closest compare time set
+
+volatile uint8_t _com_int_state;
+uint16_t _com_int_scan;
+uint16_t _com_int_timeout;
+
+ISR(TIMER1_COMPA_vect, ISR_NOBLOCK)
+{
+	if (_com_int_state != COM_INT_COMMUTATE) return;
+	commutate();
+	_com_int_state = COM_INT_BLIND;
+}
+
+// At the start of run()
+inline void commutation_int_enable()
+{
+	cli();
+	_com_int_state = COM_INT_IDLE;
+	TIFR = NB(OCF1A);							// Write-one-to-clear
+	SBI(TIMSK, OCIE1A);
+	sei();
+}
+
+inline void commutation_int_disable()
+{
+	cli();
+	CBI(TIMSK, OCIE1A);
+	_com_int_state = COM_INT_IDLE;
+	sei();
+}
+
+// Commutate at com_time, begin the ZC scan at scan_time (not before the commutation), then
+// time out at timeout. Times that have passed are taken as now.
+static void commutation_int_schedule(uint16_t com_time, uint16_t scan_time, uint16_t timeout)
+{
+	_com_int_scan = scan_time;
+	_com_int_timeout = timeout;
+	cli();
+	uint16_t min = TCNT1 + COM_INT_MIN;
+	if ((int16_t)(com_time - min) < 0) com_time = min;
+	OCR1A = com_time;
+	TIFR = NB(OCF1A);							// A match of the old OCR1A
+	_com_int_state = COM_INT_COMMUTATE;
+	sei();
+}
+
+// The commutation or the blind time is still ahead
+inline uint8_t commutation_int_pending()
+{
+	return _com_int_state != COM_INT_IDLE;
+}
+
+// Begins the ZC scan once the blind time after the commutation has passed. 0 until then.
+inline uint8_t commutation_int_scan()
+{
+	if (_com_int_state == COM_INT_IDLE) return 1;
+	if (_com_int_state == COM_INT_COMMUTATE || !timer_ready(_com_int_scan)) return 0;
+	_com_int_state = COM_INT_IDLE;
+	zc_run_begin();
+	return 1;
+}
+
+inline void zc_timeout_set(uint16_t time)
+{
+	_com_int_timeout = time;
+}
+
+inline uint8_t zc_timeout_ready()
+{
+	return timer_ready(_com_int_timeout);
+}
+
+// Until the commutation while it's pending
+inline int16_t zc_timeout_remaining()
+{
+	if (commutation_int_pending()) return timerA_remaining();
+	return _com_int_timeout - timer_get();
+}
+
+#else
+
+inline void commutation_int_enable() {}
+inline void commutation_int_disable() {}
+
+// The ZC timeout of run() is in OCR1A
+inline void zc_timeout_set(uint16_t time)
+{
+	timerA_set(time);
+}
+
+inline uint8_t zc_timeout_ready()
+{
+	return timerA_ready();
+}
+
+inline int16_t zc_timeout_remaining()
+{
+	return timerA_remaining();
+}
+
+#endif
+
 #endif /* COMMUTATION_H_ */
\ No newline at end of file
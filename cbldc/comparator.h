@@ -13,33 +13,121 @@
 #include "led.h"
 #include "globals.h"
 
+#if ZC_INPUT_CAPTURE && INPUT_SIGNAL_TYPE == 3
+	#error ZC_INPUT_CAPTURE needs the Timer1 input capture, DShot uses it
+#endif
+
+#if ZC_PWM_SAMPLING && PWM_HARDWARE
+	#error ZC_PWM_SAMPLING needs the software PWM, the samples are taken by its interrupt
+#endif
+#if ZC_PWM_SAMPLING < 0 || ZC_PWM_SAMPLING > 99
+	#error Invalid constant: ZC_PWM_SAMPLING. Must be 0 to 99
+#endif
+
+#if DEMAG_DETECTION && (DEMAG_FILTER < 1 || DEMAG_CUT_ANGLE < 0 || DEMAG_CUT_ANGLE > 29)
+	#error Invalid constant: DEMAG_FILTER or DEMAG_CUT_ANGLE
+#endif
+
+// run() takes the time of the PRE-ZC event: for TIMING_AUTOTUNE without DEMAG_DETECTION, and as
+// the end of the demagnetization with COMMUTATION_INTERRUPT
+#define ZC_PRE_ZC_TIME (TIMING_AUTOTUNE && !DEMAG_DETECTION || DEMAG_DETECTION && COMMUTATION_INTERRUPT)
+
+#if ZC_EVENT_RING && (ZC_EVENT_FILTER < 1 || ZC_EVENT_FILTER > 100)
+	#error Invalid constant: ZC_EVENT_FILTER. Must be 1 to 100
+#endif
+
+/*
+ANA_COMP_INT stores the edge time in _aco_zc_time, at the PRE-ZC state in _aco_pre_time too
+(for ZC_PRE_ZC_TIME). At the ZC it disables itself, so ACIE cleared means ZC detected.
+
+With ZC_EVENT_RING, comparator events are passed to the main loop through a single producer,
+single consumer ring instead. The ISR writes an entry, then moves _aco_head; the main loop reads
+entries up to _aco_head, then moves _aco_tail. Neither side needs to disable interrupts.
+The indices run free, the entry is at index % ACO_RING. After the ZC the ISR stays on, waiting
+for the edge back to the PRE-ZC state, then for the ZC again and so on. zc_run_detected() takes
+the last ZC once no edge has followed it for ZC_EVENT_FILTER, and disables the interrupt.
+If the main loop falls more than ACO_RING events behind, the oldest ones are skipped.
+ACO_RING and the event type bits are in globals.h, the asm needs them too.
+
+With ZC_PWM_SAMPLING, TIMER2_OC_INT samples ACO at the end of each PWM on-time while ZC_SAMPLING
+is set, and goes through the same PRE-ZC and ZC states. At the ZC state it stores the sample time
+in _zc_sample_time, then clears ZC_SAMPLING.
+*/
+
 #ifdef __ASSEMBLER__
 	#define ANA_COMP_INT __vector_16
+	#if ZC_EVENT_RING
+	.extern _aco_ring;
+	.extern _aco_head;
+	#else
 	.extern _aco_zc_time;
+	.extern _aco_pre_time;
+	#endif
+	.extern _zc_sample_time;
 	
 #else
 
+#include <util/delay.h>
+#include "pwm.h"
+#include "timer.h"
+#include "adc.h"
+
+typedef struct {
+	uint16_t time;									// TCNT1
+	uint8_t type;									// ACO_EV_* bits
+} aco_event;
+
+#if ZC_EVENT_RING
+volatile aco_event _aco_ring[ACO_RING];
+volatile uint8_t _aco_head;							// Written by the ISR only
+uint8_t _aco_tail;									// Written by the main loop only
+uint8_t _zc_rising;									// The ZC is a rising edge in this scan
+uint8_t _zc_candidate;								// _zc_run_time is a ZC, no edge back yet
+#else
 volatile uint16_t _aco_zc_time;
+#if ZC_PRE_ZC_TIME
+volatile uint16_t _aco_pre_time;
+#endif
+#endif
+uint16_t _zc_run_time;
+
+#if ZC_PRE_ZC_TIME
+#if ZC_EVENT_RING
+uint16_t _zc_pre_time;								// PRE-ZC event of this scan,
+#endif
+uint8_t _zc_pre_seen;								// if the state wasn't there at the start
+#endif
+
+#if ZC_PWM_SAMPLING
+volatile uint16_t _zc_sample_time;					// Written by TIMER2_OC_INT
+uint8_t _zc_sampling;								// The PWM samples look for this ZC
+#endif
 
 inline void acomp_init()
 {
 	SBI(SFIOR, ACME);
 	SBI(ACSR, ACIS1);
+	#if ZC_INPUT_CAPTURE
+		SBI(ACSR, ACIC);							// Comparator to the Timer1 input capture
+	#endif
+	#if ZC_INPUT_CAPTURE == 2
+		SBI(TCCR1B, ICNC1);
+	#endif
 }
 
 inline void acomp_set_R()
 {
-	ADMUX = R_COMP_CHANNEL;
+	ADMUX = ADC_REFS | R_COMP_CHANNEL;
 }
 
 inline void acomp_set_S()
 {
-	ADMUX = S_COMP_CHANNEL;
+	ADMUX = ADC_REFS | S_COMP_CHANNEL;
 }
 
 inline void acomp_set_T()
 {
-	ADMUX = T_COMP_CHANNEL;
+	ADMUX = ADC_REFS | T_COMP_CHANNEL;
 }
 
 // Set detection for falling Zero-Cross.
@@ -47,6 +135,9 @@ inline void acomp_set_T()
 inline void acomp_await_falling_zc()
 {
 	CBI(ACSR, ACIE);
+	#if ZC_PWM_SAMPLING
+		clear_flag(flagsB, ZC_SAMPLING);
+	#endif
 	SBI(ACSR, ACIS0);
 }
 
@@ -55,6 +146,9 @@ inline void acomp_await_falling_zc()
 inline void acomp_await_rising_zc()
 {
 	CBI(ACSR, ACIE);
+	#if ZC_PWM_SAMPLING
+		clear_flag(flagsB, ZC_SAMPLING);
+	#endif
 	CBI(ACSR, ACIS0);
 }
 
@@ -63,13 +157,56 @@ inline uint8_t acomp_state()
 	return BIS(ACSR, ACO)? 1 : 0;
 }
 
+// With the power stage off, the state of each phase: R, S and T in bits 2, 1 and 0.
+// All three float, AIN0 is their average, so each bit is the sign of the phase back-EMF.
+// The interrupt must be disabled, the mux changes would trigger it.
+static uint8_t acomp_phases()
+{
+	uint8_t phases;
+	acomp_set_R();
+	_delay_us(2);								// Comparator propagation delay
+	phases = acomp_state() << 2;
+	acomp_set_S();
+	_delay_us(2);
+	phases |= acomp_state() << 1;
+	acomp_set_T();
+	_delay_us(2);
+	return phases | acomp_state();
+}
+
+#if DEMAG_DETECTION
+// Right after commutate(), the comparator set up by acomp_await_*. Waits while the floating phase
+// is clamped (ZC state), until the PRE-ZC state is read DEMAG_FILTER times in a row (returns 1)
+// or the timer reaches 'until' (returns 0).
+static uint8_t acomp_demag_wait(uint16_t until)
+{
+	uint8_t cnt = 0;
+	do {
+		if (!BIS(ACSR, ACO) == !BIS(ACSR, ACIS0)) {
+			if (++cnt >= DEMAG_FILTER) return 1;
+		}
+		else cnt = 0;
+	} while (!timer_ready(until));
+	return 0;
+}
+#endif
+
 // *------------------*
 // |    Zero-cross    |
 // *------------------*
 
-static void zc_run_begin()
+// Capture the edge the interrupt waits for, the ISR keeps them together from then on
+inline void _zc_capture_sync()
+{
+	#if ZC_INPUT_CAPTURE
+		if (BIS(ACSR, ACIS0)) SBI(TCCR1B, ICES1);
+		else CBI(TCCR1B, ICES1);
+	#endif
+}
+
+// Arms the comparator interrupt, ACIS0 set for the PRE-ZC state. Interrupts disabled.
+static void _zc_arm_interrupt()
 {
-	cli();
 	SBI(ACSR, ACIE);								// Enable interrupt
 	
 	// What kind of PRE-ZC state are we waiting for now?
@@ -93,22 +230,155 @@ static void zc_run_begin()
 			set_flag(flagsB, AWAIT_PRE_ZC);
 		}
 	}
-	clear_flag(flagsB, ZC_DETECTED);
+	#if ZC_PRE_ZC_TIME && !ZC_EVENT_RING
+	_zc_pre_seen = flag_is_set(flagsB, AWAIT_PRE_ZC);	// The ISR will store its time
+	#endif
+	_zc_capture_sync();
+}
+
+#if ZC_PWM_SAMPLING
+
+// Samples come only from the normal PWM mode, at a low enough duty, and often enough
+inline uint8_t _zc_sampling_possible()
+{
+	return BIC(flagsA, PWM_BLINKING) && BIS(TIMSK, OCIE2)
+		&& pwm_get() < mul_16_frac8(pwm_get_top(), ZC_PWM_SAMPLING*256/100)
+		&& motor_com_time >= ZC_PWM_SAMPLES_MIN * (pwm_get_top() / TIMER_PRESCALER);
+}
+
+static uint8_t _zc_sample_detected()
+{
+	if (flag_is_set(flagsB, ZC_SAMPLING)) {
+		
+		// Still looking. Hand over to the interrupt if the PWM has left the normal mode,
+		// there won't be any samples.
+		if (BIC(flagsA, PWM_BLINKING) && BIS(TIMSK, OCIE2)) return 0;
+		cli();
+		if (flag_is_set(flagsB, ZC_SAMPLING)) {
+			clear_flag(flagsB, ZC_SAMPLING);
+			_zc_sampling = 0;
+			if (flag_is_set(flagsB, AWAIT_PRE_ZC)) {
+				_zc_arm_interrupt();
+			}
+			else if (!BIS(ACSR, ACO) == !BIS(ACSR, ACIS0)) {
+				
+				// The ZC state is already there, no edge will come
+				_zc_run_time = TCNT1;
+				sei();
+				return 1;
+			}
+			else {
+				SBI(ACSR, ACIE);
+				_zc_capture_sync();
+			}
+			sei();
+			return 0;
+		}
+		sei();
+	}
+	
+	// Halfway between the last sample before the ZC and the first one after it
+	_zc_run_time = _zc_sample_time - pwm_get_top() / (2*TIMER_PRESCALER);
+	return 1;
+}
+
+#endif
+
+static void zc_run_begin()
+{
+	cli();
+	#if ZC_EVENT_RING
+	_aco_tail = _aco_head;							// Drop the events of the previous commutation
+	_zc_rising = BIC(ACSR, ACIS0);					// ACIS0 is set for the PRE-ZC edge
+	_zc_candidate = 0;
+	#endif
+	#if ZC_PRE_ZC_TIME
+	_zc_pre_seen = 0;
+	#endif
+	#if ZC_PWM_SAMPLING
+	_zc_sampling = _zc_sampling_possible();
+	if (_zc_sampling) {
+		set_flags(flagsB, AWAIT_PRE_ZC, ZC_SAMPLING);
+	}
+	else
+	#endif
+	_zc_arm_interrupt();
 	sei();	
 }
 
+#if ZC_EVENT_RING
+
+// Consumes the queued events. A ZC edge makes a candidate, an edge back to the PRE-ZC state
+// drops it: the comparator was ringing. The candidate is the ZC once it's ZC_EVENT_FILTER old.
+static uint8_t _zc_ring_detected()
+{
+	uint16_t now = timer_get();						// Before the head, no event can be missed
+	uint8_t head = _aco_head;
+	uint8_t tail = _aco_tail;
+	if ((uint8_t)(head - tail) >= ACO_RING) {
+		tail = head - (ACO_RING - 1);				// Overrun, the ISR may be writing the oldest one
+	}
+	while (tail != head) {
+		volatile aco_event* e = &_aco_ring[tail & (ACO_RING - 1)];
+		uint8_t type = e->type;
+		uint16_t time = e->time;
+		tail++;
+		if (type & (1<<ACO_EV_PRE_ZC)) {
+			#if ZC_PRE_ZC_TIME
+			_zc_pre_time = time;
+			_zc_pre_seen = 1;
+			#endif
+		}
+		else if (!(type & (1<<ACO_EV_RISING)) == !_zc_rising) {
+			_zc_run_time = time;
+			_zc_candidate = 1;
+		}
+		else _zc_candidate = 0;
+	}
+	_aco_tail = tail;
+	if (_zc_candidate && (uint16_t)(now - _zc_run_time) >= US_TO_TICKS(ZC_EVENT_FILTER)) {
+		CBI(ACSR, ACIE);
+		return 1;
+	}
+	return 0;
+}
+
+#endif
+
 // Has ZC been detected? For running mode.
 inline uint8_t zc_run_detected()
 {
-	return flag_is_set(flagsB, ZC_DETECTED);
+	#if ZC_PWM_SAMPLING
+	if (_zc_sampling) return _zc_sample_detected();
+	#endif
+	#if ZC_EVENT_RING
+	return _zc_ring_detected();
+	#else
+	if (BIS(ACSR, ACIE)) return 0;
+	_zc_run_time = _aco_zc_time;
+	return 1;
+	#endif
 }
 
-// Note: the ZC time variable is guaranteed to be correct only if ZC has been detected,
-// (ZC_DETECTED flag set) otherwise it may be garbage.
+// Note: the ZC time is guaranteed to be correct only after zc_run_detected() has returned 1,
+// otherwise it may be garbage.
 inline uint16_t zc_run_time()
 {
-	return _aco_zc_time;
+	return _zc_run_time;
+}
+
+#if ZC_PRE_ZC_TIME
+// Time from 'since' (the commutation) to the PRE-ZC state, after zc_run_detected() has returned 1.
+// 0 if the state was already there when the scan began, and with the PWM samples.
+inline uint16_t zc_run_pre_zc_delay(uint16_t since)
+{
+	#if ZC_EVENT_RING
+	return _zc_pre_seen? _zc_pre_time - since : 0;
+	#else
+	return _zc_pre_seen? _aco_pre_time - since : 0;
+	#endif
 }
+#endif
 
 #endif // !__ASSEMBLER__
 
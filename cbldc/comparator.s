@@ -10,7 +10,7 @@
 
  ; Analog comparator interrupt
 
-.global ANA_COMP_INT
+.global ANA_COMP_INT
 ANA_COMP_INT:	sbis	_SFR_IO_ADDR(ACSR), ACIS0
 		rjmp	aco_falling
 
@@ -18,12 +18,26 @@ ANA_COMP_INT:	sbis	_SFR_IO_ADDR(ACSR), ACIS0
 		; Read the comparator state a few times doing other stuff in the meantime.
 aco_rising:	sbis	_SFR_IO_ADDR(ACSR), ACO
 		reti
+	#if ZC_INPUT_CAPTURE
+		in	tmp_l,  _SFR_IO_ADDR(ICR1L)		; ZC time, captured by the hardware at the edge
+		in	tmp_h,  _SFR_IO_ADDR(ICR1H)
+	#else
 		in	tmp_l,  _SFR_IO_ADDR(TCNT1L)		; Read ZC time
 		in	tmp_h,  _SFR_IO_ADDR(TCNT1H)
+	#endif
 		in	isreg, _SFR_IO_ADDR(SREG)
 		
 		sbis	_SFR_IO_ADDR(ACSR), ACO
 		reti
+	#if ZC_EVENT_RING
+		push	r26
+		push	r27
+
+		sbis	_SFR_IO_ADDR(ACSR), ACO
+		rjmp	aco_noise
+		set						; T: rising edge
+		rjmp	aco_event
+	#else
 		sts	_aco_zc_time, tmp_l
 		sts	_aco_zc_time+1, tmp_h
 
@@ -36,18 +50,89 @@ aco_rising:	sbis	_SFR_IO_ADDR(ACSR), ACO
 aco_got_lh_pre_zc:
 		cbr	flagsB, 1<<AWAIT_PRE_ZC			; We'll be waiting for actual ZC now.
 		cbi	_SFR_IO_ADDR(ACSR), ACIS0
+	#if ZC_PRE_ZC_TIME
+		sts	_aco_pre_time, tmp_l
+		sts	_aco_pre_time+1, tmp_h
+	#endif
+	#if ZC_INPUT_CAPTURE
+		in	tmp_h, _SFR_IO_ADDR(TCCR1B)		; Capture the same edge
+		clt
+		bld	tmp_h, ICES1
+		out	_SFR_IO_ADDR(TCCR1B), tmp_h
+	#endif
 		out	_SFR_IO_ADDR(SREG), isreg
 		reti
+	#endif
 
 		; We were waiting for falling edge, and the interrupt has beed triggered.
 aco_falling:	sbic	_SFR_IO_ADDR(ACSR), ACO
 		reti
+	#if ZC_INPUT_CAPTURE
+		in	tmp_l,  _SFR_IO_ADDR(ICR1L)		; ZC time, captured by the hardware at the edge
+		in	tmp_h,  _SFR_IO_ADDR(ICR1H)
+	#else
 		in	tmp_l,  _SFR_IO_ADDR(TCNT1L)		; Read ZC time
 		in	tmp_h,  _SFR_IO_ADDR(TCNT1H)
+	#endif
 		in	isreg, _SFR_IO_ADDR(SREG)
 
 		sbic	_SFR_IO_ADDR(ACSR), ACO
 		reti
+	#if ZC_EVENT_RING
+		push	r26
+		push	r27
+
+		sbic	_SFR_IO_ADDR(ACSR), ACO
+		rjmp	aco_noise
+		clt						; T: falling edge
+
+		; Queue the event: X = &_aco_ring[_aco_head % ACO_RING]
+aco_event:	lds	r26, _aco_head
+		andi	r26, ACO_RING-1
+		mov	r27, r26
+		lsl	r26
+		add	r26, r27
+		clr	r27
+		subi	r26, lo8(-(_aco_ring))
+		sbci	r27, hi8(-(_aco_ring))
+		st	X+, tmp_l
+		st	X+, tmp_h
+		clr	tmp_l					; Event type
+		bld	tmp_l, ACO_EV_RISING
+		bst	flagsB, AWAIT_PRE_ZC
+		bld	tmp_l, ACO_EV_PRE_ZC
+		bst	flagsA, PWM_STATE
+		bld	tmp_l, ACO_EV_PWM
+		st	X, tmp_l
+
+		lds	r26, _aco_head				; Publish it, after the entry is complete
+		inc	r26
+		sts	_aco_head, r26
+		pop	r27
+		pop	r26
+
+		; Keep queuing, the opposite edge next. After the ZC that is the comparator going back
+		; to the PRE-ZC state, run() takes the ZC once it has stayed for ZC_EVENT_FILTER.
+		sbrc	flagsB, AWAIT_PRE_ZC
+		cbr	flagsB, 1<<AWAIT_PRE_ZC			; We'll be waiting for actual ZC now.
+		sbrc	tmp_l, ACO_EV_RISING
+		cbi	_SFR_IO_ADDR(ACSR), ACIS0
+		sbrs	tmp_l, ACO_EV_RISING
+		sbi	_SFR_IO_ADDR(ACSR), ACIS0
+	#if ZC_INPUT_CAPTURE
+		in	tmp_h, _SFR_IO_ADDR(ACSR)		; Capture the same edge
+		bst	tmp_h, ACIS0
+		in	tmp_h, _SFR_IO_ADDR(TCCR1B)
+		bld	tmp_h, ICES1
+		out	_SFR_IO_ADDR(TCCR1B), tmp_h
+	#endif
+		out	_SFR_IO_ADDR(SREG), isreg
+		reti
+
+aco_noise:	pop	r27
+		pop	r26
+		reti
+	#else
 		sts	_aco_zc_time, tmp_l
 		sts	_aco_zc_time+1, tmp_h
 
@@ -60,10 +145,21 @@ aco_falling:	sbic	_SFR_IO_ADDR(ACSR), ACO
 aco_got_hl_pre_zc:
 		cbr	flagsB, 1<<AWAIT_PRE_ZC
 		sbi	_SFR_IO_ADDR(ACSR), ACIS0
+	#if ZC_PRE_ZC_TIME
+		sts	_aco_pre_time, tmp_l
+		sts	_aco_pre_time+1, tmp_h
+	#endif
+	#if ZC_INPUT_CAPTURE
+		in	tmp_h, _SFR_IO_ADDR(TCCR1B)		; Capture the same edge
+		set
+		bld	tmp_h, ICES1
+		out	_SFR_IO_ADDR(TCCR1B), tmp_h
+	#endif
 		out	_SFR_IO_ADDR(SREG), isreg
 		reti
 
-aco_got_zc:	cbi	_SFR_IO_ADDR(ACSR), ACIE		; ZC detected, we won't need any more interrupts.
-		sbr	flagsB, (1<<ZC_DETECTED)
+		; ZC detected, we won't need any more interrupts. run() sees ACIE cleared.
+aco_got_zc:	cbi	_SFR_IO_ADDR(ACSR), ACIE
 		out	_SFR_IO_ADDR(SREG), isreg
-		reti
\ No newline at end of file
+		reti
+	#endif
\ No newline at end of file
@@ -68,6 +68,7 @@ static uint8_t config_evaluate(const config* c)
 	if (checksum == 0 || checksum != c->checksum) return 1;
 	if (c->pwm_freq < 1000 || c->pwm_freq >= 32001) return 1;
 	if (c->timing_delay > 128) return 1;
+	if (c->rcp_high <= c->rcp_low || c->gov_max_rps == 0) return 1;
 	return 0;
 }
 
@@ -88,6 +89,23 @@ static uint8_t config_load(config* c, const config* eep_c)
 	}
 }
 
+// A config waiting to replace cfg, see config_request()
+static config _cfg_new;
+static volatile uint8_t _cfg_new_pending;
+
+// Asks for c to be used instead of cfg, without a reboot: config_apply() in loop() takes it over
+// the next time the motor is stopped. It isn't stored, config_write() does that. Returns 1 if c
+// doesn't make sense, cfg stays then. For the stick programming, see program_store().
+static uint8_t config_request(const config* c)
+{
+	_cfg_new_pending = 0;
+	memcpy((void*)&_cfg_new, (void*)c, sizeof(config));
+	_cfg_new.checksum = config_calculate_checksum(&_cfg_new);
+	if (config_evaluate(&_cfg_new)) return 1;
+	_cfg_new_pending = 1;
+	return 0;
+}
+
 // Recalculate the config's checksum and store it in ROM.
 static void config_write(config* c, config* eep_c)
 {
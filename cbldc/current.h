@@ -0,0 +1,116 @@
+/*
+ * current.h
+ *
+ * Bus current limit, see CURRENT_LIMIT in bldc.h and CURRENT_CHANNEL in the board file.
+ *
+ * The ADC is only free between the ZC and the commutation, see adc.h. run() takes one sample
+ * there every _CURRENT_PERIOD commutations, in the middle of a PWM on-time, when the current of
+ * the driven phases flows through the shunt. The ramp of START_MODE 1 samples right before its
+ * forced commutations. Over the limit, the duty is cut in proportion right
+ * away and capped. The cap is released by 1/64 of pwm_range per sample under the limit.
+ *
+ * The main loop waits for the sample: up to one PWM period for the on-time to begin, half of it
+ * (or of the next one if it's too short to hold the middle), then 25 us of conversion. 150 us
+ * at 16 kHz at worst, in one commutation out of _CURRENT_PERIOD.
+ */
+
+
+#ifndef CURRENT_H_
+#define CURRENT_H_
+
+#include <avr/io.h>
+#include "bldc.h"
+#include "globals.h"
+#include "pwm.h"
+#include "timer.h"
+#include "adc.h"
+
+#define CURRENT_SENSE (CURRENT_LIMIT && CURRENT_CHANNEL >= 0)
+
+#if CURRENT_SENSE
+
+#if PWM_HARDWARE
+	#error CURRENT_LIMIT needs the software PWM, the samples follow its interrupt
+#endif
+
+#define _CURRENT_RELEASE_SHIFT 6
+#define _CURRENT_PERIOD 4								// Commutations per sample
+
+// The limit in ADC units, 1024 = 2.56 V
+#define _CURRENT_LIMIT_ADC (CURRENT_LIMIT * CURRENT_SENSE_GAIN * 1024L / 2560)
+#if _CURRENT_LIMIT_ADC > 1000
+	#error CURRENT_LIMIT * CURRENT_SENSE_GAIN is over the 2.56 V ADC reference
+#endif
+
+uint16_t _current_cap;
+uint8_t _current_slot;
+
+// At the start of run()
+inline void current_init()
+{
+	_current_cap = pwm_range;
+}
+
+inline uint16_t current_limit(uint16_t power)
+{
+	return power > _current_cap? _current_cap : power;
+}
+
+// After the ZC, the commutation at 'until'. Skipped if the sample can't be done by then,
+// and at the duties with no on-time long enough to sample. Then it's the next commutation's turn.
+static void current_sample(uint16_t until)
+{
+	if (_current_slot < _CURRENT_PERIOD - 1) {
+		_current_slot++;
+		return;
+	}
+	uint16_t now = timer_get();
+	uint16_t start;
+	if (BIS(TIMSK, OCIE2) && BIC(flagsA, PWM_BLINKING)) {
+		
+		// Normal PWM mode. Wait for the beginning of an on-time, within a PWM period, then hold
+		// the middle of it, or of the next one if it's too short.
+		uint16_t period = pwm_get_top() / TIMER_PRESCALER;
+		uint16_t timeout = now + period + ADC_MARGIN;
+		uint8_t was_on = 1;
+		while (1) {
+			cli();
+			uint8_t on = flag_is_set(flagsA, PWM_STATE);
+			now = TCNT1;
+			sei();
+			if (on && !was_on) break;
+			was_on = on;
+			if (!adc_fits(now, until) || (int16_t)(now - timeout) > 0) return;
+		}
+		start = now + pwm_get() / (2*TIMER_PRESCALER) - ADC_HOLD_TICKS;
+		if ((int16_t)(start - now) < 0) start += period;
+	}
+	else if (flag_is_set(flagsA, PWM_STATE)) {
+		
+		// Full power, or off for just a blink now and then
+		start = now;
+	}
+	else return;
+	if (!adc_fits(start, until)) return;
+	_current_slot = 0;
+	
+	uint16_t adc = adc_convert(ADC_2V56(CURRENT_CHANNEL), start);
+	if (adc > _CURRENT_LIMIT_ADC) {
+		_current_cap = (uint32_t)pwm_get() * _CURRENT_LIMIT_ADC / adc;
+		pwm_set(_current_cap);
+	}
+	else if (_current_cap < pwm_range) {
+		_current_cap += pwm_range >> _CURRENT_RELEASE_SHIFT;
+		if (_current_cap > pwm_range) _current_cap = pwm_range;
+	}
+}
+
+#else
+
+inline void current_init() {}
+inline uint16_t current_limit(uint16_t power) { return power; }
+inline void current_sample(uint16_t until) {}
+
+#endif
+
+#endif /* CURRENT_H_ */
@@ -33,6 +33,8 @@
 	#include "config.h"
 	#include "tools/arithmetic.h"
 	
+	#ifdef __AVR__
+	
 	volatile register uint8_t flagsA asm("r16");
 	volatile register uint8_t flagsB asm("r17");
 	register uint8_t pwm_low_l asm("r6");
@@ -44,6 +46,24 @@
 	register uint8_t pwm_tcnt2_h asm("r12");
 	register uint8_t isreg asm("r13");
 	//register uint8_t aco_samples asm("r14");
+	
+	#else
+	
+	// Host build (see host/). There are no global register variables, the ISR ports share plain
+	// variables with the main code instead. ISRs can only fire between simulated I/O accesses,
+	// so a single C statement on a flag register is as atomic as "ori"/"andi" is on the AVR.
+	volatile uint8_t flagsA;
+	volatile uint8_t flagsB;
+	volatile uint8_t pwm_low_l;
+	volatile uint8_t pwm_low_h;
+	volatile uint8_t pwm_high_l;
+	volatile uint8_t pwm_high_h;
+	volatile uint8_t tmp_l;
+	volatile uint8_t tmp_h;
+	volatile uint8_t pwm_tcnt2_h;
+	volatile uint8_t isreg;
+	
+	#endif
 
 	uint16_t signal_range;
 	uint16_t pwm_range;
@@ -54,10 +74,17 @@
 	uint8_t stp_frac;
 	uint8_t sttl_mul;
 	uint8_t sttl_frac;
-	
-	float pwm_range_f;
+	uint8_t load_frac;				// PWM to load, 256 = pwm_range
 	
 	config cfg;
+	
+	// Motor state reported back over the signal interface (I2C), see MOTOR_ and FAULT_ below
+	uint8_t motor_status;
+	uint8_t motor_faults;			// Cleared when read
+	uint16_t motor_rps;				// Electrical revolutions per second
+	uint16_t motor_com_time;		// [Timer1 ticks] Commutation period, 0 when stopped
+
+	#ifdef __AVR__
 
 	// Atomic flag set, 1 bit
 	inline void set_flag(uint8_t flagreg, uint8_t bit)
@@ -103,46 +130,87 @@
 		);
 	}
 	
+	#else
+	
+	#define set_flag(flagreg, bit) ((flagreg) |= (1<<(bit)))
+	#define set_flags(flagreg, bit1, bit2) ((flagreg) |= (1<<(bit1)) + (1<<(bit2)))
+	#define clear_flag(flagreg, bit) ((flagreg) &= 255 - (1<<(bit)))
+	#define clear_flags(flagreg, bit1, bit2) ((flagreg) &= 255 - (1<<(bit1)) - (1<<(bit2)))
+	
+	#endif
+	
 	inline uint8_t flag_is_set(uint8_t flagreg, uint8_t bit)
 	{
 		return BIS(flagreg, bit);
 	}
 	
+	// The signal ISR reads these, so they are changed with interrupts disabled
+	inline void motor_fault(uint8_t bit)
+	{
+		cli();
+		motor_faults |= 1<<bit;
+		sei();
+	}
+	
+	inline void motor_set_speed(uint16_t com_time, uint16_t rps)
+	{
+		cli();
+		motor_com_time = com_time;
+		motor_rps = rps;
+		sei();
+	}
+	
+	#define PWM_HW_PERIOD 510		// Hardware PWM period in CPU cycles, Timer2 phase correct mode (see pwm.h)
+	
 	/* The function calculates some global constants. Things such as signal min and signal max are unknown
 	in compilation time since user can calibrate RC PWM range etc. And since these are variables, I made
 	PWM frequency a variable as well, since it's not much bigger problem now. At least our ESC will have
-	a programmable PWM frequency, which is even better. I used the floating point calculations because some
-	of them would be hard to do in _resonable_ way on fixed point operations, due to huge values involved.
-	Let's say I didn't wanna waste yet another day on some assembly inlines. Governor initialization also
-	needs some floating point calculations, so some functions were already compiled into the program bin.
+	a programmable PWM frequency, which is even better. The maths was written in floats, it's done in the
+	ufloat integers of arithmetic.h now: the same results to the bit (host/globalscheck.c checks every
+	PWM frequency and RC range), without the soft-float library in the program bin. The governor too.
 	
 	PRE: config must be loaded
 	*/
 	static void __attribute__((optimize("s"))) calculate_globals()
 	{
 		// Calculate input signal range (signal resolution)
+#if INPUT_SIGNAL_TYPE == 3
+		signal_range = DSHOT_RANGE;						// No calibration
+#elif INPUT_SIGNAL_TYPE == 2
+		signal_range = I2C_RANGE;
+#else
 		signal_range = cfg.rcp_high - cfg.rcp_low;
+#endif
 		
 		// Calculate the Signal To PWM conversion constants, used later for conversion signal ->  throttle
-		float pwm_period = (float)F_CPU / (float)cfg.pwm_freq;
-		stp_mul = pwm_period / (float)signal_range;
-		uint16_t tmp = pwm_period * 256.0 / (float)signal_range;
+#if PWM_HARDWARE
+		ufloat pwm_period = uf_div(PWM_HW_PERIOD, 1);	// Fixed by the hardware, cfg.pwm_freq is ignored
+#else
+		ufloat pwm_period = uf_div(F_CPU, cfg.pwm_freq);
+#endif
+		ufloat stp = uf_ldexp(uf_div(pwm_period.m, signal_range), pwm_period.e);
+		stp_mul = uf_int(stp);
+		uint16_t tmp = uf_int(uf_ldexp(stp, 8));
 		tmp -= stp_mul<<8;
 		stp_frac = tmp;
 		
 		// Calculate Speed To Throttle Limit conversion constants
-		sttl_mul = (60.0*THROT_PER_KRPM/100000.0) * pwm_period;
-		tmp = (60.0*THROT_PER_KRPM/100000.0*256.0) * pwm_period;
+		ufloat sttl = uf_mul(uf_const(60.0f*THROT_PER_KRPM/100000.0f), pwm_period);
+		sttl_mul = uf_int(sttl);
+		tmp = uf_int(uf_ldexp(sttl, 8));
 		tmp -= sttl_mul<<8;
 		sttl_frac = tmp;
 		
 		// Power limit for startup
-		pwm_start_min = pwm_period * (0.01*START_MIN_POWER);
-		pwm_start_max = pwm_period * (0.01*START_MAX_POWER);
+		pwm_start_min = uf_int(uf_mul(pwm_period, uf_const(0.01f*START_MIN_POWER)));
+		pwm_start_max = uf_int(uf_mul(pwm_period, uf_const(0.01f*START_MAX_POWER)));
 		
 		// Construct the PWM range from the STP constants, making sure that the conversion at 100% signal
 		// will always bring it to 100% throttle.
 		pwm_range = mul_16_8_sum_frac8(signal_range, stp_mul, stp_frac);
+		
+		// Load for the timing curve, x * load_frac / 256 is x / pwm_range in 1/256
+		load_frac = pwm_range > 256? uf_int(uf_div(65536, pwm_range)) : 255;
 	}
 	
 #endif /* ASSEMBLER */
@@ -154,12 +222,13 @@
 #define PWM_S 3
 #define PWM_T 4
 #define PWM_SYNCHRO 5
+#define DSHOT_FRAME 6
 #define SIGNAL_MAX 7
 
 
 // flagsB
 #define AWAIT_PRE_ZC 0
-#define ZC_DETECTED 1
+#define ZC_SAMPLING 1
 #define GOVERNOR 2
 #define BRAKE 3
 #define RCP_RECEIVED 4
@@ -167,4 +236,23 @@
 #define SIGNAL_RECEIVED 6
 #define SIGNAL_ERROR 7
 
+// Comparator event ring with ZC_EVENT_RING, see comparator.h
+#define ACO_RING 8						// Entries, power of 2
+#define ACO_EVENT_SIZE 3				// time_l, time_h, type
+#define ACO_EV_RISING 0					// Type bits: rising comparator edge,
+#define ACO_EV_PRE_ZC 1					// the PRE-ZC state rather than the ZC,
+#define ACO_EV_PWM 2					// PWM_STATE at the edge
+
+// motor_status
+#define MOTOR_STOPPED 0
+#define MOTOR_STARTING 1
+#define MOTOR_RUNNING 2
+#define MOTOR_BRAKING 3
+
+// motor_faults bits
+#define FAULT_START 0					// Start-up failed START_ATTEMPTS times
+#define FAULT_SYNC 1					// Lost the motor while running with power on
+#define FAULT_SIGNAL 2					// Signal timeout
+#define FAULT_LVC 3						// Under the low voltage cutoff, the power is ramped down
+
 #endif /* GLOBALS_H_ */
\ No newline at end of file
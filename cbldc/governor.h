@@ -79,6 +79,7 @@ static void governor_process_feedback(uint16_t rps)
 	 F(t) = S(t) * _gov_p2s_const / 2^24, where _gov_p2s_const = Pmax * (2^24-1) / Smax
 	*/
 	
+#ifdef __AVR__
 	asm volatile (
 	// 1. xA * mA
 	"mul  %A1, %A2     \n\t"\
@@ -140,6 +141,10 @@ static void governor_process_feedback(uint16_t rps)
 	: "r"(gov_s2p_const), "r"(rps)			// arguments
 	: "r30", "r31"							// clobbered regs
 	);
+#else
+	uint64_t f = ((uint64_t)gov_s2p_const * rps) >> 24;
+	gov_feedback = f > 0xFFFF? 0xFFFF : f;
+#endif
 }
 
 static void governor_process_error(uint16_t setpoint)
@@ -163,6 +168,7 @@ static void governor_process_error(uint16_t setpoint)
 static void governor_process_pid()
 {
 	uint16_t u;
+#ifdef __AVR__
 	// It was easier to write in asm, because I'm doing some 24 bit maths here with multiplications
 	asm volatile (
 	
@@ -282,6 +288,50 @@ static void governor_process_pid()
 	: "a"(gov_error), "M"(GOV_Ki), "M"(GOV_P), "M"(GOV_D)
 	: "r18", "r19", "r31"
 	);
+#else
+	// Same 24 bit maths as above, gov_i holds the integrator with 8 fractional bits.
+	int16_t error = gov_error;
+	int32_t acc;
+	
+	#if GOV_Ti < 0xFFFF
+	
+	uint8_t* gi = (uint8_t*)&gov_i;
+	acc = (int32_t)((uint32_t)gi[0] | (uint32_t)gi[1] << 8 | (uint32_t)(int8_t)gi[2] << 16);
+	acc += (int32_t)error * GOV_Ki;
+	acc = (int32_t)((uint32_t)acc << 8) >> 8;			// wrap to 24 bits
+	if (acc < 0) {
+		acc = 0;
+	}
+	else if ((uint16_t)(acc >> 8) >= pwm_range) {
+		acc = (int32_t)pwm_range << 8;
+	}
+	gi[0] = acc;
+	gi[1] = acc >> 8;
+	gi[2] = acc >> 16;
+	acc = (uint16_t)(acc >> 8);
+	
+	#else
+	
+	acc = 0;
+	
+	#endif
+	
+	acc += (int32_t)error * GOV_P;
+	
+	#if GOV_D
+	
+	// The error is stored before the derivative is taken, exactly like the asm does.
+	int16_t previous = gov_error;
+	gov_error = error;
+	acc += (int32_t)(int16_t)(error - previous) * GOV_D;
+	
+	#endif
+	
+	acc = (int32_t)((uint32_t)acc << 8) >> 8;
+	if (acc < 0) u = 0;
+	else if (acc > 0xFFFF) u = 0xFFFF;
+	else u = acc;
+#endif
 
 	// Apply throttle rise slow-down
 	if (u < gov_power) {
@@ -310,11 +360,12 @@ static void __attribute__((optimize("s"))) governor_init()
 		// Calculate governor constants
 		//gov_antiwindup_h = (float)pwm_range * (0.01*GOV_ANTIWINDUP);
 		////gov_antiwindup_l = -gov_antiwindup_h;
-		float tmp = (float)pwm_range / (float)cfg.gov_max_rps;
-		gov_min_setpoint = tmp * (float)RPM_TO_RPS(GOV_MIN_SPEED);
-		gov_s2p_const = tmp * (float)0x01000000;
-		gov_throttle_speed = signal_range * (0.01*GOV_THROTTLE_SPEED / GOV_SAMPLING_FREQ);
-	}	
+		ufloat tmp = uf_div(pwm_range, cfg.gov_max_rps);
+		gov_min_setpoint = uf_int(uf_mul(tmp, uf_div(RPM_TO_RPS(GOV_MIN_SPEED), 1)));
+		gov_s2p_const = uf_int(uf_ldexp(tmp, 24));
+		gov_throttle_speed = uf_int(uf_mul(uf_div(signal_range, 1), uf_const(0.01f*GOV_THROTTLE_SPEED / GOV_SAMPLING_FREQ)));
+	}
+	else clear_flag(flagsB, GOVERNOR);				// Turned off by config_apply()
 }
 
 inline uint16_t governor_get_power()
@@ -0,0 +1,20 @@
+/*
+ * eeprom.h
+ *
+ * Host build replacement of <avr/eeprom.h>. The EEPROM is plain RAM, cleared on start,
+ * so the firmware always finds an invalid config and falls back to the defaults.
+ */
+
+
+#ifndef HOST_AVR_EEPROM_H_
+#define HOST_AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <string.h>
+
+#define EEMEM
+
+#define eeprom_read_block(dst, src, n) memcpy((void*)(dst), (const void*)(src), n)
+#define eeprom_update_block(src, dst, n) memcpy((void*)(dst), (const void*)(src), n)
+
+#endif /* HOST_AVR_EEPROM_H_ */
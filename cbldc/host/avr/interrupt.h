@@ -0,0 +1,23 @@
+/*
+ * interrupt.h
+ *
+ * Host build replacement of <avr/interrupt.h>.
+ */
+
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define cli() mcu_cli()
+#define sei() mcu_sei()
+
+// ISRs are plain functions, mcu.c calls them by vector number. ISR_NOBLOCK goes first in the
+// function, like the sei avr-gcc puts before the prologue.
+#define ISR_NOBLOCK mcu_isr_noblock();
+#define ISR(vector, ...) static void vector##_body(void); \
+	void vector(void) { __VA_ARGS__ vector##_body(); } \
+	static void vector##_body(void)
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
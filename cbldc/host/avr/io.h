@@ -0,0 +1,319 @@
+/*
+ * io.h
+ *
+ * Host build replacement of <avr/io.h> for the ATmega8.
+ *
+ * Every I/O register is an access to the simulated MCU (see mcu.h). Reading a register
+ * advances the simulated clock, so busy-wait loops on TCNT1 make progress, and lets pending
+ * interrupts fire, just like between two instructions on the real chip.
+ *
+ * Define MCU_SFR_ADDRESSES before including to get plain I/O addresses instead,
+ * e.g. to decode the board's RL_PORT/RL_PIN definitions in the plant model.
+ */
+
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+#endif
+
+#ifdef MCU_SFR_ADDRESSES
+	#define _SFR_IO8(a) (a)
+	#define _SFR_IO16(a) (a)
+#else
+	#include "../mcu.h"
+	#define _SFR_IO8(a) (*mcu_io8(a))
+	#define _SFR_IO16(a) (*mcu_io16(a))
+#endif
+
+#define _SFR_IO_ADDR(sfr) (sfr)
+#define _BV(bit) (1 << (bit))
+
+// *------------------*
+// |    Registers     |
+// *------------------*
+
+#define TWBR	_SFR_IO8(0x00)
+#define TWSR	_SFR_IO8(0x01)
+#define TWAR	_SFR_IO8(0x02)
+#define TWDR	_SFR_IO8(0x03)
+#define ADC		_SFR_IO16(0x04)
+#define ADCW	_SFR_IO16(0x04)
+#define ADCL	_SFR_IO8(0x04)
+#define ADCH	_SFR_IO8(0x05)
+#define ADCSRA	_SFR_IO8(0x06)
+#define ADMUX	_SFR_IO8(0x07)
+#define ACSR	_SFR_IO8(0x08)
+#define UBRRL	_SFR_IO8(0x09)
+#define UCSRB	_SFR_IO8(0x0A)
+#define UCSRA	_SFR_IO8(0x0B)
+#define UDR		_SFR_IO8(0x0C)
+#define SPCR	_SFR_IO8(0x0D)
+#define SPSR	_SFR_IO8(0x0E)
+#define SPDR	_SFR_IO8(0x0F)
+#define PIND	_SFR_IO8(0x10)
+#define DDRD	_SFR_IO8(0x11)
+#define PORTD	_SFR_IO8(0x12)
+#define PINC	_SFR_IO8(0x13)
+#define DDRC	_SFR_IO8(0x14)
+#define PORTC	_SFR_IO8(0x15)
+#define PINB	_SFR_IO8(0x16)
+#define DDRB	_SFR_IO8(0x17)
+#define PORTB	_SFR_IO8(0x18)
+#define EECR	_SFR_IO8(0x1C)
+#define EEDR	_SFR_IO8(0x1D)
+#define EEARL	_SFR_IO8(0x1E)
+#define EEARH	_SFR_IO8(0x1F)
+#define UBRRH	_SFR_IO8(0x20)
+#define UCSRC	_SFR_IO8(0x20)
+#define WDTCR	_SFR_IO8(0x21)
+#define ASSR	_SFR_IO8(0x22)
+#define OCR2	_SFR_IO8(0x23)
+#define TCNT2	_SFR_IO8(0x24)
+#define TCCR2	_SFR_IO8(0x25)
+#define ICR1	_SFR_IO16(0x26)
+#define ICR1L	_SFR_IO8(0x26)
+#define ICR1H	_SFR_IO8(0x27)
+#define OCR1B	_SFR_IO16(0x28)
+#define OCR1BL	_SFR_IO8(0x28)
+#define OCR1BH	_SFR_IO8(0x29)
+#define OCR1A	_SFR_IO16(0x2A)
+#define OCR1AL	_SFR_IO8(0x2A)
+#define OCR1AH	_SFR_IO8(0x2B)
+#define TCNT1	_SFR_IO16(0x2C)
+#define TCNT1L	_SFR_IO8(0x2C)
+#define TCNT1H	_SFR_IO8(0x2D)
+#define TCCR1B	_SFR_IO8(0x2E)
+#define TCCR1A	_SFR_IO8(0x2F)
+#define SFIOR	_SFR_IO8(0x30)
+#define OSCCAL	_SFR_IO8(0x31)
+#define TCNT0	_SFR_IO8(0x32)
+#define TCCR0	_SFR_IO8(0x33)
+#define MCUCSR	_SFR_IO8(0x34)
+#define MCUCR	_SFR_IO8(0x35)
+#define TWCR	_SFR_IO8(0x36)
+#define SPMCR	_SFR_IO8(0x37)
+#define TIFR	_SFR_IO8(0x38)
+#define TIMSK	_SFR_IO8(0x39)
+#define GIFR	_SFR_IO8(0x3A)
+#define GICR	_SFR_IO8(0x3B)
+#define SREG	_SFR_IO8(0x3F)
+
+// *------------------*
+// |       Bits       |
+// *------------------*
+
+// GICR
+#define INT1	7
+#define INT0	6
+#define IVSEL	1
+#define IVCE	0
+
+// GIFR
+#define INTF1	7
+#define INTF0	6
+
+// TIMSK
+#define OCIE2	7
+#define TOIE2	6
+#define TICIE1	5
+#define OCIE1A	4
+#define OCIE1B	3
+#define TOIE1	2
+#define TOIE0	0
+
+// TIFR
+#define OCF2	7
+#define TOV2	6
+#define ICF1	5
+#define OCF1A	4
+#define OCF1B	3
+#define TOV1	2
+#define TOV0	0
+
+// MCUCR
+#define SE		7
+#define SM2		6
+#define SM1		5
+#define SM0		4
+#define ISC11	3
+#define ISC10	2
+#define ISC01	1
+#define ISC00	0
+
+// SFIOR
+#define ADHSM	4
+#define ACME	3
+#define PUD		2
+#define PSR2	1
+#define PSR10	0
+
+// TCCR0
+#define CS02	2
+#define CS01	1
+#define CS00	0
+
+// TCCR1A
+#define COM1A1	7
+#define COM1A0	6
+#define COM1B1	5
+#define COM1B0	4
+#define FOC1A	3
+#define FOC1B	2
+#define WGM11	1
+#define WGM10	0
+
+// TCCR1B
+#define ICNC1	7
+#define ICES1	6
+#define WGM13	4
+#define WGM12	3
+#define CS12	2
+#define CS11	1
+#define CS10	0
+
+// TCCR2
+#define FOC2	7
+#define WGM20	6
+#define COM21	5
+#define COM20	4
+#define WGM21	3
+#define CS22	2
+#define CS21	1
+#define CS20	0
+
+// WDTCR
+#define WDCE	4
+#define WDE		3
+#define WDP2	2
+#define WDP1	1
+#define WDP0	0
+
+// ACSR
+#define ACD		7
+#define ACBG	6
+#define ACO		5
+#define ACI		4
+#define ACIE	3
+#define ACIC	2
+#define ACIS1	1
+#define ACIS0	0
+
+// ADMUX
+#define REFS1	7
+#define REFS0	6
+#define ADLAR	5
+#define MUX3	3
+#define MUX2	2
+#define MUX1	1
+#define MUX0	0
+
+// ADCSRA
+#define ADEN	7
+#define ADSC	6
+#define ADFR	5
+#define ADIF	4
+#define ADIE	3
+#define ADPS2	2
+#define ADPS1	1
+#define ADPS0	0
+
+// UCSRA
+#define RXC		7
+#define TXC		6
+#define UDRE	5
+#define FE		4
+#define DOR		3
+#define PE		2
+#define U2X		1
+#define MPCM	0
+
+// UCSRB
+#define RXCIE	7
+#define TXCIE	6
+#define UDRIE	5
+#define RXEN	4
+#define TXEN	3
+#define UCSZ2	2
+#define RXB8	1
+#define TXB8	0
+
+// UCSRC
+#define URSEL	7
+#define UMSEL	6
+#define UPM1	5
+#define UPM0	4
+#define USBS	3
+#define UCSZ1	2
+#define UCSZ0	1
+#define UCPOL	0
+
+// TWCR
+#define TWINT	7
+#define TWEA	6
+#define TWSTA	5
+#define TWSTO	4
+#define TWWC	3
+#define TWEN	2
+#define TWIE	0
+
+// TWSR
+#define TWPS1	1
+#define TWPS0	0
+
+// TWAR
+#define TWGCE	0
+
+// Port pins
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+// *------------------*
+// |     Vectors      |
+// *------------------*
+
+#define INT0_vect			__vector_1
+#define INT1_vect			__vector_2
+#define TIMER2_COMP_vect	__vector_3
+#define TIMER2_OVF_vect		__vector_4
+#define TIMER1_CAPT_vect	__vector_5
+#define TIMER1_COMPA_vect	__vector_6
+#define TIMER1_COMPB_vect	__vector_7
+#define TIMER1_OVF_vect		__vector_8
+#define TIMER0_OVF_vect		__vector_9
+#define SPI_STC_vect		__vector_10
+#define USART_RXC_vect		__vector_11
+#define USART_UDRE_vect		__vector_12
+#define USART_TXC_vect		__vector_13
+#define ADC_vect			__vector_14
+#define EE_RDY_vect			__vector_15
+#define ANA_COMP_vect		__vector_16
+#define TWI_vect			__vector_17
+#define SPM_RDY_vect		__vector_18
+
+#define _VECTORS_SIZE 19
+
+#endif /* HOST_AVR_IO_H_ */
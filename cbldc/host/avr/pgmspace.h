@@ -0,0 +1,20 @@
+/*
+ * pgmspace.h
+ *
+ * Host build replacement of <avr/pgmspace.h>. There's just one address space.
+ */
+
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,26 @@
+/*
+ * wdt.h
+ *
+ * Host build replacement of <avr/wdt.h>.
+ */
+
+
+#ifndef HOST_AVR_WDT_H_
+#define HOST_AVR_WDT_H_
+
+#include <avr/io.h>
+
+#define WDTO_15MS	0
+#define WDTO_30MS	1
+#define WDTO_60MS	2
+#define WDTO_120MS	3
+#define WDTO_250MS	4
+#define WDTO_500MS	5
+#define WDTO_1S		6
+#define WDTO_2S		7
+
+#define wdt_reset() mcu_wdt_reset()
+#define wdt_enable(timeout) mcu_wdt_enable(timeout)
+#define wdt_disable() mcu_wdt_enable(-1)
+
+#endif /* HOST_AVR_WDT_H_ */
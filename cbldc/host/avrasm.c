@@ -0,0 +1,847 @@
+/*
+ * avrasm.c
+ *
+ * Host build: cycle counting AVR assembly interpreter, see avrasm.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "avrasm.h"
+
+#define MAX_INSNS 2048
+#define MAX_LABELS 512
+#define MAX_SYMBOLS 32
+#define MAX_NESTING 16
+#define MAX_MACROS 8
+#define MAX_MACRO_PARAMS 4
+#define MAX_MACRO_LINES 64
+#define MAX_CYCLES 1000000L
+#define POINTER_INC 0x100						// st X+
+
+// SREG bits
+#define S_C 0
+#define S_Z 1
+#define S_N 2
+#define S_V 3
+#define S_S 4
+#define S_H 5
+#define S_T 6
+#define S_I 7
+#define SREG 0x3F
+#define TIFR 0x38							// Interrupt flag registers, writing a 1 clears the flag
+#define GIFR 0x3A
+
+typedef enum {
+	OP_NOP, OP_WDR, OP_IN, OP_OUT, OP_MOV, OP_MOVW, OP_LDI, OP_LDS, OP_STS, OP_ST, OP_PUSH, OP_POP,
+	OP_ADD, OP_ADC, OP_SUB, OP_SBC, OP_SUBI, OP_SBCI, OP_CP, OP_CPC, OP_CPI,
+	OP_AND, OP_ANDI, OP_OR, OP_ORI, OP_EOR, OP_COM, OP_NEG, OP_INC, OP_DEC,
+	OP_LSR, OP_ROR, OP_SWAP, OP_MUL, OP_BST, OP_BLD, OP_SET, OP_CLT,
+	OP_SBRC, OP_SBRS, OP_SBIC, OP_SBIS, OP_SBI, OP_CBI,
+	OP_BRBS, OP_BRBC, OP_RJMP, OP_RCALL, OP_RET, OP_RETI
+} opcode;
+
+typedef struct {
+	opcode op;
+	int a;
+	int b;
+	uint8_t words;
+	int target;								// Branch target address, -1 if by label
+	char label[32];							// Branch target or data symbol
+	const char* file;
+	int line;
+} insn;
+
+typedef struct {
+	char name[48];
+	int addr;
+} label;
+
+static insn prog[MAX_INSNS];
+static int prog_len;
+static label labels[MAX_LABELS];
+static int labels_len;
+static struct {
+	char name[32];
+	int offset;								// In avrasm_cpu.ram
+	int size;
+} symbols[MAX_SYMBOLS];
+static int symbols_len;
+static int symbols_size;
+
+static const char* err_file;
+static int err_line;
+
+static int fail(const char* msg, const char* arg)
+{
+	fprintf(stderr, "%s:%d: %s %s\n", err_file, err_line, msg, arg? arg : "");
+	return -1;
+}
+
+// *------------------*
+// |   Expressions    |
+// *------------------*
+
+// Constant expressions in .if and operands, C operators and precedence.
+static const char* ex_p;
+static int ex_err;
+static int ex_symbols;						// Inside lo8()/hi8(), data symbols are addresses
+
+static long ex_binary(int prec);
+static int symbol_offset(const char* symbol, int size);
+
+static void ex_space()
+{
+	while (isspace((unsigned char)*ex_p)) ex_p++;
+}
+
+static long ex_primary()
+{
+	ex_space();
+	if (*ex_p == '(') {
+		ex_p++;
+		long v = ex_binary(0);
+		ex_space();
+		if (*ex_p == ')') ex_p++;
+		else ex_err = 1;
+		return v;
+	}
+	if (*ex_p == '+') {
+		ex_p++;
+		return ex_primary();
+	}
+	if (*ex_p == '-') {
+		ex_p++;
+		return -ex_primary();
+	}
+	if (*ex_p == '~') {
+		ex_p++;
+		return ~ex_primary();
+	}
+	if (*ex_p == '!') {
+		ex_p++;
+		return !ex_primary();
+	}
+	if (isdigit((unsigned char)*ex_p)) {
+		char* end;
+		long v = strtol(ex_p, &end, 0);
+		ex_p = end;
+		while (*ex_p == 'u' || *ex_p == 'U' || *ex_p == 'l' || *ex_p == 'L') ex_p++;
+		return v;
+	}
+	if (isalpha((unsigned char)*ex_p) || *ex_p == '_') {
+		char name[32];
+		size_t n = 0;
+		while ((isalnum((unsigned char)*ex_p) || *ex_p == '_') && n < sizeof(name) - 1) name[n++] = *ex_p++;
+		name[n] = 0;
+		ex_space();
+		if ((!strcmp(name, "lo8") || !strcmp(name, "hi8")) && *ex_p == '(') {
+			ex_symbols++;
+			long v = ex_primary();
+			ex_symbols--;
+			return name[0] == 'l'? v & 0xFF : (v >> 8) & 0xFF;
+		}
+		if (ex_symbols) return AVRASM_RAM_START + symbol_offset(name, 4);
+	}
+	ex_err = 1;
+	return 0;
+}
+
+static const struct {
+	const char* s;
+	int prec;
+} ex_ops[] = {
+	{"||", 1}, {"&&", 2}, {"|", 3}, {"^", 4}, {"&", 5}, {"==", 6}, {"!=", 6},
+	{"<<", 8}, {">>", 8}, {"<=", 7}, {">=", 7}, {"<", 7}, {">", 7},
+	{"+", 9}, {"-", 9}, {"*", 10}, {"/", 10}, {"%", 10}
+};
+
+static long ex_binary(int prec)
+{
+	long l = ex_primary();
+	while (!ex_err) {
+		uint8_t i;
+		ex_space();
+		for (i = 0; i < sizeof(ex_ops) / sizeof(ex_ops[0]); i++) {
+			size_t n = strlen(ex_ops[i].s);
+			if (!strncmp(ex_p, ex_ops[i].s, n)) {
+				// "|" must not match "||", "&" not "&&"
+				if (n == 1 && (ex_p[1] == '|' || ex_p[1] == '&') && ex_p[1] == ex_p[0]) continue;
+				break;
+			}
+		}
+		if (i == sizeof(ex_ops) / sizeof(ex_ops[0]) || ex_ops[i].prec <= prec) return l;
+		const char* op = ex_ops[i].s;
+		ex_p += strlen(op);
+		long r = ex_binary(ex_ops[i].prec);
+		if (!strcmp(op, "||")) l = l || r;
+		else if (!strcmp(op, "&&")) l = l && r;
+		else if (!strcmp(op, "|")) l |= r;
+		else if (!strcmp(op, "^")) l ^= r;
+		else if (!strcmp(op, "&")) l &= r;
+		else if (!strcmp(op, "==")) l = l == r;
+		else if (!strcmp(op, "!=")) l = l != r;
+		else if (!strcmp(op, "<<")) l <<= r;
+		else if (!strcmp(op, ">>")) l >>= r;
+		else if (!strcmp(op, "<=")) l = l <= r;
+		else if (!strcmp(op, ">=")) l = l >= r;
+		else if (!strcmp(op, "<")) l = l < r;
+		else if (!strcmp(op, ">")) l = l > r;
+		else if (!strcmp(op, "+")) l += r;
+		else if (!strcmp(op, "-")) l -= r;
+		else if (!strcmp(op, "*")) l *= r;
+		else if (r == 0) ex_err = 1;
+		else if (!strcmp(op, "/")) l /= r;
+		else l %= r;
+	}
+	return l;
+}
+
+static int eval(const char* s, long* v)
+{
+	ex_p = s;
+	ex_err = 0;
+	*v = ex_binary(0);
+	ex_space();
+	if (ex_err || *ex_p) return fail("bad expression:", s);
+	return 0;
+}
+
+// *------------------*
+// |      Loader      |
+// *------------------*
+
+static const struct {
+	const char* name;
+	opcode op;
+	uint8_t args;			// Operand kinds: 'r' register, 'k' constant, 'l' label, 's' data symbol,
+							// 'p' pointer register X, Y or Z, optionally post-incremented
+	const char* kinds;
+	int b;					// Implied second operand (SREG bit for branches)
+} mnemonics[] = {
+	{"nop", OP_NOP, 0, "", 0}, {"wdr", OP_WDR, 0, "", 0},
+	{"in", OP_IN, 2, "rk", 0}, {"out", OP_OUT, 2, "kr", 0},
+	{"mov", OP_MOV, 2, "rr", 0}, {"ldi", OP_LDI, 2, "rk", 0},
+	{"lds", OP_LDS, 2, "rs", 0}, {"sts", OP_STS, 2, "sr", 0}, {"st", OP_ST, 2, "pr", 0},
+	{"push", OP_PUSH, 1, "r", 0}, {"pop", OP_POP, 1, "r", 0},
+	{"add", OP_ADD, 2, "rr", 0}, {"adc", OP_ADC, 2, "rr", 0},
+	{"lsl", OP_ADD, 1, "r", 1}, {"rol", OP_ADC, 1, "r", 1},		// b = 1: Rd, Rd
+	{"sub", OP_SUB, 2, "rr", 0}, {"sbc", OP_SBC, 2, "rr", 0},
+	{"subi", OP_SUBI, 2, "rk", 0}, {"sbci", OP_SBCI, 2, "rk", 0},
+	{"cp", OP_CP, 2, "rr", 0}, {"cpc", OP_CPC, 2, "rr", 0}, {"cpi", OP_CPI, 2, "rk", 0},
+	{"and", OP_AND, 2, "rr", 0}, {"andi", OP_ANDI, 2, "rk", 0},
+	{"or", OP_OR, 2, "rr", 0}, {"ori", OP_ORI, 2, "rk", 0}, {"sbr", OP_ORI, 2, "rk", 0},
+	{"cbr", OP_ANDI, 2, "rk", 1},			// b = 1: complement the constant
+	{"eor", OP_EOR, 2, "rr", 0}, {"clr", OP_EOR, 1, "r", 1},		// b = 1: Rd, Rd
+	{"tst", OP_AND, 1, "r", 1},
+	{"com", OP_COM, 1, "r", 0}, {"neg", OP_NEG, 1, "r", 0},
+	{"inc", OP_INC, 1, "r", 0}, {"dec", OP_DEC, 1, "r", 0},
+	{"lsr", OP_LSR, 1, "r", 0}, {"ror", OP_ROR, 1, "r", 0}, {"swap", OP_SWAP, 1, "r", 0},
+	{"mul", OP_MUL, 2, "rr", 0}, {"movw", OP_MOVW, 2, "rr", 0},
+	{"bst", OP_BST, 2, "rk", 0}, {"bld", OP_BLD, 2, "rk", 0},
+	{"set", OP_SET, 0, "", 0}, {"clt", OP_CLT, 0, "", 0},
+	{"sbrc", OP_SBRC, 2, "rk", 0}, {"sbrs", OP_SBRS, 2, "rk", 0},
+	{"sbic", OP_SBIC, 2, "kk", 0}, {"sbis", OP_SBIS, 2, "kk", 0},
+	{"sbi", OP_SBI, 2, "kk", 0}, {"cbi", OP_CBI, 2, "kk", 0},
+	{"brcs", OP_BRBS, 1, "l", S_C}, {"brlo", OP_BRBS, 1, "l", S_C},
+	{"brcc", OP_BRBC, 1, "l", S_C}, {"brsh", OP_BRBC, 1, "l", S_C},
+	{"breq", OP_BRBS, 1, "l", S_Z}, {"brne", OP_BRBC, 1, "l", S_Z},
+	{"brmi", OP_BRBS, 1, "l", S_N}, {"brpl", OP_BRBC, 1, "l", S_N},
+	{"brlt", OP_BRBS, 1, "l", S_S}, {"brge", OP_BRBC, 1, "l", S_S},
+	{"brts", OP_BRBS, 1, "l", S_T}, {"brtc", OP_BRBC, 1, "l", S_T},
+	{"rjmp", OP_RJMP, 1, "l", 0}, {"rcall", OP_RCALL, 1, "l", 0},
+	{"ret", OP_RET, 0, "", 0}, {"reti", OP_RETI, 0, "", 0}
+};
+
+static char* trim(char* s)
+{
+	while (isspace((unsigned char)*s)) s++;
+	char* e = s + strlen(s);
+	while (e > s && isspace((unsigned char)e[-1])) *--e = 0;
+	return s;
+}
+
+static int is_ident_char(char c)
+{
+	return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$';
+}
+
+static int add_label(const char* name, int addr)
+{
+	int i;
+	for (i = 0; i < labels_len; i++) {
+		if (!strcmp(labels[i].name, name)) return fail("duplicate label", name);
+	}
+	if (labels_len >= MAX_LABELS || strlen(name) >= sizeof(labels[0].name)) return fail("too many labels", 0);
+	strcpy(labels[labels_len].name, name);
+	labels[labels_len++].addr = addr;
+	return 0;
+}
+
+static int operand(insn* in, char kind, char* s, int* value)
+{
+	s = trim(s);
+	long v;
+	switch (kind) {
+		case 'r':
+			if ((s[0] != 'r' && s[0] != 'R') || eval(s + 1, &v) || v < 0 || v > 31) return fail("bad register", s);
+			*value = v;
+			return 0;
+		case 'p':
+			if ((s[0] != 'X' && s[0] != 'Y' && s[0] != 'Z') || (s[1] && strcmp(s + 1, "+"))) return fail("bad pointer", s);
+			*value = 26 + 2 * (s[0] - 'X') + (s[1]? POINTER_INC : 0);
+			return 0;
+		case 'l':
+			if (s[0] == '.' && (s[1] == '+' || s[1] == '-')) {
+				if (eval(s + 1, &v)) return -1;
+				in->target = prog_len + 1 + v / 2;			// Byte offset from the next instruction
+				return 0;
+			}
+			if (strlen(s) >= sizeof(in->label)) return fail("bad label", s);
+			strcpy(in->label, s);
+			return 0;
+		case 's': {
+			// symbol or symbol+offset
+			char* plus = strchr(s, '+');
+			if (plus) {
+				*plus = 0;
+				if (eval(plus + 1, &v)) return -1;
+			}
+			else v = 0;
+			s = trim(s);
+			if (strlen(s) >= sizeof(in->label)) return fail("bad symbol", s);
+			strcpy(in->label, s);
+			*value = v;
+			return 0;
+		}
+		default:
+			if (eval(s, &v)) return -1;
+			*value = v;
+			return 0;
+	}
+}
+
+static int parse_insn(char* s, const char* file, int line)
+{
+	char* args = s;
+	while (*args && !isspace((unsigned char)*args)) args++;
+	if (*args) *args++ = 0;
+	uint8_t i;
+	for (i = 0; i < sizeof(mnemonics) / sizeof(mnemonics[0]); i++) {
+		if (!strcmp(mnemonics[i].name, s)) break;
+	}
+	if (i == sizeof(mnemonics) / sizeof(mnemonics[0])) return fail("unsupported instruction", s);
+	if (prog_len >= MAX_INSNS) return fail("program too long", 0);
+
+	insn* in = &prog[prog_len];
+	memset(in, 0, sizeof(*in));
+	in->op = mnemonics[i].op;
+	in->b = mnemonics[i].b;
+	in->target = -1;
+	in->words = in->op == OP_LDS || in->op == OP_STS? 2 : 1;
+	in->file = file;
+	in->line = line;
+
+	char* ops[2] = {0, 0};
+	uint8_t n = 0;
+	char* tok = trim(args);
+	if (*tok) {
+		ops[n++] = tok;
+		char* comma = strchr(tok, ',');
+		if (comma) {
+			*comma = 0;
+			ops[n++] = comma + 1;
+		}
+	}
+	if (n != mnemonics[i].args) return fail("wrong operand count:", s);
+
+	int v[2] = {0, 0};
+	uint8_t k;
+	for (k = 0; k < n; k++) {
+		if (operand(in, mnemonics[i].kinds[k], ops[k], &v[k])) return -1;
+	}
+	switch (in->op) {
+		case OP_ADD:
+		case OP_ADC:
+		case OP_EOR:
+		case OP_AND:
+			in->a = v[0];
+			in->b = in->b? v[0] : v[1];				// lsl/rol/clr/tst Rd = add/adc/eor/and Rd, Rd
+			break;
+		case OP_ANDI:
+			in->a = v[0];
+			in->b = in->b? (uint8_t)~v[1] : v[1];	// cbr Rd, K = andi Rd, ~K
+			break;
+		case OP_OUT:
+		case OP_STS:
+		case OP_ST:
+			in->a = v[1];							// a is always the register
+			in->b = v[0];
+			break;
+		case OP_BRBS:
+		case OP_BRBC:
+			break;									// b is the SREG bit
+		case OP_MOVW:
+			if ((v[0] | v[1]) & 1) return fail("movw needs even registers", 0);
+			in->a = v[0];
+			in->b = v[1];
+			break;
+		default:
+			in->a = v[0];
+			in->b = v[1];
+	}
+	prog_len++;
+
+	// Filler for the second word, so that the index into prog[] is the word address
+	if (in->words == 2) {
+		if (prog_len >= MAX_INSNS) return fail("program too long", 0);
+		prog[prog_len] = *in;
+		prog[prog_len++].words = 0;
+	}
+	return 0;
+}
+
+// .macro name params ... .endm, expanded with \param replaced by the arguments
+static struct {
+	char name[32];
+	char params[MAX_MACRO_PARAMS][16];
+	uint8_t nparams;
+	char* body[MAX_MACRO_LINES];
+	uint8_t nlines;
+} macros[MAX_MACROS];
+static int macros_len;
+static int recording = -1;					// Macro whose body is being read
+
+static uint8_t active[MAX_NESTING];
+static uint8_t depth;
+
+static int load_line(char* s, const char* file, int line, int expansion);
+
+static int macro_define(char* s)
+{
+	if (macros_len >= MAX_MACROS) return fail("too many macros", 0);
+	char* tok = strtok(s, " \t,");
+	if (!tok || strlen(tok) >= sizeof(macros[0].name)) return fail("bad .macro", 0);
+	strcpy(macros[macros_len].name, tok);
+	macros[macros_len].nparams = 0;
+	macros[macros_len].nlines = 0;
+	while ((tok = strtok(0, " \t,"))) {
+		if (macros[macros_len].nparams >= MAX_MACRO_PARAMS || strlen(tok) >= sizeof(macros[0].params[0]))
+			return fail("bad .macro parameter", tok);
+		strcpy(macros[macros_len].params[macros[macros_len].nparams++], tok);
+	}
+	recording = macros_len++;
+	return 0;
+}
+
+static int macro_find(const char* s)
+{
+	int i;
+	size_t n = 0;
+	while (s[n] && !isspace((unsigned char)s[n])) n++;
+	for (i = 0; i < macros_len; i++) {
+		if (strlen(macros[i].name) == n && !strncmp(macros[i].name, s, n)) return i;
+	}
+	return -1;
+}
+
+static int macro_expand(int m, char* s, const char* file, int line, int expansion)
+{
+	if (expansion >= MAX_NESTING) return fail("macro nested too deep", macros[m].name);
+	char* args[MAX_MACRO_PARAMS];
+	uint8_t n = 0;
+	char* tok = strtok(s + strlen(macros[m].name), ",");
+	while (tok) {
+		if (n >= macros[m].nparams) return fail("too many macro arguments:", macros[m].name);
+		args[n++] = trim(tok);
+		tok = strtok(0, ",");
+	}
+	if (n != macros[m].nparams) return fail("wrong macro argument count:", macros[m].name);
+
+	uint8_t i;
+	for (i = 0; i < macros[m].nlines; i++) {
+		char buf[512];
+		char* d = buf;
+		const char* p = macros[m].body[i];
+		while (*p && d < buf + sizeof(buf) - 1) {
+			uint8_t k;
+			if (*p == '\\') {
+				for (k = 0; k < n; k++) {
+					size_t len = strlen(macros[m].params[k]);
+					if (!strncmp(p + 1, macros[m].params[k], len) && !is_ident_char(p[1 + len])) break;
+				}
+				if (k < n) {
+					size_t len = strlen(args[k]);
+					if (d + len >= buf + sizeof(buf) - 1) break;
+					strcpy(d, args[k]);
+					d += len;
+					p += 1 + strlen(macros[m].params[k]);
+					continue;
+				}
+			}
+			*d++ = *p++;
+		}
+		*d = 0;
+		if (load_line(buf, file, line, expansion + 1)) return -1;
+	}
+	return 0;
+}
+
+static int load_line(char* s, const char* file, int line, int expansion)
+{
+	char* p;
+	s = trim(s);
+
+	// Macro body, kept as is until .endm
+	if (recording >= 0) {
+		if (!strcmp(s, ".endm")) {
+			recording = -1;
+			return 0;
+		}
+		if (macros[recording].nlines >= MAX_MACRO_LINES) return fail("macro too long:", macros[recording].name);
+		macros[recording].body[macros[recording].nlines++] = strdup(s);
+		return 0;
+	}
+
+	// Labels
+	while (1) {
+		p = s;
+		while (is_ident_char(*p)) p++;
+		if (p == s || *p != ':') break;
+		*p = 0;
+		if (active[depth] && add_label(s, prog_len)) return -1;
+		s = trim(p + 1);
+	}
+	if (!*s) return 0;
+
+	// Directives
+	if (*s == '.') {
+		long v;
+		if (!strncmp(s, ".if", 3) && isspace((unsigned char)s[3])) {
+			if (depth + 1 >= MAX_NESTING) return fail(".if nested too deep", 0);
+			v = 0;
+			if (active[depth] && eval(s + 3, &v)) return -1;
+			depth++;
+			active[depth] = active[depth - 1] && v;
+		}
+		else if (!strcmp(s, ".else")) {
+			if (!depth) return fail(".else without .if", 0);
+			active[depth] = active[depth - 1] && !active[depth];
+		}
+		else if (!strcmp(s, ".endif")) {
+			if (!depth) return fail(".endif without .if", 0);
+			depth--;
+		}
+		else if (!strncmp(s, ".error", 6)) {
+			if (active[depth]) return fail(".error", s + 6);
+		}
+		else if (!strncmp(s, ".macro", 6) && isspace((unsigned char)s[6])) {
+			if (active[depth]) return macro_define(s + 6);
+		}
+		// .global, .extern, .section...: nothing to do here
+		return 0;
+	}
+	if (!active[depth]) return 0;
+	int m = macro_find(s);
+	if (m >= 0) return macro_expand(m, s, file, line, expansion);
+	return parse_insn(s, file, line);
+}
+
+int avrasm_load(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	char* file = strdup(path);
+	char buf[512];
+	int line = 0;
+	depth = 0;
+	active[0] = 1;
+	err_file = file;
+	while (fgets(buf, sizeof(buf), f)) {
+		err_line = ++line;
+
+		// Strip the comment, keeping ';' inside strings
+		char* p;
+		uint8_t quoted = 0;
+		for (p = buf; *p; p++) {
+			if (*p == '"') quoted = !quoted;
+			else if (*p == ';' && !quoted) {
+				*p = 0;
+				break;
+			}
+		}
+		if (load_line(buf, file, line, 0)) {
+			fclose(f);
+			return -1;
+		}
+	}
+	fclose(f);
+	if (recording >= 0) return fail("missing .endm", 0);
+	if (depth) return fail("missing .endif", 0);
+	return 0;
+}
+
+// *------------------*
+// |     Execution    |
+// *------------------*
+
+static int symbol_offset(const char* symbol, int size)
+{
+	int i;
+	for (i = 0; i < symbols_len; i++) {
+		if (!strcmp(symbols[i].name, symbol)) {
+			if (size > symbols[i].size) {
+				fprintf(stderr, "avrasm: %s declared after its first use\n", symbol);
+				exit(1);
+			}
+			return symbols[i].offset;
+		}
+	}
+	if (symbols_len >= MAX_SYMBOLS || symbols_size + size > AVRASM_RAM_SIZE) {
+		fprintf(stderr, "avrasm: too many data symbols\n");
+		exit(1);
+	}
+	strncpy(symbols[i].name, symbol, sizeof(symbols[0].name) - 1);
+	symbols[i].offset = symbols_size;
+	symbols[i].size = size;
+	symbols_len++;
+	symbols_size += size;
+	return symbols[i].offset;
+}
+
+int avrasm_words(void)
+{
+	return prog_len;
+}
+
+void avrasm_data(const char* symbol, int size)
+{
+	symbol_offset(symbol, size);
+}
+
+uint8_t* avrasm_ram(avrasm_cpu* cpu, const char* symbol)
+{
+	return &cpu->ram[symbol_offset(symbol, 4)];
+}
+
+static int find_label(const char* name)
+{
+	int i;
+	for (i = 0; i < labels_len; i++) {
+		if (!strcmp(labels[i].name, name)) return labels[i].addr;
+	}
+	return -1;
+}
+
+static void flag(avrasm_cpu* cpu, uint8_t bit, int value)
+{
+	if (value) cpu->io[SREG] |= 1 << bit;
+	else cpu->io[SREG] &= ~(1 << bit);
+}
+
+static int flag_get(avrasm_cpu* cpu, uint8_t bit)
+{
+	return (cpu->io[SREG] >> bit) & 1;
+}
+
+// N, Z and S from the result, V as given
+static void flags_nzvs(avrasm_cpu* cpu, uint8_t r, int v)
+{
+	flag(cpu, S_N, r & 0x80);
+	flag(cpu, S_Z, r == 0);
+	flag(cpu, S_V, v);
+	flag(cpu, S_S, ((r & 0x80) != 0) ^ (v != 0));
+}
+
+static uint8_t alu_add(avrasm_cpu* cpu, uint8_t d, uint8_t r, int c)
+{
+	uint16_t sum = d + r + c;
+	uint8_t res = sum;
+	flag(cpu, S_C, sum > 0xFF);
+	flag(cpu, S_H, ((d & 0x0F) + (r & 0x0F) + c) > 0x0F);
+	flags_nzvs(cpu, res, (~(d ^ r) & (d ^ res)) & 0x80);
+	return res;
+}
+
+// Subtraction. keep_z: SBC/SBCI/CPC only clear Z, never set it.
+static uint8_t alu_sub(avrasm_cpu* cpu, uint8_t d, uint8_t r, int c, int keep_z)
+{
+	uint8_t res = d - r - c;
+	int z = flag_get(cpu, S_Z);
+	flag(cpu, S_C, (int)d < (int)r + c);
+	flag(cpu, S_H, (d & 0x0F) < (r & 0x0F) + c);
+	flags_nzvs(cpu, res, ((d ^ r) & (d ^ res)) & 0x80);
+	if (keep_z) flag(cpu, S_Z, z && res == 0);
+	return res;
+}
+
+// Runs until the outermost end, reti for an ISR, ret for a function
+static long run(avrasm_cpu* cpu, const char* name, opcode end)
+{
+	int pc = find_label(name);
+	int stack[MAX_NESTING];
+	uint8_t sp = 0;
+	uint8_t data[32];
+	uint8_t dsp = 0;
+	long cycles = 0;
+	if (pc < 0) {
+		fprintf(stderr, "avrasm: no label %s\n", name);
+		return -1;
+	}
+	while (cycles < MAX_CYCLES) {
+		if (pc < 0 || pc >= prog_len) {
+			fprintf(stderr, "avrasm: %s ran off the program\n", name);
+			return -1;
+		}
+		const insn* in = &prog[pc];
+		if (!in->words) {
+			fprintf(stderr, "avrasm: %s jumps into the middle of %s:%d\n", name, in->file, in->line);
+			return -1;
+		}
+		uint8_t* rd = &cpu->r[in->a & 31];
+		uint8_t rr = cpu->r[in->b & 31];
+		uint8_t k = in->b;
+		int next = pc + in->words;
+		int skip = 0;
+		int branch = 0;
+		cycles++;
+		switch (in->op) {
+			case OP_NOP:
+			case OP_WDR: break;
+			case OP_IN: *rd = cpu->io[in->b & 63]; break;
+			case OP_OUT:
+				if ((in->b & 63) == TIFR || (in->b & 63) == GIFR) cpu->io[in->b & 63] &= ~*rd;
+				else cpu->io[in->b & 63] = *rd;
+				break;
+			case OP_MOV: *rd = rr; break;
+			case OP_MOVW: rd[0] = rr; rd[1] = cpu->r[(in->b + 1) & 31]; break;
+			case OP_LDI: *rd = k; break;
+			case OP_LDS: *rd = avrasm_ram(cpu, in->label)[in->b]; cycles++; break;
+			case OP_STS: avrasm_ram(cpu, in->label)[in->b] = *rd; cycles++; break;
+			case OP_ST: {
+				uint8_t* p = &cpu->r[in->b & 31];
+				uint16_t addr = p[0] | p[1] << 8;
+				if (addr < AVRASM_RAM_START || addr >= AVRASM_RAM_START + AVRASM_RAM_SIZE) {
+					fprintf(stderr, "%s:%d: st outside the data symbols: 0x%04X\n", in->file, in->line, addr);
+					return -1;
+				}
+				cpu->ram[addr - AVRASM_RAM_START] = *rd;
+				if (in->b & POINTER_INC) {
+					addr++;
+					p[0] = addr;
+					p[1] = addr >> 8;
+				}
+				cycles++;
+				break;
+			}
+			case OP_PUSH: data[dsp++ & 31] = *rd; cycles++; break;
+			case OP_POP: *rd = data[--dsp & 31]; cycles++; break;
+			case OP_ADD: *rd = alu_add(cpu, *rd, rr, 0); break;
+			case OP_ADC: *rd = alu_add(cpu, *rd, rr, flag_get(cpu, S_C)); break;
+			case OP_SUB: *rd = alu_sub(cpu, *rd, rr, 0, 0); break;
+			case OP_SBC: *rd = alu_sub(cpu, *rd, rr, flag_get(cpu, S_C), 1); break;
+			case OP_SUBI: *rd = alu_sub(cpu, *rd, k, 0, 0); break;
+			case OP_SBCI: *rd = alu_sub(cpu, *rd, k, flag_get(cpu, S_C), 1); break;
+			case OP_CP: alu_sub(cpu, *rd, rr, 0, 0); break;
+			case OP_CPC: alu_sub(cpu, *rd, rr, flag_get(cpu, S_C), 1); break;
+			case OP_CPI: alu_sub(cpu, *rd, k, 0, 0); break;
+			case OP_AND: *rd &= rr; flags_nzvs(cpu, *rd, 0); break;
+			case OP_ANDI: *rd &= k; flags_nzvs(cpu, *rd, 0); break;
+			case OP_OR: *rd |= rr; flags_nzvs(cpu, *rd, 0); break;
+			case OP_ORI: *rd |= k; flags_nzvs(cpu, *rd, 0); break;
+			case OP_EOR: *rd ^= rr; flags_nzvs(cpu, *rd, 0); break;
+			case OP_COM: *rd = ~*rd; flag(cpu, S_C, 1); flags_nzvs(cpu, *rd, 0); break;
+			case OP_NEG: *rd = alu_sub(cpu, 0, *rd, 0, 0); break;
+			case OP_INC: flags_nzvs(cpu, *rd + 1, *rd == 0x7F); (*rd)++; break;
+			case OP_DEC: flags_nzvs(cpu, *rd - 1, *rd == 0x80); (*rd)--; break;
+			case OP_LSR:
+				flag(cpu, S_C, *rd & 1);
+				*rd >>= 1;
+				flags_nzvs(cpu, *rd, *rd & 1);		// V = N ^ C, N is 0
+				break;
+			case OP_ROR: {
+				uint8_t c = flag_get(cpu, S_C);
+				flag(cpu, S_C, *rd & 1);
+				*rd = (*rd >> 1) | (c << 7);
+				flags_nzvs(cpu, *rd, ((*rd >> 7) ^ flag_get(cpu, S_C)) & 1);
+				break;
+			}
+			case OP_SWAP: *rd = (*rd << 4) | (*rd >> 4); break;
+			case OP_MUL: {
+				uint16_t p = *rd * rr;
+				cpu->r[0] = p;
+				cpu->r[1] = p >> 8;
+				flag(cpu, S_C, p & 0x8000);
+				flag(cpu, S_Z, p == 0);
+				cycles++;
+				break;
+			}
+			case OP_BST: flag(cpu, S_T, (*rd >> (k & 7)) & 1); break;
+			case OP_BLD:
+				if (flag_get(cpu, S_T)) *rd |= 1 << (k & 7);
+				else *rd &= ~(1 << (k & 7));
+				break;
+			case OP_SET: flag(cpu, S_T, 1); break;
+			case OP_CLT: flag(cpu, S_T, 0); break;
+			case OP_SBRC: skip = !((*rd >> (k & 7)) & 1); break;
+			case OP_SBRS: skip = (*rd >> (k & 7)) & 1; break;
+			case OP_SBIC: skip = !((cpu->io[in->a & 63] >> (k & 7)) & 1); break;
+			case OP_SBIS: skip = (cpu->io[in->a & 63] >> (k & 7)) & 1; break;
+			case OP_SBI: cpu->io[in->a & 63] |= 1 << (k & 7); cycles++; break;
+			case OP_CBI: cpu->io[in->a & 63] &= ~(1 << (k & 7)); cycles++; break;
+			case OP_BRBS: branch = flag_get(cpu, in->b); break;
+			case OP_BRBC: branch = !flag_get(cpu, in->b); break;
+			case OP_RJMP: branch = 1; break;
+			case OP_RCALL:
+				if (sp >= MAX_NESTING) {
+					fprintf(stderr, "avrasm: stack overflow in %s\n", name);
+					return -1;
+				}
+				stack[sp++] = next;
+				cycles += 2;
+				branch = 1;
+				break;
+			case OP_RET:
+			case OP_RETI:
+				cycles += 3;
+				if (!sp) {
+					if (in->op == end) return cycles;
+					fprintf(stderr, "avrasm: %s returns with %s\n", name, in->op == OP_RET? "ret" : "reti");
+					return -1;
+				}
+				next = stack[--sp];
+				break;
+		}
+		if (skip) {
+			cycles += prog[next].words;
+			next += prog[next].words;
+		}
+		if (branch) {
+			if (in->op == OP_BRBS || in->op == OP_BRBC) cycles++;
+			else if (in->op == OP_RJMP) cycles++;
+			int target = in->target >= 0? in->target : find_label(in->label);
+			if (target < 0) {
+				fprintf(stderr, "%s:%d: unknown label %s\n", in->file, in->line, in->label);
+				return -1;
+			}
+			next = target;
+		}
+		pc = next;
+	}
+	fprintf(stderr, "avrasm: %s doesn't return\n", name);
+	return -1;
+}
+
+long avrasm_run(avrasm_cpu* cpu, const char* name)
+{
+	return run(cpu, name, OP_RETI);
+}
+
+long avrasm_call(avrasm_cpu* cpu, const char* name)
+{
+	return run(cpu, name, OP_RET);
+}
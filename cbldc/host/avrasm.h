@@ -0,0 +1,48 @@
+/*
+ * avrasm.h
+ *
+ * Host build: cycle counting interpreter for the hand written AVR assembly, used by the ISR
+ * and speed benchmarks. It loads the preprocessed .s files (gcc -E -x assembler-with-cpp) and
+ * runs a routine from a label until its reti or ret, counting ATmega8 clock cycles per instruction.
+ *
+ * Only the instructions and directives the firmware's asm actually uses are supported,
+ * anything else is reported as an error with its file and line, so a new instruction in
+ * pwm.s can't silently go uncounted.
+ */
+
+
+#ifndef AVRASM_H_
+#define AVRASM_H_
+
+#include <stdint.h>
+
+#define AVRASM_RAM_START 0x60					// ATmega8 SRAM, for lo8()/hi8() of data symbols
+#define AVRASM_RAM_SIZE 128
+
+typedef struct {
+	uint8_t r[32];
+	uint8_t io[64];							// SREG is io[0x3F]
+	uint8_t ram[AVRASM_RAM_SIZE];			// Data symbols used by lds/sts, see avrasm_ram()
+} avrasm_cpu;
+
+// Loads a preprocessed asm file into the program, returns 0 on success
+int avrasm_load(const char* path);
+
+// Program words loaded so far, the flash size of the code is twice that
+int avrasm_words(void);
+
+// Address of a data symbol in cpu->ram, allocated on first use with four bytes
+uint8_t* avrasm_ram(avrasm_cpu* cpu, const char* symbol);
+
+// Allocates a data symbol larger than four bytes, before the asm using it is loaded
+void avrasm_data(const char* symbol, int size);
+
+// Runs from the label until the outermost reti. Returns the cycles spent including the reti,
+// or -1 if the label doesn't exist or the code doesn't return.
+long avrasm_run(avrasm_cpu* cpu, const char* label);
+
+// Same for a function called from C, until the outermost ret. Arguments and the result are in
+// the registers of the avr-gcc calling convention, r25:r24 for the first 16 bit one.
+long avrasm_call(avrasm_cpu* cpu, const char* label);
+
+#endif /* AVRASM_H_ */
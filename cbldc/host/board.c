@@ -0,0 +1,145 @@
+/*
+ * board.c
+ *
+ * Host build: decodes the FET control pins, comparator channels and current sense of the selected
+ * board.
+ * With PWM_HARDWARE the low side is additionally gated by the OC2 output.
+ */
+
+#define MCU_SFR_ADDRESSES
+#include <avr/io.h>
+#include "../bldc.h"
+#include "mcu.h"
+#include "board.h"
+#include "motor.h"
+
+const uint32_t board_f_cpu = F_CPU;
+const uint8_t board_signal_type = INPUT_SIGNAL_TYPE;
+
+#if INPUT_SIGNAL_TYPE == 3
+const uint16_t board_dshot_rate = DSHOT_RATE;
+const uint8_t board_dshot_telemetry = DSHOT_TELEMETRY;
+#else
+const uint16_t board_dshot_rate = 0;
+const uint8_t board_dshot_telemetry = 0;
+#endif
+
+#if INPUT_SIGNAL_TYPE == 2
+const uint8_t board_i2c_address = I2C_SLAVE_ADDRESS;
+#else
+const uint8_t board_i2c_address = 0;
+#endif
+
+const uint8_t board_uart_telemetry = UART_TELEMETRY;
+
+// The transmitter takes PD1 over, nothing else can be on it
+#define ON_TXD(port, pin) ((port) == PORTD && (pin) == PD1)
+#if UART_TELEMETRY && (ON_TXD(RL_PORT, RL_PIN) || ON_TXD(RH_PORT, RH_PIN) || ON_TXD(SL_PORT, SL_PIN) \
+	|| ON_TXD(SH_PORT, SH_PIN) || ON_TXD(TL_PORT, TL_PIN) || ON_TXD(TH_PORT, TH_PIN))
+	#error UART_TELEMETRY needs TXD (PD1), this board drives a MOSFET with it
+#endif
+
+#define PORT_BIT(port, pin, inverting) (((mcu.reg[port] >> (pin)) & 1) ^ (inverting))
+
+uint8_t board_leg(uint8_t phase)
+{
+	uint8_t h, l;
+	switch (phase) {
+		case PHASE_R:
+			h = PORT_BIT(RH_PORT, RH_PIN, RH_INVERTING);
+			l = PORT_BIT(RL_PORT, RL_PIN, RL_INVERTING);
+			break;
+		case PHASE_S:
+			h = PORT_BIT(SH_PORT, SH_PIN, SH_INVERTING);
+			l = PORT_BIT(SL_PORT, SL_PIN, SL_INVERTING);
+			break;
+		default:
+			h = PORT_BIT(TH_PORT, TH_PIN, TH_INVERTING);
+			l = PORT_BIT(TL_PORT, TL_PIN, TL_INVERTING);
+			break;
+	}
+#if PWM_HARDWARE
+	l &= mcu.oc2;									// OC2 gates all the low drivers
+#endif
+	return h | l<<1;
+}
+
+// Phase connected to ADC channel, -1 if none
+int8_t board_comp_phase(uint8_t channel)
+{
+	if (channel == R_COMP_CHANNEL) return PHASE_R;
+	if (channel == S_COMP_CHANNEL) return PHASE_S;
+	if (channel == T_COMP_CHANNEL) return PHASE_T;
+	return -1;
+}
+
+// Analog inputs: the motor, and the current sense and battery voltage if the board has them
+double board_analog(uint8_t channel)
+{
+	#if CURRENT_CHANNEL >= 0
+	if (channel == CURRENT_CHANNEL) {
+		double v = motor_ground_current() * CURRENT_SENSE_GAIN / 1000;
+		return v > 0? v : 0;
+	}
+	#endif
+	#if VOLTAGE_CHANNEL >= 0
+	if (channel == VOLTAGE_CHANNEL) return motor_supply() * VOLTAGE_SENSE_GAIN / 1000;
+	#endif
+	return motor_analog(channel);
+}
+
+// RC PWM pulse length for throttle 0..1, using the default calibration
+double board_rc_pulse_us(double throttle)
+{
+	return RC_PWM_LOW + throttle * (RC_PWM_HIGH - RC_PWM_LOW);
+}
+
+// DShot throttle value for throttle 0..1, 0 is stop
+uint16_t board_dshot_value(double throttle)
+{
+	if (throttle <= 0) return 0;
+	#if INPUT_SIGNAL_TYPE == 3
+		return DSHOT_THROTTLE_MIN + (uint16_t)(throttle * DSHOT_RANGE + 0.5);
+	#else
+		return 0;
+	#endif
+}
+
+// I2C write setting throttle 0..1, returns its length
+uint8_t board_i2c_throttle(double throttle, uint8_t* buf)
+{
+	#if INPUT_SIGNAL_TYPE == 2
+		uint16_t value = (uint16_t)(throttle * I2C_RANGE + 0.5);
+		#if I2C_PROTOCOL == 2
+			buf[0] = value >> 3;
+			buf[1] = value & 7;
+			return 2;
+		#else
+			buf[0] = value;
+			return 1;
+		#endif
+	#else
+		return 0;
+	#endif
+}
+
+// Drive the input signal pin (INT0/INT1 on port D for RC PWM, ICP1 for DShot), the edge came at cycle
+void board_rc_signal(uint8_t level, uint64_t cycle)
+{
+	#if INPUT_SIGNAL_TYPE == 1
+		#if RC_PWM_CHANNEL == 0
+			mcu_set_pin_at(2, 2, level, cycle);
+		#else
+			mcu_set_pin_at(2, 3, level, cycle);
+		#endif
+	#elif INPUT_SIGNAL_TYPE == 3
+		mcu_set_pin_at(0, 0, level, cycle);
+	#endif
+}
+
+// Level the firmware drives onto the signal wire, -1 while it's an input
+int8_t board_signal_out()
+{
+	if (!PORT_BIT(DDRB, PB0, 0)) return -1;
+	return PORT_BIT(PORTB, PB0, 0);
+}
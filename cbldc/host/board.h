@@ -0,0 +1,40 @@
+/*
+ * board.h
+ *
+ * Host build: the power stage and comparator wiring of the selected board, as seen by the
+ * simulated world. Pin assignments come from the same board header the firmware uses.
+ */
+
+
+#ifndef BOARD_H_
+#define BOARD_H_
+
+#include <stdint.h>
+
+#define PHASE_R 0
+#define PHASE_S 1
+#define PHASE_T 2
+
+// Bridge leg states
+#define LEG_FLOAT 0
+#define LEG_HIGH 1
+#define LEG_LOW 2
+#define LEG_SHORT 3				// Both FETs on, shoot-through!
+
+extern const uint32_t board_f_cpu;
+extern const uint8_t board_signal_type;		// INPUT_SIGNAL_TYPE
+extern const uint16_t board_dshot_rate;		// [kbit/s]
+extern const uint8_t board_dshot_telemetry;	// The line is inverted and the ESC answers every frame
+extern const uint8_t board_i2c_address;
+extern const uint8_t board_uart_telemetry;
+
+uint8_t board_leg(uint8_t phase);
+int8_t board_comp_phase(uint8_t channel);
+double board_analog(uint8_t channel);
+double board_rc_pulse_us(double throttle);
+uint16_t board_dshot_value(double throttle);
+uint8_t board_i2c_throttle(double throttle, uint8_t* buf);
+void board_rc_signal(uint8_t level, uint64_t cycle);
+int8_t board_signal_out(void);
+
+#endif /* BOARD_H_ */
@@ -0,0 +1,136 @@
+/*
+ * comparator_isr.h
+ *
+ * Host build: C port of ANA_COMP_INT from comparator.s. Keep the two in sync.
+ */
+
+
+#ifndef COMPARATOR_ISR_H_
+#define COMPARATOR_ISR_H_
+
+#if ZC_EVENT_RING
+
+ISR(ANA_COMP_vect)
+{
+	uint16_t t;
+	uint8_t rising = BIS(ACSR, ACIS0) != 0;
+	if (rising) {
+		
+		// aco_rising
+		if (BIC(ACSR, ACO)) return;
+		t = ZC_INPUT_CAPTURE? ICR1 : TCNT1;
+		mcu_burn(1);
+		if (BIC(ACSR, ACO)) return;
+		mcu_burn(4);
+		if (BIC(ACSR, ACO)) {
+			// aco_noise
+			mcu_burn(6);
+			return;
+		}
+		mcu_burn(4);
+	}
+	else {
+		
+		// aco_falling
+		if (BIS(ACSR, ACO)) return;
+		t = ZC_INPUT_CAPTURE? ICR1 : TCNT1;
+		mcu_burn(1);
+		if (BIS(ACSR, ACO)) return;
+		mcu_burn(4);
+		if (BIS(ACSR, ACO)) {
+			mcu_burn(6);
+			return;
+		}
+		mcu_burn(2);
+	}
+	
+	// aco_event
+	uint8_t head = _aco_head;
+	_aco_ring[head & (ACO_RING - 1)].time = t;
+	_aco_ring[head & (ACO_RING - 1)].type = rising << ACO_EV_RISING
+		| (flag_is_set(flagsB, AWAIT_PRE_ZC)? 1 << ACO_EV_PRE_ZC : 0)
+		| (flag_is_set(flagsA, PWM_STATE)? 1 << ACO_EV_PWM : 0);
+	_aco_head = head + 1;
+	mcu_burn(31);
+	
+	// The opposite edge next
+	clear_flag(flagsB, AWAIT_PRE_ZC);
+	if (rising) CBI(ACSR, ACIS0);
+	else SBI(ACSR, ACIS0);
+	mcu_burn(5);
+	#if ZC_INPUT_CAPTURE
+	if (BIS(ACSR, ACIS0)) SBI(TCCR1B, ICES1);
+	else CBI(TCCR1B, ICES1);
+	mcu_burn(1);
+	#endif
+}
+
+#else
+
+ISR(ANA_COMP_vect)
+{
+	uint16_t t;
+	if (BIS(ACSR, ACIS0)) {
+		
+		// aco_rising
+		if (BIC(ACSR, ACO)) return;
+		t = ZC_INPUT_CAPTURE? ICR1 : TCNT1;
+		mcu_burn(1);
+		if (BIC(ACSR, ACO)) return;
+		_aco_zc_time = t;
+		mcu_burn(4);
+		if (BIC(ACSR, ACO)) return;
+		mcu_burn(1);
+		if (flag_is_set(flagsB, AWAIT_PRE_ZC)) {
+			// aco_got_lh_pre_zc
+			clear_flag(flagsB, AWAIT_PRE_ZC);
+			CBI(ACSR, ACIS0);
+			mcu_burn(2);
+			#if ZC_PRE_ZC_TIME
+			_aco_pre_time = t;
+			mcu_burn(4);
+			#endif
+			#if ZC_INPUT_CAPTURE
+			CBI(TCCR1B, ICES1);
+			mcu_burn(2);
+			#endif
+			return;
+		}
+	}
+	else {
+		
+		// aco_falling
+		if (BIS(ACSR, ACO)) return;
+		t = ZC_INPUT_CAPTURE? ICR1 : TCNT1;
+		mcu_burn(1);
+		if (BIS(ACSR, ACO)) return;
+		_aco_zc_time = t;
+		mcu_burn(4);
+		if (BIS(ACSR, ACO)) return;
+		mcu_burn(1);
+		if (flag_is_set(flagsB, AWAIT_PRE_ZC)) {
+			// aco_got_hl_pre_zc
+			clear_flag(flagsB, AWAIT_PRE_ZC);
+			SBI(ACSR, ACIS0);
+			mcu_burn(2);
+			#if ZC_PRE_ZC_TIME
+			_aco_pre_time = t;
+			mcu_burn(4);
+			#endif
+			#if ZC_INPUT_CAPTURE
+			SBI(TCCR1B, ICES1);
+			mcu_burn(2);
+			#endif
+			return;
+		}
+	}
+	
+	// aco_got_zc
+	mcu_burn(2);
+	CBI(ACSR, ACIE);
+	mcu_burn(1);
+}
+
+#endif
+
+#endif /* COMPARATOR_ISR_H_ */
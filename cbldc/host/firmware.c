@@ -0,0 +1,104 @@
+/*
+ * firmware.c
+ *
+ * Host build: the whole firmware as one translation unit, the same way cbldc.c is built for
+ * the AVR, plus C ports of the asm ISRs and of speed.s.
+ */
+
+#define main cbldc_main
+#include "../cbldc.c"
+#undef main
+
+#include "pwm_isr.h"
+#include "comparator_isr.h"
+#include "signal_isr.h"
+#if SPEED_RECIPROCAL
+#include "speed_rcp.h"
+#endif
+#include "firmware.h"
+
+int8_t firmware_pwm_phase(void)
+{
+	if (BIS(flagsA, PWM_R)) return 0;
+	if (BIS(flagsA, PWM_S)) return 1;
+	if (BIS(flagsA, PWM_T)) return 2;
+	return -1;
+}
+
+uint16_t firmware_pwm_duty(void)
+{
+	return _pwm_val;
+}
+
+uint16_t firmware_pwm_top(void)
+{
+	return _pwm_top;
+}
+
+uint8_t firmware_motor_status(void)
+{
+	return motor_status;
+}
+
+uint8_t firmware_battery_cells(void)
+{
+#if BATTERY_SENSE
+	return battery_cells;
+#else
+	return 0;
+#endif
+}
+
+static config firmware_config;
+
+void firmware_config_begin(void)
+{
+	firmware_config = cfg;
+}
+
+static void firmware_config_flag(uint8_t bit, long value)
+{
+	if (value) SBI(firmware_config.flags, bit);
+	else CBI(firmware_config.flags, bit);
+}
+
+uint8_t firmware_config_set(const char* key, long value)
+{
+	if (!strcmp(key, "pwm_freq")) firmware_config.pwm_freq = value;
+	else if (!strcmp(key, "timing")) firmware_config.timing_delay = (30 - value) * 128 / 30;	// As program_menu()
+	else if (!strcmp(key, "governor")) firmware_config_flag(CFG_GOVERNOR, value);
+	else if (!strcmp(key, "gov_max_rps")) firmware_config.gov_max_rps = value;
+	else if (!strcmp(key, "synchro")) firmware_config_flag(CFG_SYNCHRO_PWM, value);
+	else if (!strcmp(key, "brake")) firmware_config_flag(CFG_BRAKE, value);
+	else return 1;
+	return 0;
+}
+
+uint8_t firmware_config_request(void)
+{
+	return config_request(&firmware_config);
+}
+
+uint8_t firmware_config_pending(void)
+{
+	return _cfg_new_pending;
+}
+
+uint8_t firmware_zc_detected(void)
+{
+	// The ISR, or run() with ZC_EVENT_RING, disables the comparator interrupt at the ZC.
+	// ACSR straight from the registers, an ACSR access would take simulated time.
+	static uint8_t armed;
+	uint8_t acie = mcu.reg[0x08] & (1 << ACIE);
+	uint8_t zc = armed && !acie && !flag_is_set(flagsB, AWAIT_PRE_ZC);
+	armed = acie;
+#if ZC_PWM_SAMPLING
+	// The PWM interrupt found it: ZC_SAMPLING cleared with a new sample time
+	static uint8_t sampling;
+	static uint16_t sample_time;
+	if (_zc_sampling && sampling && !flag_is_set(flagsB, ZC_SAMPLING) && sample_time != _zc_sample_time) zc = 1;
+	sampling = _zc_sampling && flag_is_set(flagsB, ZC_SAMPLING);
+	sample_time = _zc_sample_time;
+#endif
+	return zc;
+}
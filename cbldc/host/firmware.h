@@ -0,0 +1,41 @@
+/*
+ * firmware.h
+ *
+ * Host build: entry point and a few read-only views into the firmware, for the harness.
+ */
+
+
+#ifndef FIRMWARE_H_
+#define FIRMWARE_H_
+
+#include <stdint.h>
+
+int cbldc_main(void);
+
+// Phase doing the PWM on its low FET, -1 if none selected yet
+int8_t firmware_pwm_phase(void);
+
+// Current PWM duty and top, in CPU cycles
+uint16_t firmware_pwm_duty(void);
+uint16_t firmware_pwm_top(void);
+
+// The ZC the run loop is waiting for has been detected since the last call
+uint8_t firmware_zc_detected(void);
+
+// motor_status, MOTOR_* in globals.h
+uint8_t firmware_motor_status(void);
+
+// Cells counted at power-up, 0 without VOLTAGE_CHANNEL
+uint8_t firmware_battery_cells(void);
+
+// Settings changed while running, the way a test stand would: firmware_config_begin() takes the
+// config in use, firmware_config_set() changes one setting of it (pwm_freq, timing in degrees,
+// governor, gov_max_rps, synchro, brake, 1 if the key is unknown) and firmware_config_request()
+// hands it over to config_request(), 1 if refused. firmware_config_pending() is 1 until the
+// firmware has applied it.
+void firmware_config_begin(void);
+uint8_t firmware_config_set(const char* key, long value);
+uint8_t firmware_config_request(void);
+uint8_t firmware_config_pending(void);
+
+#endif /* FIRMWARE_H_ */
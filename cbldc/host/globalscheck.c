@@ -0,0 +1,174 @@
+/*
+ * globalscheck.c
+ *
+ * Host build: calculate_globals() and governor_init() of the firmware against the floats they
+ * were written in, bit for bit.
+ *
+ * The reference is the old float code with AVR semantics: double is float there, so every
+ * constant and every step is a float here too. All results are compared for every PWM frequency
+ * config_evaluate() accepts and every RC range (rcp_high - rcp_low) of which the STP constant fits
+ * 8 bits, the governor at the default gov_max_rps. The governor is then checked on its own for
+ * every gov_max_rps, on a spread of PWM ranges. Combinations of which the floats overflow the
+ * integers they go to are left out, the old code had no defined result for them.
+ *
+ * All of it takes half an hour, -s checks every STEPth RC range only, for a quick run.
+ *
+ * usage: globalscheck [-s STEP]
+ */
+
+#define main cbldc_main
+#include "../cbldc.c"
+#undef main
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FREQ_MIN 1000							// config_evaluate()
+#define FREQ_MAX 32000
+#define PWM_RANGE_STEP 61						// Of the governor check on its own
+
+typedef struct {
+	uint16_t pwm_range, pwm_start_min, pwm_start_max;
+	uint8_t stp_mul, stp_frac, sttl_mul, sttl_frac, load_frac;
+	uint16_t gov_min_setpoint, gov_throttle_speed;
+	uint32_t gov_s2p_const;
+} results;
+
+// calculate_globals() in floats, 0 if out of range
+static uint8_t reference_globals(uint16_t freq, uint16_t range, results* r)
+{
+#if PWM_HARDWARE
+	float pwm_period = PWM_HW_PERIOD;
+	(void)freq;
+#else
+	float pwm_period = (float)F_CPU / (float)freq;
+#endif
+	if (pwm_period / (float)range >= 256) return 0;
+	r->stp_mul = pwm_period / (float)range;
+	uint16_t tmp = pwm_period * 256.0f / (float)range;
+	tmp -= r->stp_mul<<8;
+	r->stp_frac = tmp;
+	r->sttl_mul = (60.0f*THROT_PER_KRPM/100000.0f) * pwm_period;
+	tmp = (60.0f*THROT_PER_KRPM/100000.0f*256.0f) * pwm_period;
+	tmp -= r->sttl_mul<<8;
+	r->sttl_frac = tmp;
+	r->pwm_start_min = pwm_period * (0.01f*START_MIN_POWER);
+	r->pwm_start_max = pwm_period * (0.01f*START_MAX_POWER);
+	r->pwm_range = mul_16_8_sum_frac8(range, r->stp_mul, r->stp_frac);
+	r->load_frac = r->pwm_range > 256? 65536.0f / (float)r->pwm_range : 255;
+	return 1;
+}
+
+// governor_init() in floats, 0 if out of range
+static uint8_t reference_governor(uint16_t pwm_range, uint16_t range, uint16_t gov_max_rps, results* r)
+{
+	float tmp = (float)pwm_range / (float)gov_max_rps;
+	if (tmp * (float)RPM_TO_RPS(GOV_MIN_SPEED) >= 65536.0f || tmp * (float)0x01000000 >= 4294967296.0f) return 0;
+	r->gov_min_setpoint = tmp * (float)RPM_TO_RPS(GOV_MIN_SPEED);
+	r->gov_s2p_const = tmp * (float)0x01000000;
+	r->gov_throttle_speed = range * (0.01f*GOV_THROTTLE_SPEED / GOV_SAMPLING_FREQ);
+	return 1;
+}
+
+static void firmware_globals(uint16_t freq, uint16_t range, results* r)
+{
+	cfg.pwm_freq = freq;
+	cfg.rcp_low = 0;
+	cfg.rcp_high = range;
+	calculate_globals();
+	r->stp_mul = stp_mul;
+	r->stp_frac = stp_frac;
+	r->sttl_mul = sttl_mul;
+	r->sttl_frac = sttl_frac;
+	r->pwm_start_min = pwm_start_min;
+	r->pwm_start_max = pwm_start_max;
+	r->pwm_range = pwm_range;
+	r->load_frac = load_frac;
+}
+
+static void firmware_governor(uint16_t gov_max_rps, results* r)
+{
+	cfg.gov_max_rps = gov_max_rps;
+	governor_init();
+	r->gov_min_setpoint = gov_min_setpoint;
+	r->gov_s2p_const = gov_s2p_const;
+	r->gov_throttle_speed = gov_throttle_speed;
+}
+
+static uint8_t compare(const char* what, uint16_t freq, uint16_t range, uint16_t gov_max_rps, const results* f, const results* r)
+{
+	static unsigned long failures;
+	if (!memcmp(f, r, sizeof(results))) return 0;
+	if (failures++ < 10) {
+		printf("%s differs at pwm_freq %u, range %u, pwm_range %u, gov_max_rps %u:\n", what, freq, range, r->pwm_range, gov_max_rps);
+		printf("  float   stp %u+%u/256 sttl %u+%u/256 start %u..%u pwm_range %u load %u gov %u %lu %u\n",
+			r->stp_mul, r->stp_frac, r->sttl_mul, r->sttl_frac, r->pwm_start_min, r->pwm_start_max,
+			r->pwm_range, r->load_frac, r->gov_min_setpoint, (unsigned long)r->gov_s2p_const, r->gov_throttle_speed);
+		printf("  integer stp %u+%u/256 sttl %u+%u/256 start %u..%u pwm_range %u load %u gov %u %lu %u\n",
+			f->stp_mul, f->stp_frac, f->sttl_mul, f->sttl_frac, f->pwm_start_min, f->pwm_start_max,
+			f->pwm_range, f->load_frac, f->gov_min_setpoint, (unsigned long)f->gov_s2p_const, f->gov_throttle_speed);
+	}
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	uint16_t gov_max_rps = _cfg_default.gov_max_rps;
+	unsigned long checked = 0, skipped = 0, failed = 0;
+	uint32_t freq, range, pr, step = 1;
+
+	if (argc == 3 && !strcmp(argv[1], "-s") && atoi(argv[2]) > 0) step = atoi(argv[2]);
+	else if (argc != 1) {
+		fprintf(stderr, "usage: %s [-s STEP]\n", argv[0]);
+		return 2;
+	}
+
+	cfg = _cfg_default;
+	cfg.flags |= 1<<CFG_GOVERNOR;
+
+	// Every PWM frequency and RC range, once with PWM_HARDWARE and with no calibration
+#if PWM_HARDWARE
+	for (freq = FREQ_MIN; freq <= FREQ_MIN; freq++) {
+#else
+	for (freq = FREQ_MIN; freq <= FREQ_MAX; freq++) {
+#endif
+#if INPUT_SIGNAL_TYPE == 3
+		for (range = DSHOT_RANGE; range <= DSHOT_RANGE; range++) {
+#elif INPUT_SIGNAL_TYPE == 2
+		for (range = I2C_RANGE; range <= I2C_RANGE; range++) {
+#else
+		for (range = 1; range <= 0xFFFF; range += step) {
+#endif
+			results f, r;
+			if (!reference_globals(freq, range, &r) || !reference_governor(r.pwm_range, range, gov_max_rps, &r)) {
+				skipped++;
+				continue;
+			}
+			memset(&f, 0, sizeof(f));
+			firmware_globals(freq, range, &f);
+			firmware_governor(gov_max_rps, &f);
+			failed += compare("calculate_globals()", freq, range, gov_max_rps, &f, &r);
+			checked++;
+		}
+	}
+	printf("calculate_globals(): %lu combinations checked, %lu out of range, %lu differ\n", checked, skipped, failed);
+
+	// The governor alone, every gov_max_rps, the RC range stays that of the last PWM range
+	unsigned long gov_checked = 0, gov_failed = 0;
+	for (pr = 1; pr <= 0xFFFF; pr += PWM_RANGE_STEP) {
+		uint32_t g;
+		for (g = 1; g <= 0xFFFF; g++) {
+			results f, r;
+			memset(&r, 0, sizeof(r));
+			if (!reference_governor(pr, signal_range, g, &r)) continue;
+			memset(&f, 0, sizeof(f));
+			pwm_range = pr;
+			firmware_governor(g, &f);
+			r.pwm_range = f.pwm_range = pr;
+			gov_failed += compare("governor_init()", cfg.pwm_freq, signal_range, g, &f, &r);
+			gov_checked++;
+		}
+	}
+	printf("governor_init(): %lu combinations checked, %lu differ\n", gov_checked, gov_failed);
+	return failed || gov_failed;
+}
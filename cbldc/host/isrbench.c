@@ -0,0 +1,529 @@
+/*
+ * isrbench.c
+ *
+ * Host build: cycle counts of the asm interrupt routines, per execution path.
+ *
+ * The preprocessed pwm.s, comparator.s and signal.s are run in the avrasm interpreter from
+ * a set of register states covering every path: normal, blinking and synchronous PWM states
+ * for each phase, with and without a missed compare, the comparator edges and the RC PWM,
+ * DShot or TWI events. Cycles are counted from the first instruction of the ISR to its reti,
+ * inclusive. The interrupt response and the vector table rjmp add ISR_ENTRY_CYCLES on top.
+ *
+ * usage: isrbench [-b budget] [-u] [-e pwm.h] file.i...
+ *   -b budget   fail if any path's worst case exceeds the budget file
+ *   -u          write the measured worst cases to the budget file instead
+ *   -e pwm.h    fail if _PWM_INT_EXEC_TIME there is lower than measured
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "avrasm.h"
+
+// Register names, flag bits and board settings as the asm sees them
+#define MCU_SFR_ADDRESSES
+#include <avr/io.h>
+#include "../bldc.h"
+#define __ASSEMBLER__
+#include "../globals.h"
+#undef __ASSEMBLER__
+
+#define STR(s) #s
+#define XSTR(s) STR(s)
+#define REG(name) atoi(XSTR(name) + 1)
+
+// Interrupt response (4) and the rjmp in the vector table (2)
+#define ISR_ENTRY_CYCLES 6
+
+#define MAX_PATHS 32
+#define MAX_VARIANTS 256
+
+static const uint8_t phases[3] = {PWM_R, PWM_S, PWM_T};
+static int exec_time = 40;				// _PWM_INT_EXEC_TIME, limits the blinking time
+
+static void set_reg(avrasm_cpu* cpu, int reg, uint8_t value)
+{
+	cpu->r[reg] = value;
+}
+
+static uint8_t* flags_a(avrasm_cpu* cpu)
+{
+	return &cpu->r[REG(flagsA)];
+}
+
+static uint8_t* flags_b(avrasm_cpu* cpu)
+{
+	return &cpu->r[REG(flagsB)];
+}
+
+// *------------------*
+// |      Paths       |
+// *------------------*
+
+static int pwm_ext(avrasm_cpu* cpu, int v)
+{
+	set_reg(cpu, REG(pwm_tcnt2_h), 1);
+	return v < 1;
+}
+
+/* Variants: phase x (long state, short state, short state with the compare missed).
+Returns 0 when out of variants. */
+static int pwm_normal(avrasm_cpu* cpu, int v, uint8_t state, uint8_t synchro)
+{
+	if (v >= 9) return 0;
+	*flags_a(cpu) = 1 << phases[v % 3];
+	if (state) *flags_a(cpu) |= 1 << PWM_STATE;
+	if (synchro) *flags_a(cpu) |= 1 << PWM_SYNCHRO;
+	set_reg(cpu, REG(pwm_tcnt2_h), 0);
+	uint8_t delay = v / 3 == 0? 200 : 40;
+	set_reg(cpu, state? REG(pwm_low_l) : REG(pwm_high_l), delay);
+	set_reg(cpu, state? REG(pwm_low_h) : REG(pwm_high_h), 0);
+	cpu->io[0x23] = 100;										// OCR2
+	cpu->io[0x24] = v / 3 == 2? 150 : 110;						// TCNT2, past OCR2 + delay if missed
+	return 1;
+}
+
+static int pwm_high(avrasm_cpu* cpu, int v) { return pwm_normal(cpu, v, 0, 0); }
+static int pwm_low(avrasm_cpu* cpu, int v) { return pwm_normal(cpu, v, 1, 0); }
+static int pwm_sync_high(avrasm_cpu* cpu, int v) { return pwm_normal(cpu, v, 0, 1); }
+static int pwm_sync_low(avrasm_cpu* cpu, int v) { return pwm_normal(cpu, v, 1, 1); }
+
+#if ZC_PWM_SAMPLING
+/* End of the on-time with the comparator sampled. Variants: the pwm_normal ones x (not there yet,
+PRE-ZC state, ZC state) x ACIS0. */
+static int pwm_low_zc_sample(avrasm_cpu* cpu, int v)
+{
+	if (v >= 9 * 3 * 2) return 0;
+	pwm_normal(cpu, v % 9, 1, 0);
+	uint8_t state = v / 9 % 3;
+	uint8_t acis0 = v / 27;
+	*flags_b(cpu) = 1 << ZC_SAMPLING;
+	if (state < 2) *flags_b(cpu) |= 1 << AWAIT_PRE_ZC;
+	cpu->io[0x08] = 1 << ACIS1 | acis0 << ACIS0;				// ACSR
+	if ((state != 0) == acis0) cpu->io[0x08] |= 1 << ACO;
+	return 1;
+}
+#endif
+
+// Variants: phase x every blink time pwm_set() can choose
+static int pwm_blink(avrasm_cpu* cpu, int v, uint8_t state, uint8_t synchro)
+{
+	int blinks = exec_time - 1;
+	if (v >= 3 * blinks) return 0;
+	*flags_a(cpu) = 1 << phases[v % 3] | 1 << PWM_BLINKING;
+	if (state) *flags_a(cpu) |= 1 << PWM_STATE;
+	if (synchro) *flags_a(cpu) |= 1 << PWM_SYNCHRO;
+	set_reg(cpu, REG(pwm_tcnt2_h), 0);
+	set_reg(cpu, state? REG(pwm_high_l) : REG(pwm_low_l), v / 3);
+	set_reg(cpu, state? REG(pwm_low_l) : REG(pwm_high_l), 200);
+	cpu->io[0x23] = 100;
+	cpu->io[0x24] = 110;
+	*avrasm_ram(cpu, "CONST_3") = 3;
+	return 1;
+}
+
+static int pwm_blink_high(avrasm_cpu* cpu, int v) { return pwm_blink(cpu, v, 0, 0); }
+static int pwm_blink_low(avrasm_cpu* cpu, int v) { return pwm_blink(cpu, v, 1, 0); }
+static int pwm_sync_blink_high(avrasm_cpu* cpu, int v) { return pwm_blink(cpu, v, 0, 1); }
+static int pwm_sync_blink_low(avrasm_cpu* cpu, int v) { return pwm_blink(cpu, v, 1, 1); }
+
+// Comparator: waiting for a rising or falling edge, with or without the PRE-ZC state pending
+static int acomp(avrasm_cpu* cpu, int v, uint8_t rising, uint8_t pre_zc, uint8_t noise)
+{
+	cpu->io[0x08] = 1 << ACIE | 1 << ACIS1;					// ACSR
+	if (rising) cpu->io[0x08] |= 1 << ACIS0;
+	if (rising != noise) cpu->io[0x08] |= 1 << ACO;
+	*flags_b(cpu) = pre_zc? 1 << AWAIT_PRE_ZC : 0;
+	return v < 1;
+}
+
+static int acomp_rising(avrasm_cpu* cpu, int v) { return acomp(cpu, v, 1, 0, 0); }
+static int acomp_rising_pre(avrasm_cpu* cpu, int v) { return acomp(cpu, v, 1, 1, 0); }
+static int acomp_rising_noise(avrasm_cpu* cpu, int v) { return acomp(cpu, v, 1, 0, 1); }
+static int acomp_falling(avrasm_cpu* cpu, int v) { return acomp(cpu, v, 0, 0, 0); }
+static int acomp_falling_pre(avrasm_cpu* cpu, int v) { return acomp(cpu, v, 0, 1, 0); }
+static int acomp_falling_noise(avrasm_cpu* cpu, int v) { return acomp(cpu, v, 0, 0, 1); }
+
+#if INPUT_SIGNAL_TYPE == 1
+	#if RC_PWM_CHANNEL == 0
+		#define RCP_VECT INT0_vect
+		#define RCP_PIN PD2
+	#else
+		#define RCP_VECT INT1_vect
+		#define RCP_PIN PD3
+	#endif
+
+static int rcp_edge(avrasm_cpu* cpu, int v, uint8_t rising)
+{
+	cpu->io[0x10] = rising? 1 << RCP_PIN : 0;					// PIND
+	cpu->io[0x32] = 0xA5;										// TCNT0
+	cpu->io[0x2C] = 0x34;										// TCNT1
+	cpu->io[0x2D] = 0x12;
+	return v < 1;
+}
+
+static int rcp_rising(avrasm_cpu* cpu, int v) { return rcp_edge(cpu, v, 1); }
+static int rcp_falling(avrasm_cpu* cpu, int v) { return rcp_edge(cpu, v, 0); }
+#endif
+
+#if INPUT_SIGNAL_TYPE == 2
+// TWSR status, i2c_idx bytes of the write received so far
+static void twi(avrasm_cpu* cpu, uint8_t status, uint8_t idx)
+{
+	cpu->io[0x01] = status | (1<<TWPS1) | (1<<TWPS0);			// TWSR, the prescaler bits masked out
+	cpu->io[0x03] = 0x5A;										// TWDR
+	avrasm_ram(cpu, "i2c_idx")[0] = idx;
+}
+
+// Variants: first byte, second byte, extra byte dropped
+static int twi_rx(avrasm_cpu* cpu, int v)
+{
+	twi(cpu, 0x80, v);
+	return v < 3;
+}
+
+static int twi_tx(avrasm_cpu* cpu, int v)
+{
+	twi(cpu, 0xB8, 0);
+	return v < 1;
+}
+
+static int twi_sla_w(avrasm_cpu* cpu, int v)
+{
+	twi(cpu, 0x60, 0);
+	return v < 1;
+}
+
+static int twi_sla_r(avrasm_cpu* cpu, int v)
+{
+	twi(cpu, 0xA8, 0);
+	return v < 1;
+}
+
+// Variants: end of a write, stop without data
+static int twi_stop(avrasm_cpu* cpu, int v)
+{
+	twi(cpu, 0xA0, v? 0 : 2);
+	return v < 2;
+}
+
+// Variants: last byte sent, data NACKed
+static int twi_other(avrasm_cpu* cpu, int v)
+{
+	twi(cpu, v? 0x88 : 0xC0, 0);
+	return v < 2;
+}
+
+static int twi_bus_error(avrasm_cpu* cpu, int v)
+{
+	twi(cpu, 0x00, 0);
+	return v < 1;
+}
+#endif
+
+#if INPUT_SIGNAL_TYPE == 3
+	#define DSHOT_INT TIMER1_CAPT_vect
+	#define DSHOT_P PB0
+	
+	// PINB during a pulse and after it, inverted for telemetry
+	#if DSHOT_TELEMETRY
+		#define DSHOT_PULSE 0
+		#define DSHOT_IDLE_LEVEL (1 << DSHOT_P)
+	#else
+		#define DSHOT_PULSE (1 << DSHOT_P)
+		#define DSHOT_IDLE_LEVEL 0
+	#endif
+
+// Edge captured gap ticks after the previous one, dshot_data holds the bits so far
+static void dshot_edge(avrasm_cpu* cpu, uint8_t frame, uint16_t gap, uint16_t data)
+{
+	uint16_t icr = 0x1234;
+	uint8_t* last = avrasm_ram(cpu, "dshot_last");
+	uint8_t* d = avrasm_ram(cpu, "dshot_data");
+	if (frame) *flags_a(cpu) |= 1 << DSHOT_FRAME;
+	cpu->io[0x16] = DSHOT_PULSE;								// PINB, pulse still on
+	cpu->io[0x26] = icr & 0xFF;									// ICR1
+	cpu->io[0x27] = icr >> 8;
+	last[0] = (icr - gap) & 0xFF;
+	last[1] = (icr - gap) >> 8;
+	d[0] = data & 0xFF;
+	d[1] = data >> 8;
+}
+
+static int dshot_rising(avrasm_cpu* cpu, int v)
+{
+	dshot_edge(cpu, 0, 1000, 0);
+	return v < 1;
+}
+
+// The falling edge of bit 0 came before the capture was switched to it
+static int dshot_rising_missed(avrasm_cpu* cpu, int v)
+{
+	dshot_edge(cpu, 0, 1000, 0);
+	cpu->io[0x16] = DSHOT_IDLE_LEVEL;
+	cpu->io[0x2C] = 0x35;										// TCNT1, 1 tick after ICR1
+	return v < 1;
+}
+
+// Variants: too late to tell bit 0, in the middle of a frame
+
+static int dshot_rising_bad(avrasm_cpu* cpu, int v)
+{
+	dshot_edge(cpu, 0, v? 1 : 1000, 0);
+	if (!v) cpu->io[0x16] = DSHOT_IDLE_LEVEL;
+	return v < 2;
+}
+
+// Variants: the previous bit was 1 or 0
+static int dshot_falling(avrasm_cpu* cpu, int v)
+{
+	dshot_edge(cpu, 1, 1, v? 0x0003 : 0x0002);
+	return v < 2;
+}
+
+static int dshot_falling_done(avrasm_cpu* cpu, int v)
+{
+	dshot_edge(cpu, 1, 1, v? 0x8001 : 0x8000);
+	return v < 2;
+}
+
+static int dshot_falling_lost(avrasm_cpu* cpu, int v)
+{
+	dshot_edge(cpu, 1, 0xFF, 0x0003);
+	return v < 1;
+}
+#endif
+
+typedef struct {
+	const char* name;
+	const char* label;
+	int (*setup)(avrasm_cpu* cpu, int variant);
+	uint8_t pwm;							// A non-blinking PWM state, sets _PWM_INT_EXEC_TIME
+} path;
+
+static const path paths[] = {
+	{"pwm.extended", XSTR(TIMER2_OC_INT), pwm_ext, 0},
+	{"pwm.high", XSTR(TIMER2_OC_INT), pwm_high, 1},
+	{"pwm.low", XSTR(TIMER2_OC_INT), pwm_low, 1},
+	{"pwm.sync.high", XSTR(TIMER2_OC_INT), pwm_sync_high, 1},
+	{"pwm.sync.low", XSTR(TIMER2_OC_INT), pwm_sync_low, 1},
+#if ZC_PWM_SAMPLING
+	{"pwm.low.zc_sample", XSTR(TIMER2_OC_INT), pwm_low_zc_sample, 1},
+#endif
+	{"pwm.blink.high", XSTR(TIMER2_OC_INT), pwm_blink_high, 0},
+	{"pwm.blink.low", XSTR(TIMER2_OC_INT), pwm_blink_low, 0},
+	{"pwm.sync.blink.high", XSTR(TIMER2_OC_INT), pwm_sync_blink_high, 0},
+	{"pwm.sync.blink.low", XSTR(TIMER2_OC_INT), pwm_sync_blink_low, 0},
+#if ZC_EVENT_RING
+	{"acomp.ring.rising.zc", XSTR(ANA_COMP_vect), acomp_rising, 0},
+	{"acomp.ring.rising.pre_zc", XSTR(ANA_COMP_vect), acomp_rising_pre, 0},
+	{"acomp.ring.rising.noise", XSTR(ANA_COMP_vect), acomp_rising_noise, 0},
+	{"acomp.ring.falling.zc", XSTR(ANA_COMP_vect), acomp_falling, 0},
+	{"acomp.ring.falling.pre_zc", XSTR(ANA_COMP_vect), acomp_falling_pre, 0},
+	{"acomp.ring.falling.noise", XSTR(ANA_COMP_vect), acomp_falling_noise, 0},
+#else
+	{"acomp.rising.zc", XSTR(ANA_COMP_vect), acomp_rising, 0},
+	{"acomp.rising.pre_zc", XSTR(ANA_COMP_vect), acomp_rising_pre, 0},
+	{"acomp.rising.noise", XSTR(ANA_COMP_vect), acomp_rising_noise, 0},
+	{"acomp.falling.zc", XSTR(ANA_COMP_vect), acomp_falling, 0},
+	{"acomp.falling.pre_zc", XSTR(ANA_COMP_vect), acomp_falling_pre, 0},
+	{"acomp.falling.noise", XSTR(ANA_COMP_vect), acomp_falling_noise, 0},
+#endif
+#if INPUT_SIGNAL_TYPE == 1 && RC_PWM_PROTOCOL == 1			// Servo, Timer1 alone
+	{"rcp.rising", XSTR(RCP_VECT), rcp_rising, 0},
+	{"rcp.falling", XSTR(RCP_VECT), rcp_falling, 0},
+#elif INPUT_SIGNAL_TYPE == 1
+	{"rcp.fast.rising", XSTR(RCP_VECT), rcp_rising, 0},
+	{"rcp.fast.falling", XSTR(RCP_VECT), rcp_falling, 0},
+#endif
+#if INPUT_SIGNAL_TYPE == 2
+	{"twi.rx", XSTR(TWI_vect), twi_rx, 0},
+	{"twi.tx", XSTR(TWI_vect), twi_tx, 0},
+	{"twi.sla_w", XSTR(TWI_vect), twi_sla_w, 0},
+	{"twi.sla_r", XSTR(TWI_vect), twi_sla_r, 0},
+	{"twi.stop", XSTR(TWI_vect), twi_stop, 0},
+	{"twi.other", XSTR(TWI_vect), twi_other, 0},
+	{"twi.bus_error", XSTR(TWI_vect), twi_bus_error, 0},
+#endif
+#if INPUT_SIGNAL_TYPE == 3
+	{"dshot.rising", XSTR(DSHOT_INT), dshot_rising, 0},
+	{"dshot.rising.missed", XSTR(DSHOT_INT), dshot_rising_missed, 0},
+	{"dshot.rising.bad", XSTR(DSHOT_INT), dshot_rising_bad, 0},
+	{"dshot.falling", XSTR(DSHOT_INT), dshot_falling, 0},
+	{"dshot.falling.done", XSTR(DSHOT_INT), dshot_falling_done, 0},
+	{"dshot.falling.lost", XSTR(DSHOT_INT), dshot_falling_lost, 0},
+#endif
+};
+
+#define PATHS (sizeof(paths) / sizeof(paths[0]))
+
+// *------------------*
+// |      Budget      |
+// *------------------*
+
+static long budget_of(const char* file, const char* name)
+{
+	FILE* f = fopen(file, "r");
+	char buf[128];
+	char key[64];
+	long v;
+	if (!f) return -1;
+	while (fgets(buf, sizeof(buf), f)) {
+		if (buf[0] == '#') continue;
+		if (sscanf(buf, "%63s %ld", key, &v) == 2 && !strcmp(key, name)) {
+			fclose(f);
+			return v;
+		}
+	}
+	fclose(f);
+	return -1;
+}
+
+// Value of a "#define name number" line in the file, -1 if there's none
+static int read_define(const char* file, const char* name)
+{
+	FILE* f = fopen(file, "r");
+	char buf[256];
+	char def[64];
+	int v = -1;
+	if (!f) {
+		perror(file);
+		return -1;
+	}
+	while (fgets(buf, sizeof(buf), f)) {
+		if (sscanf(buf, " #define %63s %d", def, &v) == 2 && !strcmp(def, name)) break;
+		v = -1;
+	}
+	fclose(f);
+	return v;
+}
+
+// _PWM_INT_EXEC_TIME as pwm.h puts it together for this configuration
+static int read_exec_time(const char* file)
+{
+	int base = read_define(file, "_PWM_INT_BASE_TIME");
+	int dead_free = read_define(file, "_PWM_DEAD_FREE_CYCLES");
+	int sample = read_define(file, "_PWM_ZC_SAMPLE_TIME");
+	int dead = F_CPU / 1000 * PWM_DEAD_TIME / 1000000;
+	if (base < 0 || dead_free < 0 || sample < 0) return -1;
+	return base + (dead > dead_free? dead - dead_free : 0) + (ZC_PWM_SAMPLING? sample : 0);
+}
+
+static int cmp_long(const void* a, const void* b)
+{
+	long x = *(const long*)a;
+	long y = *(const long*)b;
+	return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv)
+{
+	const char* budget = 0;
+	const char* pwm_h = 0;
+	uint8_t update = 0;
+	int i;
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-b") && i + 1 < argc) budget = argv[++i];
+		else if (!strcmp(argv[i], "-e") && i + 1 < argc) pwm_h = argv[++i];
+		else if (!strcmp(argv[i], "-u")) update = 1;
+		else {
+			fprintf(stderr, "usage: %s [-b budget] [-u] [-e pwm.h] file.i...\n", argv[0]);
+			return 2;
+		}
+	}
+	if (i == argc) {
+		fprintf(stderr, "%s: no asm files\n", argv[0]);
+		return 2;
+	}
+#if ZC_EVENT_RING
+	avrasm_data("_aco_ring", ACO_RING * ACO_EVENT_SIZE);
+#endif
+	for (; i < argc; i++) {
+		if (avrasm_load(argv[i])) return 1;
+	}
+	if (pwm_h) {
+		exec_time = read_exec_time(pwm_h);
+		if (exec_time < 0) {
+			fprintf(stderr, "%s: no _PWM_INT_EXEC_TIME\n", pwm_h);
+			return 1;
+		}
+	}
+
+	FILE* out = 0;
+	char old[4096] = "";					// Budgets of the paths this build doesn't have, kept on update
+	if (update) {
+		FILE* f = fopen(budget, "r");
+		if (f) {
+			old[fread(old, 1, sizeof(old) - 1, f)] = 0;
+			fclose(f);
+		}
+		out = fopen(budget, "w");
+		if (!out) {
+			perror(budget);
+			return 1;
+		}
+		fprintf(out, "# Worst case cycles per ISR path, from the first instruction to reti.\n");
+		fprintf(out, "# Checked by \"make bench\", regenerate with \"make bench-update\".\n");
+	}
+
+	int failed = 0;
+	long pwm_worst = 0;
+	unsigned p;
+	printf("%-26s %8s %6s %6s %6s %7s\n", "path", "variants", "min", "typ", "max", "budget");
+	for (p = 0; p < PATHS; p++) {
+		long cycles[MAX_VARIANTS];
+		int n;
+#if PWM_HARDWARE
+		if (!strcmp(paths[p].label, XSTR(TIMER2_OC_INT))) continue;		// No TIMER2_OC_INT, the PWM is done by Timer2
+#endif
+		for (n = 0; n < MAX_VARIANTS; n++) {
+			avrasm_cpu cpu;
+			memset(&cpu, 0, sizeof(cpu));
+			if (!paths[p].setup(&cpu, n)) break;
+			cycles[n] = avrasm_run(&cpu, paths[p].label);
+			if (cycles[n] < 0) return 1;
+		}
+		qsort(cycles, n, sizeof(cycles[0]), cmp_long);
+		long worst = cycles[n - 1];
+		if (paths[p].pwm && worst > pwm_worst) pwm_worst = worst;
+
+		long limit = budget && !update? budget_of(budget, paths[p].name) : -1;
+		printf("%-26s %8d %6ld %6ld %6ld", paths[p].name, n, cycles[0], cycles[n / 2], worst);
+		if (limit >= 0) printf(" %7ld%s", limit, worst > limit? "  REGRESSION" : "");
+		else if (budget && !update) printf(" %7s  MISSING", "-");
+		printf("\n");
+		if (budget && !update && (limit < 0 || worst > limit)) failed = 1;
+		if (out) fprintf(out, "%s %ld\n", paths[p].name, worst);
+	}
+	if (out) {
+		char* line;
+		for (line = strtok(old, "\n"); line; line = strtok(0, "\n")) {
+			char key[64];
+			if (line[0] == '#' || sscanf(line, "%63s", key) != 1) continue;
+			for (p = 0; p < PATHS && strcmp(paths[p].name, key); p++);
+#if PWM_HARDWARE
+			if (p < PATHS && !strcmp(paths[p].label, XSTR(TIMER2_OC_INT))) p = PATHS;
+#endif
+			if (p == PATHS) fprintf(out, "%s\n", line);
+		}
+		fclose(out);
+	}
+
+	long measured = pwm_worst + ISR_ENTRY_CYCLES;
+	printf("\nISR entry (response + vector rjmp): %d cycles, not included above\n", ISR_ENTRY_CYCLES);
+#if PWM_HARDWARE
+	pwm_h = 0;
+	printf("_PWM_INT_EXEC_TIME: not used with PWM_HARDWARE");
+#else
+	printf("_PWM_INT_EXEC_TIME: %ld cycles measured", measured);
+#endif
+	if (pwm_h) {
+		printf(", %d in %s", exec_time, pwm_h);
+		if (exec_time < measured) {
+			printf("  TOO LOW");
+			failed = 1;
+		}
+	}
+	printf("\n");
+	return failed;
+}
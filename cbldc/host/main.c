@@ -0,0 +1,757 @@
+/*
+ * main.c
+ *
+ * Host build harness. Boots the firmware on the simulated ATmega8 driving a simulated motor,
+ * feeds it an RC PWM, DShot or I2C throttle profile, and checks every commutation and zero-cross
+ * detection against the true rotor position. Over I2C the motor state is read back as well.
+ *
+ * usage: cbldc_host [options]
+ *   -t seconds      simulated time (default 8)
+ *   -a seconds      arm time, throttle stays at zero until then (default 5, boot takes ~3.5)
+ *   -p profile      throttle 0..1, either constant "0.3" or steps "0:0.2,1.5:1,3:0.2"
+ *                   as seconds after arming : throttle
+ *   -r erpm         hold the motor at constant speed instead of simulating the mechanics
+ *   -f hz           RC frame rate (default 50, 1000 for DShot, 2000 for OneShot and Multishot,
+ *                   500 for I2C)
+ *   -s protocol     RC pulses: servo (default), oneshot125, oneshot42 or multishot
+ *   -m key=val,...  motor parameters: r, l, kv, poles, j, friction, drag, vbus, vdiode, rbat
+ *   -c t:key=val,...  settings changed without a reboot at t seconds after arming, applied by
+ *                   the firmware once the motor stops: pwm_freq, timing (degrees), governor,
+ *                   gov_max_rps, synchro, brake. Given again for more changes.
+ *
+ * Exit status is 0 if the firmware ran all the time, started the motor when asked to,
+ * never lost sync, answered every I2C transfer and took every -c change, 1 otherwise. The last line of the report
+ * is meant for scripts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include "mcu.h"
+#include "board.h"
+#include "motor.h"
+#include "firmware.h"
+
+#define DEG(rad) ((rad) * 180 / M_PI)
+
+#define PROFILE_MAX 32
+#define CONFIG_MAX 16					// -c changes
+#define CONFIG_KEYS 6					// Settings in one
+
+// Consecutive bad commutations after which the firmware is considered out of run()
+#define SYNC_LOST_COMS 6
+
+// motor_status in globals.h
+#define FW_MOTOR_STARTING 1
+#define FW_MOTOR_RUNNING 2
+
+static struct {
+	double time;
+	double arm_time;
+	double hold_erpm;
+	double rc_hz;
+	uint8_t rc_protocol;			// Index in rc_protocols
+	uint8_t steps;
+	double step_time[PROFILE_MAX];
+	double step_throttle[PROFILE_MAX];
+} opt = {8, 5, 0, 0, 0, 1, {0}, {0.3}};
+
+// *------------------*
+// | Settings changes |
+// *------------------*
+
+static struct {
+	double time;
+	uint8_t keys;
+	char* key[CONFIG_KEYS];
+	long value[CONFIG_KEYS];
+} configs[CONFIG_MAX];
+
+static uint8_t config_count;
+static uint8_t config_next;
+static uint8_t config_refused;
+
+// Hands the changes due to the firmware, it applies them at its next stop
+static void config_step()
+{
+	while (config_next < config_count && mcu_time() - opt.arm_time >= configs[config_next].time) {
+		uint8_t k;
+		firmware_config_begin();
+		for (k = 0; k < configs[config_next].keys; k++) {
+			firmware_config_set(configs[config_next].key[k], configs[config_next].value[k]);
+		}
+		config_refused += firmware_config_request();
+		config_next++;
+	}
+}
+
+static double throttle_at(double t)
+{
+	double throttle = 0;
+	uint8_t i;
+	if (t < opt.arm_time) return 0;
+	for (i = 0; i < opt.steps; i++) {
+		if (t - opt.arm_time >= opt.step_time[i]) throttle = opt.step_throttle[i];
+	}
+	return throttle;
+}
+
+// *------------------*
+// |   RC PWM input   |
+// *------------------*
+
+// Pulse length [us] from the servo one
+static const struct {
+	const char* name;
+	double scale;
+	double offset;
+} rc_protocols[] = {
+	{"servo", 1, 0},
+	{"oneshot125", 1.0 / 8, 0},
+	{"oneshot42", 1.0 / 24, 0},
+	{"multishot", 1.0 / 50, 5 - 1000.0 / 50},
+};
+
+static uint64_t rc_frame;
+static uint64_t rc_next_edge;
+static uint8_t rc_level;
+
+// DShot frame being sent: 16 bits MSB first, each bit high for 3/8 (0) or 3/4 (1) of the period.
+// With telemetry the levels and the CRC are inverted.
+static uint16_t dshot_frame;
+static uint8_t dshot_bit;
+static uint64_t dshot_frames;
+
+static uint16_t dshot_make_frame(uint16_t value)
+{
+	uint16_t v = value << 1;		// Telemetry request bit clear
+	uint16_t crc = v ^ v >> 4 ^ v >> 8;
+	if (board_dshot_telemetry) crc = ~crc;
+	return v << 4 | (crc & 0xF);
+}
+
+// Edges are a few cycles apart, several of them can fall into one simulation step
+static void dshot_step()
+{
+	double bit = (double)board_f_cpu / (board_dshot_rate * 1000.0);
+	while (mcu.cycle >= rc_next_edge) {
+		uint64_t edge = rc_next_edge;
+		if (rc_level) {
+			rc_level = 0;
+			if (++dshot_bit < 16) {
+				rc_next_edge = rc_frame + (uint64_t)(bit * dshot_bit);
+			}
+			else {
+				rc_frame += (uint64_t)(board_f_cpu / opt.rc_hz);
+				rc_next_edge = rc_frame;
+			}
+		}
+		else {
+			if (dshot_bit >= 16) {
+				dshot_frame = dshot_make_frame(board_dshot_value(throttle_at(mcu_time())));
+				dshot_bit = 0;
+				dshot_frames++;
+			}
+			rc_level = 1;
+			rc_next_edge = edge + (uint64_t)(bit * (dshot_frame & (0x8000 >> dshot_bit) ? 0.75 : 0.375));
+		}
+		board_rc_signal(rc_level ^ board_dshot_telemetry, edge);
+	}
+}
+
+static void rc_step()
+{
+	if (board_signal_type == 3) {
+		dshot_step();
+		return;
+	}
+	if (mcu.cycle < rc_next_edge) return;
+	if (rc_level) {
+		rc_level = 0;
+		rc_frame += (uint64_t)(board_f_cpu / opt.rc_hz);
+		rc_next_edge = rc_frame;
+	}
+	else {
+		double us = board_rc_pulse_us(throttle_at(mcu_time()));
+		us = us * rc_protocols[opt.rc_protocol].scale + rc_protocols[opt.rc_protocol].offset;
+		rc_level = 1;
+		rc_next_edge = mcu.cycle + (uint64_t)(us * board_f_cpu / 1e6);
+	}
+	board_rc_signal(rc_level, mcu.cycle);
+}
+
+// *------------------*
+// |    Observation   |
+// *------------------*
+
+typedef struct {
+	uint64_t n;
+	double sum;
+	double sum2;
+	double min;
+	double max;
+} stats;
+
+static void stats_add(stats* s, double x)
+{
+	if (!s->n || x < s->min) s->min = x;
+	if (!s->n || x > s->max) s->max = x;
+	s->n++;
+	s->sum += x;
+	s->sum2 += x * x;
+}
+
+static double stats_mean(const stats* s)
+{
+	return s->n? s->sum / s->n : 0;
+}
+
+static double stats_std(const stats* s)
+{
+	if (!s->n) return 0;
+	double mean = stats_mean(s);
+	double var = s->sum2 / s->n - mean * mean;
+	return var > 0? sqrt(var) : 0;
+}
+
+static struct {
+	int8_t high;
+	int8_t low;
+	uint8_t zc_seen;					// ZC detected since the last commutation
+	uint8_t in_run;
+	uint8_t bad;						// Consecutive bad commutations
+	uint64_t starts;
+	uint64_t count;
+	uint64_t missed;
+	uint64_t wrong;
+	uint64_t sync_loss;
+	double top_erpm;
+	double peak_current;
+	double min_supply;					// [V] Battery sag, see rbat
+	stats advance;
+	stats zc_error;
+	int8_t demag_phase;					// Floating phase still conducting after the commutation
+	double demag_start;
+	stats demag;						// [deg] Until its diode stops conducting
+	uint8_t status;						// firmware_motor_status()
+	double start_begin;					// [s] Since the start attempts began
+	stats start_time;					// [ms] Until run() takes over
+	uint64_t start_fails;
+} obs = {-1, -1, .demag_phase = -1};
+
+static double wrap_deg(double a)
+{
+	while (a > 180) a -= 360;
+	while (a <= -180) a += 360;
+	return a;
+}
+
+/* The state (high, low) is ideal over the 60 degrees centered on the zero-cross of the
+floating phase back-EMF going the right way. Returns that ZC angle. */
+static double zc_angle(int8_t high, int8_t low)
+{
+	int8_t f = 3 - high - low;
+	double zc = f * 120 + 90;
+	if (cos((zc - high * 120) * M_PI / 180) < cos((zc - low * 120) * M_PI / 180)) zc -= 180;
+	return zc;
+}
+
+/* The firmware is supposed to enter a state TIMING_ADVANCE degrees before the start of its
+ideal window. A commutation is bad if it's more than 30 degrees off, or if the run loop
+had to commutate without seeing the ZC. */
+static void obs_commutation()
+{
+	double advance = wrap_deg(zc_angle(obs.high, obs.low) - 30 - DEG(motor_angle()));
+	uint8_t bad = 0;
+	if (!obs.in_run) return;
+	obs.count++;
+	if (obs.demag_phase >= 0) stats_add(&obs.demag, wrap_deg(DEG(motor_angle()) - obs.demag_start));
+	obs.demag_phase = 3 - obs.high - obs.low;
+	obs.demag_start = DEG(motor_angle());
+	if (!obs.zc_seen) {
+		obs.missed++;
+		bad = 1;
+	}
+	else if (advance < -30 || advance > 60) {
+		obs.wrong++;
+		bad = 1;
+	}
+	else stats_add(&obs.advance, advance);
+	obs.zc_seen = 0;
+	if (!bad) {
+		obs.bad = 0;
+		return;
+	}
+	if (!obs.bad++) obs.sync_loss++;
+	if (obs.bad >= SYNC_LOST_COMS) obs.in_run = 0;
+}
+
+static void obs_zc()
+{
+	obs.zc_seen = 1;
+	if (!obs.in_run) {
+		obs.in_run = 1;
+		obs.bad = 0;
+		obs.starts++;
+	}
+	stats_add(&obs.zc_error, wrap_deg(DEG(motor_angle()) - zc_angle(obs.high, obs.low)));
+}
+
+static void obs_step()
+{
+	int8_t high = -1;
+	int8_t p;
+	for (p = 0; p < 3; p++) {
+		uint8_t leg = board_leg(p);
+		if (leg == LEG_SHORT) {
+			fprintf(stderr, "%.6f s: shoot-through on phase %d\n", mcu_time(), p);
+			mcu_stop(MCU_EXIT_WORLD);
+		}
+		if (leg == LEG_HIGH) high = p;
+	}
+	int8_t low = firmware_pwm_phase();
+	if (high >= 0 && low >= 0 && high != low && (high != obs.high || low != obs.low)) {
+		obs.high = high;
+		obs.low = low;
+		obs_commutation();
+	}
+	if (firmware_zc_detected()) obs_zc();
+	uint8_t status = firmware_motor_status();
+	if (status != obs.status) {
+		if (status == FW_MOTOR_STARTING) obs.start_begin = mcu_time();
+		else if (status == FW_MOTOR_RUNNING) stats_add(&obs.start_time, (mcu_time() - obs.start_begin) * 1000);
+		else if (obs.status == FW_MOTOR_STARTING) obs.start_fails++;
+		obs.status = status;
+	}
+	if (obs.demag_phase >= 0 && motor_current(obs.demag_phase) == 0) {
+		stats_add(&obs.demag, wrap_deg(DEG(motor_angle()) - obs.demag_start));
+		obs.demag_phase = -1;
+	}
+	
+	if (obs.in_run && motor_erpm() > obs.top_erpm) obs.top_erpm = motor_erpm();
+	for (p = 0; p < 3; p++) {
+		if (fabs(motor_current(p)) > obs.peak_current) obs.peak_current = fabs(motor_current(p));
+	}
+	if (motor_supply() < obs.min_supply) obs.min_supply = motor_supply();
+}
+
+// *------------------*
+// |    I2C master    |
+// *------------------*
+
+#define I2C_SCL_HZ 400000
+#define I2C_MOTOR_RUNNING 2				// MOTOR_RUNNING in globals.h
+
+// Writes the throttle and reads the motor state back in one transfer, every frame
+static struct {
+	uint8_t busy;
+	uint64_t transfers;
+	uint64_t acks;
+	uint64_t nacks;						// Since the first acknowledged one, the firmware boots before
+	uint8_t status;
+	uint8_t faults;						// All reported so far
+	stats speed_error;					// [%] Reported speed against the motor's, while running
+} i2c;
+
+static void i2c_step()
+{
+	if (i2c.busy && mcu.twi_result != MCU_TWI_BUSY) {
+		i2c.busy = 0;
+		i2c.transfers++;
+		if (mcu.twi_result == MCU_TWI_OK) {
+			double erpm = motor_erpm();
+			i2c.acks++;
+			i2c.status = mcu.twi_rd[0];
+			i2c.faults |= mcu.twi_rd[1];
+			if (i2c.status == I2C_MOTOR_RUNNING && erpm > 1000) {
+				stats_add(&i2c.speed_error, 100 * ((mcu.twi_rd[2] << 8 | mcu.twi_rd[3]) * 60 / erpm - 1));
+			}
+		}
+		else if (i2c.acks) i2c.nacks++;
+	}
+	if (mcu.cycle < rc_next_edge) return;
+	uint8_t buf[2];
+	uint8_t len = board_i2c_throttle(throttle_at(mcu_time()), buf);
+	rc_next_edge += (uint64_t)(board_f_cpu / opt.rc_hz);
+	if (!i2c.busy) i2c.busy = mcu_twi_transfer(I2C_SCL_HZ, board_i2c_address, buf, len, 4);
+}
+
+// *------------------*
+// | DShot telemetry  |
+// *------------------*
+
+// Replies on the DShot wire, decoded from the edges the way a flight controller does: each edge
+// is a GCR 1, the bits between them are 0, 21 bits at 5/4 of the DShot rate with the start bit
+static struct {
+	int8_t level;						// Driven by the firmware, -1 while it's an input
+	uint64_t edges[24];
+	uint8_t n;
+	uint64_t replies;
+	uint64_t bad;
+	stats erpm_error;					// [%] Reported speed against the motor's, while running
+} tlm = {-1};
+
+static const int8_t tlm_gcr_decode[32] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, 9, 10, 11, -1, 13, 14, 15,
+	-1, -1, 2, 3, -1, 5, 6, 7, -1, 0, 8, 1, -1, 4, 12, -1
+};
+
+static void tlm_decode(uint64_t release)
+{
+	double bit = (double)board_f_cpu / (board_dshot_rate * 1250.0);
+	uint32_t bits = 0;
+	uint8_t count = 0;
+	uint8_t i;
+	for (i = 0; i < tlm.n && count < 21; i++) {
+		uint64_t next = i + 1 < tlm.n ? tlm.edges[i + 1] : release;
+		uint8_t len = (uint8_t)((next - tlm.edges[i]) / bit + 0.5);
+		if (!len) len = 1;
+		if (count + len > 21) len = 21 - count;
+		bits = (bits << len) | (1UL << (len - 1));
+		count += len;
+	}
+	if (count != 21) {
+		tlm.bad++;
+		return;
+	}
+	uint16_t value = 0;
+	for (i = 0; i < 4; i++) {
+		int8_t nibble = tlm_gcr_decode[(bits >> (15 - 5 * i)) & 0x1F];
+		if (nibble < 0) {
+			tlm.bad++;
+			return;
+		}
+		value = value << 4 | nibble;
+	}
+	if (((value ^ value >> 4 ^ value >> 8 ^ value >> 12) & 0xF) != 0xF) {
+		tlm.bad++;
+		return;
+	}
+	tlm.replies++;
+	value >>= 4;
+	double erpm = motor_erpm();
+	if (value != 0xFFF && obs.starts && erpm > 1000) {
+		double period_us = (value & 0x1FF) << (value >> 9);
+		stats_add(&tlm.erpm_error, 100 * (60e6 / period_us / erpm - 1));
+	}
+}
+
+static void tlm_step()
+{
+	int8_t level = board_signal_out();
+	if (level == tlm.level) return;
+	if (level < 0) {
+		tlm_decode(mcu.cycle);
+		tlm.n = 0;
+	}
+	else if (tlm.n < sizeof(tlm.edges) / sizeof(tlm.edges[0])) {
+		tlm.edges[tlm.n++] = mcu.cycle;
+	}
+	tlm.level = level;
+}
+
+// *------------------*
+// |  UART telemetry  |
+// *------------------*
+
+// Frames as in telemetry.h: sync, type, payload, sum of type and payload
+#define UART_SYNC 0xA5
+#define UART_RUN 1
+#define UART_START 2
+#define UART_STOP 3
+
+static const uint8_t uart_frame_len[] = {0, 20, 5, 2};	// Type and payload
+
+static struct {
+	uint8_t buf[24];
+	uint8_t n;
+	uint64_t frames;
+	uint64_t bad;						// Unknown type or wrong sum
+	uint64_t skipped;					// Bytes outside frames
+	uint64_t starts[3];					// By start() result: OK, no signal, failed
+	uint64_t stops;
+	uint64_t commutations;
+	uint64_t late;
+	uint64_t no_pre_zc;
+	uint16_t demag_max;					// [Timer1 ticks]
+	uint64_t demag_cuts;
+	stats speed_error;					// [%] Reported speed against the motor's
+} uart;
+
+static void uart_frame()
+{
+	const uint8_t* f = uart.buf + 1;
+	uart.frames++;
+	switch (f[0]) {
+		case UART_RUN: {
+			double erpm = motor_erpm();
+			uart.commutations += f[9] | f[10] << 8;
+			uart.late += f[15];
+			uart.no_pre_zc += f[16];
+			if ((f[17] | f[18] << 8) > uart.demag_max) uart.demag_max = f[17] | f[18] << 8;
+			uart.demag_cuts += f[19];
+			if (erpm > 1000) stats_add(&uart.speed_error, 100 * ((f[1] | f[2] << 8) * 60 / erpm - 1));
+			break;
+		}
+		case UART_START:
+			if (f[2] < 3) uart.starts[f[2]]++;
+			break;
+		case UART_STOP:
+			uart.stops++;
+			break;
+	}
+}
+
+static void uart_rx(uint8_t byte)
+{
+	uint8_t i, sum = 0, len;
+	if (!uart.n && byte != UART_SYNC) {
+		uart.skipped++;
+		return;
+	}
+	uart.buf[uart.n++] = byte;
+	if (uart.n < 2) return;
+	if (!uart.buf[1] || uart.buf[1] >= sizeof(uart_frame_len)) {
+		uart.bad++;
+		uart.n = 0;
+		return;
+	}
+	len = uart_frame_len[uart.buf[1]];
+	if (uart.n < len + 2) return;
+	uart.n = 0;
+	for (i = 1; i <= len; i++) sum += uart.buf[i];
+	if (sum != uart.buf[len + 1]) uart.bad++;
+	else uart_frame();
+}
+
+static void world_step(uint32_t cycles)
+{
+	motor_step(cycles);
+	if (board_signal_type == 2) i2c_step();
+	else rc_step();
+	if (board_dshot_telemetry) tlm_step();
+	if (config_next < config_count) config_step();
+	obs_step();
+}
+
+// *------------------*
+// |      Report      |
+// *------------------*
+
+static const char* exit_names[] = {"time", "return", "watchdog", "unhandled interrupt", "world"};
+
+static const char* vector_names[MCU_VECTORS] = {
+	0, "INT0", "INT1", "TIMER2_COMP", "TIMER2_OVF", "TIMER1_CAPT", "TIMER1_COMPA",
+	"TIMER1_COMPB", "TIMER1_OVF", "TIMER0_OVF", "SPI_STC", "USART_RXC", "USART_UDRE",
+	"USART_TXC", "ADC", "EE_RDY", "ANA_COMP", "TWI", "SPM_RDY"
+};
+
+static void report(uint8_t reason, double host_seconds)
+{
+	double sim = mcu_time();
+	uint8_t v;
+	printf("exit:              %s\n", exit_names[reason]);
+	printf("simulated time:    %.3f s\n", sim);
+	printf("host time:         %.3f s (%.2fx real time)\n", host_seconds, sim / host_seconds);
+	printf("I/O accesses:      %.0f/s host, %.0f/s simulated\n", mcu.io_count / host_seconds, mcu.io_count / sim);
+	printf("\n%-14s %10s %10s %8s %8s %7s\n", "interrupt", "count", "per s", "avg cyc", "max cyc", "load");
+	for (v = 1; v < MCU_VECTORS; v++) {
+		if (!mcu.irq_count[v]) continue;
+		printf("%-14s %10llu %10.0f %8.1f %8u %6.2f%%\n", vector_names[v],
+			(unsigned long long)mcu.irq_count[v], mcu.irq_count[v] / sim,
+			(double)mcu.irq_cycles[v] / mcu.irq_count[v], mcu.irq_max_cycles[v],
+			100.0 * mcu.irq_cycles[v] / mcu.cycle);
+	}
+	printf("\nmotor:             %.0f eRPM now, %.0f eRPM top, %.1f A peak\n",
+		motor_erpm(), obs.top_erpm, obs.peak_current);
+	printf("battery:           %.2f V now, %.2f V min", motor_supply(), obs.min_supply);
+	if (firmware_battery_cells()) printf(", %u cells counted", firmware_battery_cells());
+	printf("\n");
+	printf("runs:              %llu started, %llu sync lost\n",
+		(unsigned long long)obs.starts, (unsigned long long)obs.sync_loss);
+	printf("commutations:      %llu, %llu without ZC, %llu out of sector\n",
+		(unsigned long long)obs.count, (unsigned long long)obs.missed, (unsigned long long)obs.wrong);
+	if (obs.start_time.n || obs.start_fails) {
+		printf("start-up:          %llu to run(), mean %.1f, max %.1f [ms], %llu given up\n",
+			(unsigned long long)obs.start_time.n, stats_mean(&obs.start_time), obs.start_time.max,
+			(unsigned long long)obs.start_fails);
+	}
+	if (obs.advance.n) {
+		printf("timing advance:    mean %.2f, std %.2f, min %.2f, max %.2f [deg]\n",
+			stats_mean(&obs.advance), stats_std(&obs.advance), obs.advance.min, obs.advance.max);
+	}
+	if (obs.zc_error.n) {
+		printf("ZC detection lag:  mean %.2f, std %.2f, min %.2f, max %.2f [deg]\n",
+			stats_mean(&obs.zc_error), stats_std(&obs.zc_error), obs.zc_error.min, obs.zc_error.max);
+	}
+	if (obs.demag.n) {
+		printf("demagnetization:   mean %.2f, std %.2f, min %.2f, max %.2f [deg]\n",
+			stats_mean(&obs.demag), stats_std(&obs.demag), obs.demag.min, obs.demag.max);
+	}
+	if (board_signal_type == 2) {
+		printf("I2C:               %llu transfers, %llu not acknowledged, status %u, faults 0x%02X\n",
+			(unsigned long long)i2c.transfers, (unsigned long long)i2c.nacks, i2c.status, i2c.faults);
+	}
+	if (i2c.speed_error.n) {
+		printf("I2C speed error:   mean %.2f, std %.2f, min %.2f, max %.2f [%%]\n",
+			stats_mean(&i2c.speed_error), stats_std(&i2c.speed_error), i2c.speed_error.min, i2c.speed_error.max);
+	}
+	if (board_uart_telemetry) {
+		printf("UART telemetry:    %llu frames, %llu bad, %llu bytes skipped\n",
+			(unsigned long long)uart.frames, (unsigned long long)uart.bad, (unsigned long long)uart.skipped);
+		printf("UART events:       %llu started, %llu no signal, %llu failed, %llu runs ended\n",
+			(unsigned long long)uart.starts[0], (unsigned long long)uart.starts[1],
+			(unsigned long long)uart.starts[2], (unsigned long long)uart.stops);
+		printf("UART commutations: %llu, %llu late ZC, %llu without pre-ZC\n",
+			(unsigned long long)uart.commutations, (unsigned long long)uart.late, (unsigned long long)uart.no_pre_zc);
+		printf("UART demag:        longest %u ticks, %llu power cuts\n",
+			uart.demag_max, (unsigned long long)uart.demag_cuts);
+	}
+	if (uart.speed_error.n) {
+		printf("UART speed error:  mean %.2f, std %.2f, min %.2f, max %.2f [%%]\n",
+			stats_mean(&uart.speed_error), stats_std(&uart.speed_error), uart.speed_error.min, uart.speed_error.max);
+	}
+	if (board_dshot_telemetry) {
+		printf("DShot telemetry:   %llu replies to %llu frames, %llu bad\n",
+			(unsigned long long)tlm.replies, (unsigned long long)dshot_frames, (unsigned long long)tlm.bad);
+	}
+	if (tlm.erpm_error.n) {
+		printf("eRPM error:        mean %.2f, std %.2f, min %.2f, max %.2f [%%]\n",
+			stats_mean(&tlm.erpm_error), stats_std(&tlm.erpm_error), tlm.erpm_error.min, tlm.erpm_error.max);
+	}
+	if (config_count) {
+		printf("settings changes:  %u requested, %u refused, %s, PWM top %u cycles\n", config_next, config_refused,
+			firmware_config_pending()? "the last one pending" : "none pending", firmware_pwm_top());
+	}
+	printf("\nmetrics: exit=%s starts=%llu sync_loss=%llu zc_jitter=%.3f advance=%.3f top_erpm=%.0f start_ms=%.1f\n",
+		exit_names[reason], (unsigned long long)obs.starts, (unsigned long long)obs.sync_loss,
+		stats_std(&obs.zc_error), stats_mean(&obs.advance), obs.top_erpm, obs.start_time.max);
+}
+
+// *------------------*
+// |     Options      |
+// *------------------*
+
+static int parse_profile(char* s)
+{
+	char* tok;
+	opt.steps = 0;
+	for (tok = strtok(s, ","); tok; tok = strtok(0, ",")) {
+		if (opt.steps >= PROFILE_MAX) return -1;
+		char* colon = strchr(tok, ':');
+		opt.step_time[opt.steps] = colon? atof(tok) : 0;
+		opt.step_throttle[opt.steps] = atof(colon? colon + 1 : tok);
+		opt.steps++;
+	}
+	return opt.steps? 0 : -1;
+}
+
+static int parse_config(char* s)
+{
+	char* colon = strchr(s, ':');
+	char* tok;
+	if (!colon || config_count >= CONFIG_MAX) return -1;
+	configs[config_count].time = atof(s);
+	for (tok = strtok(colon + 1, ","); tok; tok = strtok(0, ",")) {
+		char* eq = strchr(tok, '=');
+		uint8_t k = configs[config_count].keys;
+		if (!eq || k >= CONFIG_KEYS) return -1;
+		*eq = 0;
+		firmware_config_begin();
+		if (firmware_config_set(tok, 0)) return -1;			// Unknown key
+		configs[config_count].key[k] = tok;
+		configs[config_count].value[k] = atol(eq + 1);
+		configs[config_count].keys++;
+	}
+	if (!configs[config_count].keys) return -1;
+	config_count++;
+	return 0;
+}
+
+static int parse_protocol(const char* s)
+{
+	for (opt.rc_protocol = 0; opt.rc_protocol < sizeof(rc_protocols) / sizeof(rc_protocols[0]); opt.rc_protocol++) {
+		if (!strcmp(s, rc_protocols[opt.rc_protocol].name)) return 0;
+	}
+	return 1;
+}
+
+static int parse_motor(char* s)
+{
+	static const struct {
+		const char* name;
+		double* value;
+	} keys[] = {
+		{"r", &motor.r}, {"l", &motor.l}, {"kv", &motor.kv}, {"poles", &motor.poles},
+		{"j", &motor.j}, {"friction", &motor.friction}, {"drag", &motor.drag},
+		{"vbus", &motor.vbus}, {"vdiode", &motor.vdiode}, {"rbat", &motor.rbat}
+	};
+	char* tok;
+	for (tok = strtok(s, ","); tok; tok = strtok(0, ",")) {
+		char* eq = strchr(tok, '=');
+		uint8_t k;
+		if (!eq) return -1;
+		*eq = 0;
+		for (k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+			if (!strcmp(tok, keys[k].name)) break;
+		}
+		if (k == sizeof(keys) / sizeof(keys[0])) return -1;
+		*keys[k].value = atof(eq + 1);
+	}
+	return 0;
+}
+
+static uint8_t throttle_requested()
+{
+	uint8_t i;
+	for (i = 0; i < opt.steps; i++) {
+		if (opt.step_throttle[i] > 0 && opt.arm_time + opt.step_time[i] < opt.time) return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int c;
+	int bad = 0;
+	while ((c = getopt(argc, argv, "t:a:p:r:f:s:m:c:h")) != -1) {
+		switch (c) {
+			case 't': opt.time = atof(optarg); break;
+			case 'a': opt.arm_time = atof(optarg); break;
+			case 'p': bad |= parse_profile(optarg); break;
+			case 'r': opt.hold_erpm = atof(optarg); break;
+			case 'f': opt.rc_hz = atof(optarg); break;
+			case 's': bad |= parse_protocol(optarg); break;
+			case 'm': bad |= parse_motor(optarg); break;
+			case 'c': bad |= parse_config(optarg); break;
+			default: bad = 1;
+		}
+	}
+	if (bad) {
+		fprintf(stderr, "usage: %s [-t seconds] [-a arm_time] [-p throttle|t:throttle,...] [-r erpm] "
+			"[-f rc_hz] [-s protocol] [-m key=value,...] [-c t:key=value,...]\n", argv[0]);
+		return 2;
+	}
+
+	if (!opt.rc_hz) opt.rc_hz = board_signal_type == 3 ? 1000 : board_signal_type == 2 ? 500 : opt.rc_protocol? 2000 : 50;
+	dshot_bit = 16;
+
+	mcu.world_step = world_step;
+	mcu.analog = board_analog;
+	mcu.uart_rx = uart_rx;
+	mcu_reset(board_f_cpu);
+	if (board_dshot_telemetry) board_rc_signal(1, 0);		// Idle high
+	motor_init();
+	obs.min_supply = motor.vbus;
+	if (opt.hold_erpm) motor_hold(opt.hold_erpm);
+
+	clock_t start = clock();
+	uint8_t reason = mcu_run(cbldc_main, opt.time);
+	report(reason, (double)(clock() - start) / CLOCKS_PER_SEC);
+	if (reason != MCU_EXIT_TIME || obs.sync_loss || i2c.nacks || tlm.bad || uart.bad || uart.skipped || config_refused) return 1;
+	if (throttle_requested() && !obs.starts) return 1;
+	return 0;
+}
@@ -0,0 +1,733 @@
+/*
+ * mcu.c
+ *
+ * Simulated ATmega8 for the host build. Only the peripherals the firmware uses are modelled:
+ * port pins, external interrupts, Timer0 as a counter, Timer1 in normal mode with input capture,
+ * Timer2 in normal and phase correct PWM mode, the analog comparator, single ADC conversions,
+ * the TWI as a slave, the USART transmitter and the watchdog.
+ */
+
+#include <string.h>
+#include <avr/io.h>
+#include "mcu.h"
+#include "../tools/brs.h"
+
+mcu_state mcu;
+
+// ISRs are defined by the firmware build (C ports of the asm ISRs). Missing ones are NULL.
+#define MCU_VECTOR(n) void __vector_##n(void) __attribute__((weak));
+MCU_VECTOR(1) MCU_VECTOR(2) MCU_VECTOR(3) MCU_VECTOR(4) MCU_VECTOR(5) MCU_VECTOR(6)
+MCU_VECTOR(7) MCU_VECTOR(8) MCU_VECTOR(9) MCU_VECTOR(10) MCU_VECTOR(11) MCU_VECTOR(12)
+MCU_VECTOR(13) MCU_VECTOR(14) MCU_VECTOR(15) MCU_VECTOR(16) MCU_VECTOR(17) MCU_VECTOR(18)
+
+static void (*const mcu_vectors[MCU_VECTORS])(void) = {
+	0,
+	__vector_1, __vector_2, __vector_3, __vector_4, __vector_5, __vector_6,
+	__vector_7, __vector_8, __vector_9, __vector_10, __vector_11, __vector_12,
+	__vector_13, __vector_14, __vector_15, __vector_16, __vector_17, __vector_18
+};
+
+// Interrupt sources in priority order: enable register/bit, flag register/bit.
+// Flags marked "hw_clear" are cleared by hardware when the ISR is entered.
+typedef struct {
+	uint8_t vector;
+	uint8_t en_reg;
+	uint8_t en_bit;
+	uint8_t flag_reg;
+	uint8_t flag_bit;
+	uint8_t hw_clear;
+} mcu_irq;
+
+
+static const mcu_irq mcu_irqs[] = {
+	{1,  0x3B, INT0,   0x3A, INTF0, 1},		// GICR, GIFR
+	{2,  0x3B, INT1,   0x3A, INTF1, 1},
+	{3,  0x39, OCIE2,  0x38, OCF2,  1},		// TIMSK, TIFR
+	{4,  0x39, TOIE2,  0x38, TOV2,  1},
+	{5,  0x39, TICIE1, 0x38, ICF1,  1},
+	{6,  0x39, OCIE1A, 0x38, OCF1A, 1},
+	{7,  0x39, OCIE1B, 0x38, OCF1B, 1},
+	{8,  0x39, TOIE1,  0x38, TOV1,  1},
+	{9,  0x39, TOIE0,  0x38, TOV0,  1},
+	{14, 0x06, ADIE,   0x06, ADIF,  1},		// ADCSRA
+	{16, 0x08, ACIE,   0x08, ACI,   1},		// ACSR
+	{17, 0x36, TWIE,   0x36, TWINT, 0},		// TWCR
+};
+
+#define R_TWSR 0x01
+#define R_TWAR 0x02
+#define R_TWDR 0x03
+#define R_ADCSRA 0x06
+#define R_ADMUX 0x07
+#define R_ACSR 0x08
+#define R_UBRRL 0x09
+#define R_UCSRB 0x0A
+#define R_UCSRA 0x0B
+#define R_UDR 0x0C
+#define R_PIND 0x10
+#define R_DDRD 0x11
+#define R_PORTD 0x12
+#define R_PINB 0x16
+#define R_DDRB 0x17
+#define R_OCR2 0x23
+#define R_TCNT2 0x24
+#define R_TCCR2 0x25
+#define R_TCCR1B 0x2E
+#define R_TCNT0 0x32
+#define R_TCCR0 0x33
+#define R_UBRRH 0x20
+#define R_SFIOR 0x30
+#define R_MCUCR 0x35
+#define R_TWCR 0x36
+#define R_TIFR 0x38
+#define R_GIFR 0x3A
+#define R_GICR 0x3B
+
+// Reserved bits used to make writes to flag registers visible, see mcu.h
+#define TIFR_MARKER 0x02
+#define GIFR_MARKER 0x01
+#define TWCR_MARKER 0x02
+
+static const uint16_t mcu_t1_prescalers[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+static const uint16_t mcu_t2_prescalers[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+static const uint8_t mcu_adc_prescalers[8] = {2, 2, 4, 8, 16, 32, 64, 128};
+
+// *------------------*
+// |    Registers     |
+// *------------------*
+
+static uint8_t mcu_read8(uint8_t a)
+{
+	switch (a) {
+		case 0x10: case 0x13: case 0x16: {				// PINx
+			uint8_t port = 2 - (a - 0x10) / 3;			// 0 = B, 1 = C, 2 = D
+			uint8_t ddr = mcu.reg[a + 1];
+			return (mcu.reg[a + 2] & ddr) | (mcu.pin_ext[port] & ~ddr);
+		}
+		case R_TCNT2: return mcu.tcnt2;
+		case R_TCNT0: return mcu.tcnt0;
+		case R_TIFR: return mcu.reg[a] | TIFR_MARKER;
+		case R_GIFR: return mcu.reg[a] | GIFR_MARKER;
+		case R_TWCR: return mcu.reg[a] | TWCR_MARKER;
+		case R_ACSR: return (mcu.reg[a] & ~(1<<ACO)) | (mcu.aco<<ACO);
+		case R_UCSRA: return (mcu.reg[a] & ~(1<<UDRE)) | (!mcu.uart_buf_full << UDRE);
+		case 0x04: return mcu.adc;
+		case 0x05: return mcu.adc >> 8;
+		case 0x26: return mcu.icr1;
+		case 0x27: return mcu.icr1 >> 8;
+		case 0x28: return mcu.ocr1b;
+		case 0x29: return mcu.ocr1b >> 8;
+		case 0x2A: return mcu.ocr1a;
+		case 0x2B: return mcu.ocr1a >> 8;
+		case 0x2C: return mcu.tcnt1;
+		case 0x2D: return mcu.tcnt1 >> 8;
+		default: return mcu.reg[a];
+	}
+}
+
+// ADC reference voltage of this ADMUX
+static double mcu_adc_vref(uint8_t admux)
+{
+	return (admux >> REFS0) == 3? 2.56 : 5.0;						// AREF is taken as AVCC
+}
+
+static void mcu_write8(uint8_t a, uint8_t v)
+{
+	switch (a) {
+		case 0x10: case 0x13: case 0x16: break;			// PINx, read only
+		case R_TCNT2: mcu.tcnt2 = v; break;
+		case R_TCNT0: mcu.tcnt0 = v; break;
+		case R_TIFR: mcu.reg[a] &= ~v; break;			// Write one to clear
+		case R_GIFR: mcu.reg[a] &= ~v; break;
+		case R_TWCR: {
+			// TWINT is cleared by writing one. TWSTO only releases the bus in slave mode.
+			uint8_t twint = mcu.reg[a] & (1<<TWINT);
+			if (v & (1<<TWINT)) twint = 0;
+			mcu.reg[a] = (v & ~((1<<TWINT) | (1<<TWSTO) | TWCR_MARKER)) | twint;
+			break;
+		}
+		case R_ADMUX:
+			if ((v ^ mcu.reg[a]) >> REFS0) {
+				mcu.adc_aref = mcu_adc_vref(mcu.reg[a]);
+				mcu.adc_ref_switched = 1;
+			}
+			mcu.reg[a] = v;
+			break;
+		case R_ADCSRA: {
+			// ADSC starts a conversion and reads 1 until it's done, clearing ADEN aborts it.
+			// The first conversion after ADEN is set takes longer, the analog part starts up.
+			uint8_t adsc = mcu.reg[a] & (1<<ADSC);
+			uint8_t adif = mcu.reg[a] & (1<<ADIF);
+			if (v & (1<<ADIF)) adif = 0;
+			if (BIC(v, ADEN)) {
+				adsc = 0;
+				mcu.adc_first = 1;
+			}
+			else if (BIS(v, ADSC) && !adsc) {
+				adsc = 1<<ADSC;
+				mcu.adc_cycles = 0;
+				mcu.adc_sampled = 0;
+			}
+			mcu.reg[a] = (v & ~((1<<ADSC) | (1<<ADIF))) | adsc | adif;
+			break;
+		}
+		case R_ACSR: {
+			uint8_t aci = mcu.reg[a] & (1<<ACI);
+			if (v & (1<<ACI)) aci = 0;
+			mcu.reg[a] = (v & ~((1<<ACO) | (1<<ACI))) | aci;
+			break;
+		}
+		case R_UCSRA: {
+			uint8_t txc = mcu.reg[a] & (1<<TXC);
+			if (v & (1<<TXC)) txc = 0;
+			mcu.reg[a] = (v & ~((1<<TXC) | (1<<UDRE))) | txc;
+			break;
+		}
+		case R_UDR: break;								// See mcu_commit()
+		case R_UBRRH:									// Shared with UCSRC
+			if (v & (1<<URSEL)) mcu.reg[a] = v;
+			else mcu.uart_ubrrh = v;
+			break;
+		case 0x26: mcu.icr1 = (mcu.icr1 & 0xFF00) | v; break;
+		case 0x27: mcu.icr1 = (mcu.icr1 & 0x00FF) | v<<8; break;
+		case 0x28: mcu.ocr1b = (mcu.ocr1b & 0xFF00) | v; break;
+		case 0x29: mcu.ocr1b = (mcu.ocr1b & 0x00FF) | v<<8; break;
+		case 0x2A: mcu.ocr1a = (mcu.ocr1a & 0xFF00) | v; break;
+		case 0x2B: mcu.ocr1a = (mcu.ocr1a & 0x00FF) | v<<8; break;
+		case 0x2C: mcu.tcnt1 = (mcu.tcnt1 & 0xFF00) | v; break;
+		case 0x2D: mcu.tcnt1 = (mcu.tcnt1 & 0x00FF) | v<<8; break;
+		default: mcu.reg[a] = v;
+	}
+}
+
+static uint16_t* mcu_reg16(uint8_t a)
+{
+	switch (a) {
+		case 0x04: return &mcu.adc;
+		case 0x26: return &mcu.icr1;
+		case 0x28: return &mcu.ocr1b;
+		case 0x2A: return &mcu.ocr1a;
+		default: return &mcu.tcnt1;
+	}
+}
+
+// A byte takes 10 bits: start, 8 data, stop
+static uint32_t mcu_uart_byte_cycles()
+{
+	uint16_t ubrr = (mcu.uart_ubrrh & 0x0F) << 8 | mcu.reg[R_UBRRL];
+	return 10 * (ubrr + 1) * (BIS(mcu.reg[R_UCSRA], U2X)? 8 : 16);
+}
+
+// UDR write: straight into the shift register if it's idle, otherwise the buffer is overwritten
+static void mcu_uart_write(uint8_t v)
+{
+	if (!BIS(mcu.reg[R_UCSRB], TXEN)) return;
+	if (!mcu.uart_shifting) {
+		mcu.uart_shifting = 1;
+		mcu.uart_shift = v;
+		mcu.uart_wait = mcu_uart_byte_cycles();
+		CBI(mcu.reg[R_UCSRA], TXC);
+	}
+	else {
+		mcu.uart_buf = v;
+		mcu.uart_buf_full = 1;
+	}
+}
+
+// Apply the writes the firmware did to scratch copies since the last access.
+static void mcu_commit()
+{
+	uint8_t a;
+	if (memcmp(mcu.io8, mcu.ld8, sizeof(mcu.io8))) {
+		for (a = 0; a < MCU_IO_SIZE; a++) {
+			if (mcu.io8[a] != mcu.ld8[a]) {
+				mcu.ld8[a] = mcu.io8[a];
+				mcu_write8(a, mcu.io8[a]);
+			}
+		}
+	}
+	if (memcmp(mcu.io16, mcu.ld16, sizeof(mcu.io16))) {
+		for (a = 0; a < MCU_IO_SIZE; a++) {
+			if (mcu.io16[a] != mcu.ld16[a]) {
+				mcu.ld16[a] = mcu.io16[a];
+				*mcu_reg16(a) = mcu.io16[a];
+			}
+		}
+	}
+	if (mcu.uart_written) {
+		mcu.uart_written = 0;
+		mcu_uart_write(mcu.io8[R_UDR]);
+	}
+}
+
+// *------------------*
+// |   Peripherals    |
+// *------------------*
+
+static void mcu_timer1(uint32_t cycles)
+{
+	uint16_t pres = mcu_t1_prescalers[mcu.reg[R_TCCR1B] & 7];
+	if (!pres) return;
+	uint32_t acc = mcu.t1_acc + cycles;
+	uint32_t ticks = acc / pres;
+	mcu.t1_acc = acc % pres;
+	if (!ticks) return;
+	uint16_t from = mcu.tcnt1 + 1;						// First counter value reached
+	if ((uint16_t)(mcu.ocr1a - from) < ticks) SBI(mcu.reg[R_TIFR], OCF1A);
+	if ((uint16_t)(mcu.ocr1b - from) < ticks) SBI(mcu.reg[R_TIFR], OCF1B);
+	if ((uint32_t)mcu.tcnt1 + ticks > 0xFFFF) SBI(mcu.reg[R_TIFR], TOV1);
+	mcu.tcnt1 += ticks;
+}
+
+// Timer0 shares the prescaler with Timer1
+static void mcu_timer0(uint32_t cycles)
+{
+	uint16_t pres = mcu_t1_prescalers[mcu.reg[R_TCCR0] & 7];
+	if (!pres) return;
+	uint32_t acc = mcu.t0_acc + cycles;
+	uint32_t ticks = acc / pres;
+	mcu.t0_acc = acc % pres;
+	if ((uint32_t)mcu.tcnt0 + ticks > 0xFF) SBI(mcu.reg[R_TIFR], TOV0);
+	mcu.tcnt0 += ticks;
+}
+
+static void mcu_timer2(uint32_t cycles)
+{
+	uint16_t pres = mcu_t2_prescalers[mcu.reg[R_TCCR2] & 7];
+	if (!pres) return;
+	uint32_t acc = mcu.t2_acc + cycles;
+	uint32_t ticks = acc / pres;
+	mcu.t2_acc = acc % pres;
+	if (!ticks) return;
+	if (BIS(mcu.reg[R_TCCR2], WGM20)) {
+		// Phase correct PWM, 0..255..0. OCR2 is double buffered and updated at the top.
+		while (ticks--) {
+			if (mcu.t2_down) {
+				if (--mcu.tcnt2 == 0) {
+					mcu.t2_down = 0;
+					SBI(mcu.reg[R_TIFR], TOV2);
+				}
+			} else if (++mcu.tcnt2 == 255) {
+				mcu.t2_down = 1;
+				mcu.ocr2 = mcu.reg[R_OCR2];
+			}
+			if (mcu.tcnt2 == mcu.ocr2) SBI(mcu.reg[R_TIFR], OCF2);
+		}
+		// Non-inverting mode only: cleared on the match counting up, set on the match counting down
+		mcu.oc2 = BIS(mcu.reg[R_TCCR2], COM21) && BIS(mcu.reg[R_DDRB], PB3)
+			&& (mcu.ocr2 == 255 || mcu.tcnt2 < mcu.ocr2);
+		return;
+	}
+	uint8_t from = mcu.tcnt2 + 1;
+	if (ticks > 255 || (uint8_t)(mcu.reg[R_OCR2] - from) < ticks) SBI(mcu.reg[R_TIFR], OCF2);
+	if (mcu.tcnt2 + ticks > 0xFF) SBI(mcu.reg[R_TIFR], TOV2);
+	mcu.tcnt2 += ticks;
+}
+
+// TWI master side of a transfer: address and write bytes, repeated start, address and read bytes,
+// stop. twi_state is the bus event in progress. The slave gets TWINT and a status for each one.
+#define TWI_IDLE 0
+#define TWI_SLA_W 1
+#define TWI_WRITE 2
+#define TWI_RESTART 3
+#define TWI_STOP 4
+#define TWI_SLA_R 5
+#define TWI_READ 6
+
+static uint8_t mcu_twi_addressed()
+{
+	uint8_t twcr = mcu.reg[R_TWCR];
+	return BIS(twcr, TWEN) && BIS(twcr, TWEA) && mcu.reg[R_TWAR] >> 1 == mcu.twi_addr;
+}
+
+static void mcu_twi_status(uint8_t status)
+{
+	mcu.reg[R_TWSR] = (mcu.reg[R_TWSR] & 3) | status;
+	SBI(mcu.reg[R_TWCR], TWINT);
+}
+
+static void mcu_twi_next(uint8_t state, uint8_t bits)
+{
+	mcu.twi_state = state;
+	mcu.twi_wait = bits * mcu.twi_bit;
+}
+
+static void mcu_twi_end(uint8_t result)
+{
+	mcu.twi_state = TWI_IDLE;
+	mcu.twi_result = result;
+}
+
+static void mcu_twi_event()
+{
+	switch (mcu.twi_state) {
+		case TWI_SLA_W:
+			if (!mcu_twi_addressed()) {
+				mcu_twi_end(MCU_TWI_NACK);
+				break;
+			}
+			mcu_twi_status(0x60);
+			mcu_twi_next(TWI_WRITE, 9);
+			break;
+		case TWI_WRITE: {
+			uint8_t ack = BIS(mcu.reg[R_TWCR], TWEA);
+			mcu.reg[R_TWDR] = mcu.twi_wr[mcu.twi_pos++];
+			mcu_twi_status(ack? 0x80 : 0x88);
+			if (!ack) mcu_twi_end(MCU_TWI_NACK);
+			else if (mcu.twi_pos < mcu.twi_wr_len) mcu_twi_next(TWI_WRITE, 9);
+			else mcu_twi_next(mcu.twi_rd_len? TWI_RESTART : TWI_STOP, 1);
+			break;
+		}
+		case TWI_RESTART:
+			mcu_twi_status(0xA0);
+			mcu_twi_next(TWI_SLA_R, 9);
+			break;
+		case TWI_STOP:
+			mcu_twi_status(0xA0);
+			mcu_twi_end(MCU_TWI_OK);
+			break;
+		case TWI_SLA_R:
+			if (!mcu_twi_addressed()) {
+				mcu_twi_end(MCU_TWI_NACK);
+				break;
+			}
+			mcu.twi_pos = 0;
+			mcu_twi_status(0xA8);
+			mcu_twi_next(TWI_READ, 9);
+			break;
+		case TWI_READ:
+			// The master acknowledges all but the last byte, then sends the stop. The slave
+			// transmitter doesn't see the stop.
+			mcu.twi_rd[mcu.twi_pos++] = mcu.reg[R_TWDR];
+			if (mcu.twi_pos < mcu.twi_rd_len) {
+				mcu_twi_status(0xB8);
+				mcu_twi_next(TWI_READ, 9);
+			}
+			else {
+				mcu_twi_status(0xC0);
+				mcu_twi_end(MCU_TWI_OK);
+			}
+			break;
+	}
+}
+
+static void mcu_twi(uint32_t cycles)
+{
+	if (mcu.twi_state == TWI_IDLE) return;
+	if (BIS(mcu.reg[R_TWCR], TWINT)) return;			// SCL held low
+	if (mcu.twi_wait > cycles) {
+		mcu.twi_wait -= cycles;
+		return;
+	}
+	mcu.twi_wait = 0;
+	mcu_twi_event();
+}
+
+static void mcu_uart(uint32_t cycles)
+{
+	if (!mcu.uart_shifting) return;
+	if (mcu.uart_wait > cycles) {
+		mcu.uart_wait -= cycles;
+		return;
+	}
+	if (mcu.uart_rx) mcu.uart_rx(mcu.uart_shift);
+	if (mcu.uart_buf_full) {
+		mcu.uart_buf_full = 0;
+		mcu.uart_shift = mcu.uart_buf;
+		mcu.uart_wait = mcu_uart_byte_cycles();
+	}
+	else {
+		mcu.uart_shifting = 0;
+		SBI(mcu.reg[R_UCSRA], TXC);
+	}
+}
+
+static void mcu_acomp()
+{
+	uint8_t acsr = mcu.reg[R_ACSR];
+	if (!mcu.analog || BIS(acsr, ACD)) return;
+	uint8_t neg = MCU_AIN1;
+	if (BIS(mcu.reg[R_SFIOR], ACME) && BIC(mcu.reg[R_ADCSRA], ADEN)) {
+		neg = mcu.reg[0x07] & 7;						// ADMUX
+	}
+	uint8_t aco = mcu.analog(MCU_AIN0) > mcu.analog(neg);
+	if (aco != mcu.aco) {
+		mcu.aco = aco;
+		switch (acsr & 3) {
+			case 0: SBI(mcu.reg[R_ACSR], ACI); break;					// Toggle
+			case 2: if (!aco) SBI(mcu.reg[R_ACSR], ACI); break;		// Falling edge
+			case 3: if (aco) SBI(mcu.reg[R_ACSR], ACI); break;		// Rising edge
+		}
+
+		// Input capture from the comparator, at the step that saw the edge
+		if (BIS(acsr, ACIC) && aco == (BIS(mcu.reg[R_TCCR1B], ICES1) != 0)) {
+			mcu.icr1 = mcu.tcnt1;
+			SBI(mcu.reg[R_TIFR], ICF1);
+		}
+	}
+}
+
+// Input voltage of the ADC mux channel: ADC0..7, the 1.30 V bandgap and GND
+static double mcu_adc_input(uint8_t mux)
+{
+	if (mux < 8) return mcu.analog? mcu.analog(mux) : 0;
+	return mux == 14? 1.30 : 0;
+}
+
+// A conversion holds the input 1.5 ADC clocks after the start (13.5 on the first one) and ends
+// at 13 (25). Single conversion mode only. The first conversion after a reference switch (REFS)
+// is taken against the old reference, AREF hasn't settled yet.
+
+static void mcu_adc(uint32_t cycles)
+{
+	uint8_t adcsra = mcu.reg[R_ADCSRA];
+	if (BIC(adcsra, ADSC)) return;
+	uint8_t div = mcu_adc_prescalers[adcsra & 7];
+	uint8_t admux = mcu.reg[R_ADMUX];
+	mcu.adc_cycles += cycles;
+	if (!mcu.adc_sampled && mcu.adc_cycles * 2 >= (mcu.adc_first? 27 : 3) * div) {
+		mcu.adc_sampled = 1;
+		mcu.adc_hold = mcu_adc_input(admux & 15);
+	}
+	if (mcu.adc_cycles < (mcu.adc_first? 25 : 13) * div) return;
+	double code = mcu.adc_hold / (mcu.adc_ref_switched? mcu.adc_aref : mcu_adc_vref(admux)) * 1024;
+	mcu.adc_ref_switched = 0;
+	uint16_t result = code <= 0? 0 : code >= 1023? 1023 : (uint16_t)code;
+	mcu.adc = BIS(admux, ADLAR)? result << 6 : result;
+	mcu.adc_first = 0;
+	CBI(mcu.reg[R_ADCSRA], ADSC);
+	SBI(mcu.reg[R_ADCSRA], ADIF);
+}
+
+static void mcu_ext_int(uint8_t pind, uint8_t pin, uint8_t isc, uint8_t flag)
+{
+	uint8_t now = BIS(pind, pin) != 0;
+	uint8_t was = BIS(mcu.pind_prev, pin) != 0;
+	uint8_t fire = 0;
+	// Low level mode (0) is not modelled, it doesn't use the flag on the real chip either.
+	switch (isc) {
+		case 1: fire = now != was; break;
+		case 2: fire = was && !now; break;
+		case 3: fire = !was && now; break;
+	}
+	if (fire) SBI(mcu.reg[R_GIFR], flag);
+}
+
+
+static void mcu_pins()
+{
+	uint8_t pind = mcu_read8(R_PIND);
+	mcu_ext_int(pind, PD2, mcu.reg[R_MCUCR] & 3, INTF0);
+	mcu_ext_int(pind, PD3, (mcu.reg[R_MCUCR] >> 2) & 3, INTF1);
+	mcu.pind_prev = pind;
+}
+
+static void mcu_advance(uint32_t cycles)
+{
+	mcu.cycle += cycles;
+	mcu_timer0(cycles);
+	mcu_timer1(cycles);
+	mcu_timer2(cycles);
+	mcu_twi(cycles);
+	mcu_uart(cycles);
+	mcu_adc(cycles);
+	if (mcu.world_step) mcu.world_step(cycles);
+	mcu_pins();
+	mcu_acomp();
+	if (mcu.wdt_timeout >= 0) {
+		uint64_t timeout = (uint64_t)mcu.f_cpu * (16384 << mcu.wdt_timeout) / 1000000;
+		if (mcu.cycle - mcu.wdt_last > timeout) mcu_stop(MCU_EXIT_WDT);
+	}
+	if (mcu.cycle >= mcu.stop_cycle) mcu_stop(MCU_EXIT_TIME);
+}
+
+static void mcu_dispatch()
+{
+	uint8_t i;
+	while (mcu.sreg_i && !mcu.in_isr) {
+		const mcu_irq* irq = 0;
+		for (i = 0; i < sizeof(mcu_irqs)/sizeof(mcu_irq); i++) {
+			if (BIS(mcu.reg[mcu_irqs[i].en_reg], mcu_irqs[i].en_bit) && BIS(mcu.reg[mcu_irqs[i].flag_reg], mcu_irqs[i].flag_bit)) {
+				irq = &mcu_irqs[i];
+				break;
+			}
+		}
+		if (!irq) return;
+		if (!mcu_vectors[irq->vector]) mcu_stop(MCU_EXIT_BAD_IRQ);
+		if (irq->hw_clear) CBI(mcu.reg[irq->flag_reg], irq->flag_bit);
+
+		uint64_t start = mcu.cycle, nested = mcu.irq_total;
+		mcu.sreg_i = 0;
+		mcu.in_isr = 1;
+		mcu_advance(MCU_IRQ_CYCLES);
+		mcu_vectors[irq->vector]();
+		mcu_commit();
+		mcu_advance(MCU_IRQ_CYCLES);
+		mcu.in_isr = 0;
+		mcu.sreg_i = 1;
+
+		// Without the ISRs nested in an ISR_NOBLOCK one, they have their own counts
+		uint32_t took = mcu.cycle - start - (mcu.irq_total - nested);
+		mcu.irq_total += took;
+		mcu.irq_count[irq->vector]++;
+		mcu.irq_cycles[irq->vector] += took;
+		if (took > mcu.irq_max_cycles[irq->vector]) mcu.irq_max_cycles[irq->vector] = took;
+	}
+}
+
+static void mcu_tick(uint32_t cycles)
+{
+	mcu_commit();
+	mcu_advance(cycles);
+	mcu_dispatch();
+}
+
+// *------------------*
+// |   Firmware API   |
+// *------------------*
+
+volatile uint8_t* mcu_io8(uint8_t addr)
+{
+	mcu.io_count++;
+	mcu_tick(MCU_IO_CYCLES);
+	if (addr == R_UDR) mcu.uart_written = 1;
+	mcu.io8[addr] = mcu.ld8[addr] = mcu_read8(addr);
+	return &mcu.io8[addr];
+}
+
+volatile uint16_t* mcu_io16(uint8_t addr)
+{
+	mcu.io_count++;
+	mcu_tick(MCU_IO_CYCLES);
+	mcu.io16[addr] = mcu.ld16[addr] = *mcu_reg16(addr);
+	return &mcu.io16[addr];
+}
+
+void mcu_cli(void)
+{
+	mcu_commit();
+	mcu.sreg_i = 0;
+	mcu_advance(1);
+}
+
+void mcu_sei(void)
+{
+	mcu.sreg_i = 1;
+	mcu_tick(1);
+}
+
+// ISR_NOBLOCK, the ISR can be interrupted from here on like the main program
+void mcu_isr_noblock(void)
+{
+	mcu.in_isr = 0;
+	mcu_sei();
+}
+
+void mcu_delay(uint32_t cycles)
+{
+	while (cycles >= MCU_IO_CYCLES) {
+		mcu_tick(MCU_IO_CYCLES);
+		cycles -= MCU_IO_CYCLES;
+	}
+}
+
+// Busy code without I/O accesses, e.g. the blinking loops in pwm.s
+void mcu_burn(uint32_t cycles)
+{
+	mcu_commit();
+	mcu_advance(cycles);
+}
+
+void mcu_wdt_reset(void)
+{
+	mcu.wdt_last = mcu.cycle;
+}
+
+void mcu_wdt_enable(int8_t timeout)
+{
+	mcu.wdt_timeout = timeout;
+	mcu.wdt_last = mcu.cycle;
+}
+
+// *------------------*
+// |   Harness API    |
+// *------------------*
+
+void mcu_reset(uint32_t f_cpu)
+{
+	void (*world_step)(uint32_t) = mcu.world_step;
+	double (*analog)(uint8_t) = mcu.analog;
+	void (*uart_rx)(uint8_t) = mcu.uart_rx;
+	memset(&mcu, 0, sizeof(mcu));
+	mcu.f_cpu = f_cpu;
+	mcu.wdt_timeout = -1;
+	mcu.adc_first = 1;
+	mcu.world_step = world_step;
+	mcu.analog = analog;
+	mcu.uart_rx = uart_rx;
+}
+
+// port: 0 = B, 1 = C, 2 = D
+void mcu_set_pin(uint8_t port, uint8_t pin, uint8_t level)
+{
+	mcu_set_pin_at(port, pin, level, mcu.cycle);
+}
+
+/* Timer1 input capture on ICP1 (PB0) sees the edge at the given cycle, which may be up to one
+step in the past. The noise canceler delays both edges the same, it's left out. ACIC disconnects
+the pin, the comparator drives the capture instead. */
+void mcu_set_pin_at(uint8_t port, uint8_t pin, uint8_t level, uint64_t cycle)
+{
+	uint8_t prev = BIS(mcu.pin_ext[port], pin) != 0;
+	if (level) SBI(mcu.pin_ext[port], pin);
+	else CBI(mcu.pin_ext[port], pin);
+	if (port == 0 && pin == PB0 && level != prev && BIC(mcu.reg[R_ACSR], ACIC)
+		&& level == (BIS(mcu.reg[R_TCCR1B], ICES1) != 0)) {
+		uint16_t pres = mcu_t1_prescalers[mcu.reg[R_TCCR1B] & 7];
+		uint64_t ago = mcu.cycle - cycle;
+		mcu.icr1 = pres? mcu.tcnt1 - (uint16_t)((ago + pres - 1 - mcu.t1_acc) / pres) : mcu.tcnt1;
+		SBI(mcu.reg[R_TIFR], ICF1);
+	}
+}
+
+/* Start a transfer from the master: write wr_len bytes to addr, then after a repeated start
+read rd_len bytes into mcu.twi_rd. Either part can be empty. Returns 0 if the bus is busy.
+mcu.twi_result is MCU_TWI_BUSY until the transfer is complete. */
+uint8_t mcu_twi_transfer(uint32_t scl_hz, uint8_t addr, const uint8_t* wr, uint8_t wr_len, uint8_t rd_len)
+{
+	if (mcu.twi_state != TWI_IDLE || wr_len > MCU_TWI_MAX || rd_len > MCU_TWI_MAX) return 0;
+	memcpy(mcu.twi_wr, wr, wr_len);
+	mcu.twi_addr = addr;
+	mcu.twi_wr_len = wr_len;
+	mcu.twi_rd_len = rd_len;
+	mcu.twi_pos = 0;
+	mcu.twi_bit = mcu.f_cpu / scl_hz;
+	mcu.twi_result = MCU_TWI_BUSY;
+	mcu_twi_next(wr_len? TWI_SLA_W : TWI_SLA_R, 10);		// Start condition and the address
+	return 1;
+}
+
+// Output register value as the hardware sees it, pending firmware writes included.
+uint8_t mcu_port(uint8_t addr)
+{
+	mcu_commit();
+	return mcu.reg[addr];
+}
+
+void mcu_stop(uint8_t reason)
+{
+	mcu.exit_reason = reason;
+	longjmp(mcu.exit, 1);
+}
+
+// Run the firmware until it returns or "seconds" of simulated time have passed.
+uint8_t mcu_run(int (*entry)(void), double seconds)
+{
+	mcu.stop_cycle = mcu.cycle + (uint64_t)(seconds * mcu.f_cpu);
+	if (setjmp(mcu.exit)) {
+		mcu.in_isr = 0;
+		return mcu.exit_reason;
+	}
+	entry();
+	return MCU_EXIT_RETURN;
+}
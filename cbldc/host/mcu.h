@@ -0,0 +1,159 @@
+/*
+ * mcu.h
+ *
+ * Simulated ATmega8 for the host build.
+ *
+ * The firmware is compiled for the host against the headers in this directory, so every I/O
+ * register access from C ends up in mcu_io8()/mcu_io16(). Each access costs MCU_IO_CYCLES
+ * of simulated time. Before the access, the clock is advanced, the timers, analog comparator
+ * and external interrupts are updated, the outside world (motor, RC transmitter...) gets
+ * stepped, and pending interrupts are dispatched to the C ports of the asm ISRs.
+ *
+ * Writes are detected lazily: the caller gets a pointer to a scratch copy of the register
+ * and the scratch is compared against the loaded value on the next access. Writing back the
+ * value that was just read is therefore invisible. For the write-one-to-clear registers
+ * (TIFR, GIFR) a reserved bit reads as 1, so a plain store of the flag mask is always seen.
+ */
+
+
+#ifndef MCU_H_
+#define MCU_H_
+
+#include <stdint.h>
+#include <setjmp.h>
+
+#define MCU_IO_SIZE 64
+#define MCU_VECTORS 19
+
+// Cost of a register access, roughly "in" plus the code around it.
+#define MCU_IO_CYCLES 2
+
+// Interrupt response time, same again for "reti".
+#define MCU_IRQ_CYCLES 4
+
+// Analog channels seen by the comparator / ADC
+#define MCU_AIN0 8
+#define MCU_AIN1 9
+
+// TWI transfer results, see mcu_twi_transfer()
+#define MCU_TWI_BUSY 0
+#define MCU_TWI_OK 1
+#define MCU_TWI_NACK 2
+
+#define MCU_TWI_MAX 8
+
+// Why mcu_run() returned
+#define MCU_EXIT_TIME 0
+#define MCU_EXIT_RETURN 1
+#define MCU_EXIT_WDT 2
+#define MCU_EXIT_BAD_IRQ 3
+#define MCU_EXIT_WORLD 4
+
+typedef struct {
+	uint64_t cycle;							// CPU clock cycles since reset
+	uint64_t stop_cycle;
+	uint32_t f_cpu;
+
+	uint8_t sreg_i;							// Global interrupt enable
+	uint8_t in_isr;
+
+	uint8_t reg[MCU_IO_SIZE];				// Register file
+	uint8_t io8[MCU_IO_SIZE];				// Scratch copies handed out to the firmware
+	uint8_t ld8[MCU_IO_SIZE];				// Scratch values as loaded
+	uint16_t io16[MCU_IO_SIZE];
+	uint16_t ld16[MCU_IO_SIZE];
+
+	uint16_t tcnt1;
+	uint16_t ocr1a;
+	uint16_t ocr1b;
+	uint16_t icr1;
+	uint16_t adc;
+	uint8_t tcnt0;
+	uint8_t tcnt2;
+	uint8_t t2_down;						// Phase correct PWM counting down
+	uint8_t ocr2;							// OCR2 as latched by the phase correct PWM
+	uint8_t oc2;							// OC2 output level, 0 when not connected
+	uint16_t t0_acc;						// Prescaler counters
+	uint16_t t1_acc;
+	uint16_t t2_acc;
+
+	uint8_t pin_ext[3];						// Levels driven from outside on ports B, C, D
+	uint8_t pind_prev;
+	uint8_t aco;
+
+	// ADC conversion in progress while ADSC is set
+	uint8_t adc_first;						// The first one since ADEN was set
+	uint8_t adc_sampled;
+	uint32_t adc_cycles;					// Since ADSC was set
+	double adc_hold;						// Sample and hold voltage
+	double adc_aref;						// AREF left by the last reference, see mcu_adc()
+	uint8_t adc_ref_switched;				// REFS changed since the last conversion
+
+	// TWI master on the bus, byte level. Stops while TWINT is set, like SCL held low by the slave.
+	uint8_t twi_state;
+	uint8_t twi_result;
+	uint8_t twi_addr;
+	uint8_t twi_pos;
+	uint8_t twi_wr_len;
+	uint8_t twi_rd_len;
+	uint8_t twi_wr[MCU_TWI_MAX];
+	uint8_t twi_rd[MCU_TWI_MAX];
+	uint32_t twi_bit;						// SCL period [cycles]
+	uint32_t twi_wait;						// Until the current bus event is complete
+
+	// USART transmitter, 8N1. Any UDR access counts as a write, there's no receiver.
+	uint8_t uart_ubrrh;
+	uint8_t uart_written;
+	uint8_t uart_buf;						// UDR
+	uint8_t uart_buf_full;
+	uint8_t uart_shift;
+	uint8_t uart_shifting;
+	uint32_t uart_wait;						// Until the stop bit is out
+
+	int8_t wdt_timeout;						// WDTO_xx, -1 if disabled
+	uint64_t wdt_last;
+
+	// Statistics
+	uint64_t io_count;
+	uint64_t irq_count[MCU_VECTORS];
+	uint64_t irq_cycles[MCU_VECTORS];
+	uint32_t irq_max_cycles[MCU_VECTORS];
+	uint64_t irq_total;						// All of the above, nested ISRs once
+
+	// The outside world. world_step() is called every time the clock advances,
+	// analog() returns the voltage on ADC0..7, AIN0 and AIN1, uart_rx() gets the
+	// bytes from the USART.
+	void (*world_step)(uint32_t cycles);
+	double (*analog)(uint8_t channel);
+	void (*uart_rx)(uint8_t byte);
+
+	jmp_buf exit;
+	uint8_t exit_reason;
+} mcu_state;
+
+extern mcu_state mcu;
+
+volatile uint8_t* mcu_io8(uint8_t addr);
+volatile uint16_t* mcu_io16(uint8_t addr);
+void mcu_cli(void);
+void mcu_sei(void);
+void mcu_isr_noblock(void);
+void mcu_delay(uint32_t cycles);
+void mcu_burn(uint32_t cycles);
+void mcu_wdt_reset(void);
+void mcu_wdt_enable(int8_t timeout);
+
+void mcu_reset(uint32_t f_cpu);
+void mcu_set_pin(uint8_t port, uint8_t pin, uint8_t level);
+void mcu_set_pin_at(uint8_t port, uint8_t pin, uint8_t level, uint64_t cycle);
+uint8_t mcu_port(uint8_t addr);
+uint8_t mcu_twi_transfer(uint32_t scl_hz, uint8_t addr, const uint8_t* wr, uint8_t wr_len, uint8_t rd_len);
+uint8_t mcu_run(int (*entry)(void), double seconds);
+void mcu_stop(uint8_t reason);
+
+static inline double mcu_time(void)
+{
+	return (double)mcu.cycle / mcu.f_cpu;
+}
+
+#endif /* MCU_H_ */
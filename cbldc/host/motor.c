@@ -0,0 +1,246 @@
+/*
+ * motor.c
+ *
+ * Host build: BLDC motor model, see motor.h.
+ */
+
+#include <math.h>
+#include "mcu.h"
+#include "board.h"
+#include "motor.h"
+
+// Longest integration step [CPU cycles]
+#define MOTOR_MAX_STEP 16
+
+#define SQRT3_2 0.86602540378443864676
+
+// The bus capacitors average the battery current over about this long [s]
+#define MOTOR_BUS_TAU 1e-3
+
+// Where a phase terminal is connected to
+#define CONN_OPEN 0
+#define CONN_VBUS 1
+#define CONN_GND 2
+
+motor_params motor = MOTOR_DEFAULTS;
+
+static double motor_ke;						// Phase back-EMF constant [V s/rad]
+static double motor_w;						// Mechanical speed [rad/s]
+static double motor_theta;					// Electrical angle [rad]
+static double motor_cos;					// cos/sin of motor_theta, advanced by rotation
+static double motor_sin;
+static uint8_t motor_held;
+static double motor_i[3];					// Phase currents, positive into the motor [A]
+static double motor_v[3];					// Terminal voltages [V]
+static uint8_t motor_conn[3];
+static double motor_vs;						// Supply on the bridge [V]
+static double motor_ibat;					// Battery current [A]
+
+void motor_init(void)
+{
+	// Kv is specified line to line: Vll peak = w * 60 / (2 * pi * Kv)
+	motor_ke = 60 / (2 * M_PI * motor.kv) / (2 * SQRT3_2);
+	motor_w = 0;
+	motor_theta = 0;
+	motor_cos = 1;
+	motor_sin = 0;
+	motor_held = 0;
+	motor_vs = motor.vbus;
+	motor_ibat = 0;
+	uint8_t p;
+	for (p = 0; p < 3; p++) {
+		motor_i[p] = 0;
+		motor_v[p] = 0;
+		motor_conn[p] = CONN_OPEN;
+	}
+}
+
+// Spin at constant speed no matter what the bridge does
+void motor_hold(double erpm)
+{
+	motor_w = erpm / 60 * 2 * M_PI / (motor.poles / 2);
+	motor_held = 1;
+}
+
+static void motor_connect(const uint8_t* leg, const double* e, double* v, double* vn)
+{
+	double vmax = motor_vs + motor.vdiode;
+	double vmin = -motor.vdiode;
+	uint8_t n = 0;
+	double sum = 0;
+	uint8_t p;
+	for (p = 0; p < 3; p++) {
+		if (leg[p] == LEG_HIGH) motor_conn[p] = CONN_VBUS;
+		else if (leg[p] != LEG_FLOAT) motor_conn[p] = CONN_GND;
+		else if (motor_i[p] > 0) motor_conn[p] = CONN_GND;			// Low side diode
+		else if (motor_i[p] < 0) motor_conn[p] = CONN_VBUS;			// High side diode
+		else motor_conn[p] = CONN_OPEN;
+	}
+	
+	// A floating terminal pushed past the rails starts conducting through a diode.
+	// One more pass settles it, two phases can't do that at the same time.
+	uint8_t pass;
+	for (pass = 0; pass < 2; pass++) {
+		n = 0;
+		sum = 0;
+		for (p = 0; p < 3; p++) {
+			if (motor_conn[p] == CONN_OPEN) continue;
+			if (leg[p] == LEG_FLOAT) v[p] = motor_conn[p] == CONN_VBUS? vmax : vmin;
+			else v[p] = motor_conn[p] == CONN_VBUS? motor_vs : 0;
+			sum += v[p] - e[p];
+			n++;
+		}
+		*vn = n? sum / n : motor_vs / 2;
+		uint8_t changed = 0;
+		for (p = 0; p < 3; p++) {
+			if (motor_conn[p] != CONN_OPEN) continue;
+			v[p] = *vn + e[p];
+			if (!n) continue;
+			if (v[p] > vmax) {
+				motor_conn[p] = CONN_VBUS;
+				changed = 1;
+			}
+			else if (v[p] < vmin) {
+				motor_conn[p] = CONN_GND;
+				changed = 1;
+			}
+		}
+		if (!changed) break;
+	}
+}
+
+static void motor_substep(const uint8_t* leg, double dt)
+{
+	double sh[3], e[3], vn;
+	uint8_t p;
+	sh[PHASE_R] = motor_cos;
+	sh[PHASE_S] = -motor_cos / 2 + motor_sin * SQRT3_2;
+	sh[PHASE_T] = -motor_cos / 2 - motor_sin * SQRT3_2;
+	for (p = 0; p < 3; p++) e[p] = motor_ke * motor_w * sh[p];
+	
+	// The battery sags through its internal resistance
+	motor_ibat += (motor_bus_current() - motor_ibat) * dt / MOTOR_BUS_TAU;
+	motor_vs = motor.vbus - motor.rbat * motor_ibat;
+	
+	motor_connect(leg, e, motor_v, &vn);
+	
+	// Currents. Diodes stop conducting when their current reaches zero, whatever is left over
+	// goes back to the other phases so that the sum stays zero.
+	double residue = 0;
+	uint8_t n = 0;
+	for (p = 0; p < 3; p++) {
+		if (motor_conn[p] == CONN_OPEN) {
+			motor_i[p] = 0;
+			continue;
+		}
+		double i = motor_i[p] + (motor_v[p] - e[p] - vn - motor.r * motor_i[p]) / motor.l * dt;
+		if (leg[p] == LEG_FLOAT && (motor_conn[p] == CONN_GND? i < 0 : i > 0)) {
+			residue += i;
+			i = 0;
+		}
+		else n++;
+		motor_i[p] = i;
+	}
+	if (n) {
+		for (p = 0; p < 3; p++) {
+			if (motor_conn[p] != CONN_OPEN && (motor_i[p] != 0 || leg[p] != LEG_FLOAT)) {
+				motor_i[p] += residue / n;
+			}
+		}
+	}
+	
+	// Mechanics
+	if (!motor_held) {
+		double torque = motor_ke * (sh[0] * motor_i[0] + sh[1] * motor_i[1] + sh[2] * motor_i[2]);
+		double load = motor.drag * motor_w * fabs(motor_w);
+		if (motor_w > 0) load += motor.friction;
+		else if (motor_w < 0) load -= motor.friction;
+		else if (fabs(torque) <= motor.friction) load = torque;
+		else load = torque > 0? motor.friction : -motor.friction;
+		double w = motor_w + (torque - load) / motor.j * dt;
+		if ((motor_w > 0 && w < 0) || (motor_w < 0 && w > 0)) w = 0;		// Friction doesn't reverse
+		motor_w = w;
+	}
+	
+	// Rotate (cos, sin) by a small angle and keep it on the unit circle
+	double d = motor_w * (motor.poles / 2) * dt;
+	double cd = 1 - d * d / 2;
+	double sd = d - d * d * d / 6;
+	double c = motor_cos * cd - motor_sin * sd;
+	double s = motor_sin * cd + motor_cos * sd;
+	double k = 1.5 - (c * c + s * s) / 2;
+	motor_cos = c * k;
+	motor_sin = s * k;
+	motor_theta += d;
+	if (motor_theta >= 2 * M_PI || motor_theta < 0) {
+		motor_theta = fmod(motor_theta, 2 * M_PI);
+		if (motor_theta < 0) motor_theta += 2 * M_PI;
+		motor_cos = cos(motor_theta);
+		motor_sin = sin(motor_theta);
+	}
+}
+
+void motor_step(uint32_t cycles)
+{
+	uint8_t leg[3];
+	uint8_t p;
+	for (p = 0; p < 3; p++) leg[p] = board_leg(p);
+	while (cycles) {
+		uint32_t n = cycles > MOTOR_MAX_STEP? MOTOR_MAX_STEP : cycles;
+		motor_substep(leg, (double)n / board_f_cpu);
+		cycles -= n;
+	}
+}
+
+// Comparator inputs: phase voltages on ADC channels, virtual neutral (resistor star) on AIN0
+double motor_analog(uint8_t channel)
+{
+	if (channel == MCU_AIN0) {
+		return (motor_v[PHASE_R] + motor_v[PHASE_S] + motor_v[PHASE_T]) / 3;
+	}
+	int8_t phase = board_comp_phase(channel);
+	return phase < 0? 0 : motor_v[phase];
+}
+
+double motor_angle(void)
+{
+	return motor_theta;
+}
+
+double motor_erpm(void)
+{
+	return motor_w * (motor.poles / 2) * 60 / (2 * M_PI);
+}
+
+double motor_current(uint8_t phase)
+{
+	return motor_i[phase];
+}
+
+// Current drawn from the supply, negative when it's fed back
+double motor_bus_current(void)
+{
+	double i = 0;
+	uint8_t p;
+	for (p = 0; p < 3; p++) {
+		if (motor_conn[p] == CONN_VBUS) i += motor_i[p];
+	}
+	return i;
+}
+
+// Battery voltage, on the bridge and on the ESC's voltage divider
+double motor_supply(void)
+{
+	return motor_vs;
+}
+
+// Current through a shunt in the ground return of the bridge, low FETs and diodes
+double motor_ground_current(void)
+{
+	double i = 0;
+	uint8_t p;
+	for (p = 0; p < 3; p++) {
+		if (motor_conn[p] == CONN_GND) i -= motor_i[p];
+	}
+	return i;
+}
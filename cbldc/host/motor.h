@@ -0,0 +1,50 @@
+/*
+ * motor.h
+ *
+ * Host build: three phase star wound BLDC motor on the board's bridge.
+ *
+ * Every step the FET states are read back from the port registers, the phase currents are
+ * integrated through R and L against the sinusoidal back-EMF, and the rotor is accelerated by
+ * the resulting torque against inertia, friction and a propeller-like drag. Legs with both
+ * FETs off conduct through their body diodes as long as current flows, which gives the
+ * demagnetization spikes on the floating phase right after a commutation. The terminal
+ * voltages feed the comparator: phase voltages on the ADC mux channels, and their average
+ * (the resistor star) on AIN0.
+ */
+
+
+#ifndef MOTOR_H_
+#define MOTOR_H_
+
+#include <stdint.h>
+
+typedef struct {
+	double r;						// Phase resistance [Ohm]
+	double l;						// Phase inductance [H]
+	double kv;						// [RPM/V]
+	double poles;					// Magnet poles
+	double j;						// Rotor and load inertia [kg m^2]
+	double friction;				// Constant load torque [Nm]
+	double drag;					// Propeller load, torque = drag * w^2 [Nm s^2]
+	double vbus;					// Supply voltage [V]
+	double vdiode;					// FET body diode forward voltage [V]
+	double rbat;					// Battery internal resistance [Ohm]
+} motor_params;
+
+extern motor_params motor;
+
+// A 2212 class 1000 Kv outrunner with a 10" propeller, on 3S
+#define MOTOR_DEFAULTS {0.08, 15e-6, 1000, 14, 4e-5, 0.005, 2.5e-7, 12, 0.6, 0}
+
+void motor_init(void);
+void motor_hold(double erpm);
+void motor_step(uint32_t cycles);
+double motor_analog(uint8_t channel);
+double motor_angle(void);
+double motor_erpm(void);
+double motor_current(uint8_t phase);
+double motor_bus_current(void);
+double motor_ground_current(void);
+double motor_supply(void);
+
+#endif /* MOTOR_H_ */
@@ -0,0 +1,183 @@
+/*
+ * predbench.c
+ *
+ * Host build: the ZC predictors of predictor.h against each other, open loop.
+ *
+ * Each profile is a sequence of true ZC times (speed against time), measured with a few
+ * ticks of uniform jitter, like the comparator interrupt latency. All three ZC_PREDICTOR
+ * orders are fed the same measurements. For every ZC the estimate is compared to the true
+ * ZC, and the commutation that run() would schedule from it (estimate + period * delay,
+ * TIMING_ADVANCE) to the ideal one. Errors are in electrical degrees, positive is late.
+ *
+ * usage: predbench
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+#define MCU_SFR_ADDRESSES
+#include <avr/io.h>
+#include "../bldc.h"
+
+// The constants of timer.h, its functions need the simulated registers
+#define TIMER_H_
+#define TIMER_PRESCALER 8
+#define TIMER_MAX 32767
+#define TICKS_PER_SECOND (F_CPU/TIMER_PRESCALER)
+
+// The predictor once per order, with the names made unique
+#undef ZC_PREDICTOR
+#define ZC_PREDICTOR 0
+#define _pred _pred0
+#define predictor_init predictor0_init
+#define predictor_period predictor0_period
+#define predictor_update predictor0_update
+#include "../predictor.h"
+#undef PREDICTOR_H_
+#undef ZC_PREDICTOR
+#undef _pred
+#undef predictor_init
+#undef predictor_period
+#undef predictor_update
+
+#define ZC_PREDICTOR 1
+#define _pred _pred1
+#define predictor_init predictor1_init
+#define predictor_period predictor1_period
+#define predictor_update predictor1_update
+#include "../predictor.h"
+#undef PREDICTOR_H_
+#undef ZC_PREDICTOR
+#undef _pred
+#undef predictor_init
+#undef predictor_period
+#undef predictor_update
+
+#define ZC_PREDICTOR 2
+#define _pred _pred2
+#define predictor_init predictor2_init
+#define predictor_period predictor2_period
+#define predictor_update predictor2_update
+#include "../predictor.h"
+
+#define TICKS (F_CPU / 8.0)					// Timer1 at TIMER_PRESCALER 8
+#define JITTER 3							// [ticks] +-
+#define DELAY ((30.0 - TIMING_ADVANCE) / 60)	// ZC to commutation, in commutations
+
+typedef struct {
+	const char* name;
+	double t_end;							// [s]
+	double (*erpm)(double t);
+} profile;
+
+static double p_steady(double t) { return 30000; }
+static double p_ramp(double t) { return 10000 + 50000 * t / 0.3; }
+static double p_spinup(double t) { return 55000 - 50000 * exp(-t / 0.1); }
+static double p_brake(double t) { return 60000 - 45000 * t / 0.3; }
+static double p_wobble(double t) { return 30000 + 6000 * sin(2 * M_PI * 20 * t); }
+
+static const profile profiles[] = {
+	{"steady 30k eRPM", 0.3, p_steady},
+	{"ramp 10k-60k in 0.3 s", 0.3, p_ramp},
+	{"spin-up to 55k, tau 0.1 s", 0.3, p_spinup},
+	{"brake 60k-15k in 0.3 s", 0.3, p_brake},
+	{"30k +-6k at 20 Hz", 0.3, p_wobble},
+};
+
+typedef struct {
+	double n, sum, sum2, max;
+} stats;
+
+static void stats_add(stats* s, double x)
+{
+	s->n++;
+	s->sum += x;
+	s->sum2 += x * x;
+	if (fabs(x) > s->max) s->max = fabs(x);
+}
+
+static void stats_print(const stats* s)
+{
+	double mean = s->sum / s->n;
+	double var = s->sum2 / s->n - mean * mean;
+	printf("  %6.2f %6.2f %6.2f", mean, var > 0? sqrt(var) : 0, s->max);
+}
+
+static uint32_t lcg = 1;
+
+static int jitter()
+{
+	lcg = lcg * 1664525 + 1013904223;
+	return (int)(lcg >> 16) % (2 * JITTER + 1) - JITTER;
+}
+
+static void init(uint8_t order, uint16_t zc, uint16_t period)
+{
+	switch (order) {
+		case 0: predictor0_init(zc, period); break;
+		case 1: predictor1_init(zc, period); break;
+		default: predictor2_init(zc, period); break;
+	}
+}
+
+static uint16_t update(uint8_t order, uint16_t zc, uint16_t* period)
+{
+	switch (order) {
+		case 0: zc = predictor0_update(zc); *period = predictor0_period(); break;
+		case 1: zc = predictor1_update(zc); *period = predictor1_period(); break;
+		default: zc = predictor2_update(zc); *period = predictor2_period(); break;
+	}
+	return zc;
+}
+
+// ZC times of the profile: one every 60 electrical degrees
+static int zc_times(const profile* p, double* zc, int max)
+{
+	double t = 0, angle = 0;
+	const double dt = 1e-6;
+	int n = 0;
+	while (t < p->t_end && n < max) {
+		angle += p->erpm(t) / 60 * 360 * dt;
+		t += dt;
+		if (angle >= 60) {
+			angle -= 60;
+			zc[n++] = t * TICKS;
+		}
+	}
+	return n;
+}
+
+int main(void)
+{
+	static double zc[20000];
+	uint8_t i, order;
+	printf("ZC estimate and commutation error [deg], positive is late, jitter +-%d ticks\n\n", JITTER);
+	printf("%-27s %5s  %-22s  %-22s\n", "profile", "order", "ZC mean  std    max", "com mean  std    max");
+	for (i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+		int n = zc_times(&profiles[i], zc, sizeof(zc) / sizeof(zc[0]));
+		for (order = 0; order < 3; order++) {
+			stats zc_err = {0}, com_err = {0};
+			uint16_t period = zc[1] - zc[0];
+			int k;
+			lcg = 1;
+			init(order, (uint16_t)zc[1], period);
+			for (k = 2; k < n - 1; k++) {
+				double true_period = zc[k] - zc[k - 1];
+				uint16_t measured = (uint16_t)(long)(zc[k] + jitter());
+				uint16_t est = update(order, measured, &period);
+				double e = (int16_t)(est - (uint16_t)(long)zc[k]) - (zc[k] - floor(zc[k]));
+				uint16_t com = est + (uint16_t)(period * DELAY);
+				double ideal = zc[k] + (zc[k + 1] - zc[k]) * DELAY;
+				double c = (int16_t)(com - (uint16_t)(long)ideal) - (ideal - floor(ideal));
+				if (k < 10) continue;		// Settling
+				stats_add(&zc_err, e / true_period * 60);
+				stats_add(&com_err, c / true_period * 60);
+			}
+			printf("%-27s %5d", order? "" : profiles[i].name, order);
+			stats_print(&zc_err);
+			stats_print(&com_err);
+			printf("\n");
+		}
+	}
+	return 0;
+}
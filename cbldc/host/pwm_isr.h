@@ -0,0 +1,200 @@
+/*
+ * pwm_isr.h
+ *
+ * Host build: C port of TIMER2_OC_INT from pwm.s. Keep the two in sync.
+ * mcu_burn() accounts for the instructions that don't touch any I/O register,
+ * so the path lengths roughly match the asm.
+ */
+
+
+#ifndef PWM_ISR_H_
+#define PWM_ISR_H_
+
+// "sub tmp_l, tmp_h; brpl .-4" loop, tmp_h = 3
+static void pwm_blink_wait(uint8_t t)
+{
+	uint8_t n = 0;
+	do {
+		n++;
+		t -= 3;
+	} while (!(t & 0x80));
+	mcu_burn(3 * n - 1);
+}
+
+// PWM_DEAD_DELAY
+static void pwm_dead_delay(int8_t spent)
+{
+	if (_PWM_DEAD_CYCLES - spent > 0) mcu_burn(_PWM_DEAD_CYCLES - spent);
+}
+
+// "sbrc flagsA, PWM_x; xL_on/off" for the three phases
+static void pwm_fets_l(uint8_t on)
+{
+	mcu_burn(5);
+	if (BIS(flagsA, PWM_S)) { if (on) SL_on(); else SL_off(); }
+	if (BIS(flagsA, PWM_R)) { if (on) RL_on(); else RL_off(); }
+	if (BIS(flagsA, PWM_T)) { if (on) TL_on(); else TL_off(); }
+}
+
+static void pwm_fets_h(uint8_t on)
+{
+	mcu_burn(5);
+	if (BIS(flagsA, PWM_S)) { if (on) SH_on(); else SH_off(); }
+	if (BIS(flagsA, PWM_R)) { if (on) RH_on(); else RH_off(); }
+	if (BIS(flagsA, PWM_T)) { if (on) TH_on(); else TH_off(); }
+}
+
+ISR(TIMER2_COMP_vect)
+{
+	mcu_burn(2);
+	if (!(--pwm_tcnt2_h & 0x80)) {					// Extended byte still non-negative
+		mcu_burn(3);
+		return;
+	}
+	
+	if (BIC(flagsA, PWM_STATE)) {
+		
+		// pwm_set_high
+		tmp_l = OCR2 + pwm_high_l;
+		OCR2 = tmp_l;
+		pwm_tcnt2_h = pwm_high_h;
+		tmp_h = TCNT2;
+		mcu_burn(6);
+		if (!(pwm_high_l & 0x80) && ((uint8_t)(tmp_l - tmp_h) & 0x80)) {
+			TIFR = NB(OCF2);
+			pwm_tcnt2_h--;
+			mcu_burn(4);
+		}
+		
+		if (BIS(flagsA, PWM_BLINKING)) {
+			// pwm_blinking_h
+			mcu_burn(6);
+			if (BIS(flagsA, PWM_SYNCHRO)) {
+				// pwm_blink_h_sync
+				pwm_fets_h(0);
+				pwm_dead_delay(6);
+				pwm_fets_l(1);
+				pwm_blink_wait(pwm_low_l);
+				pwm_fets_l(0);
+				pwm_dead_delay(6);
+				pwm_fets_h(1);
+				mcu_burn(1);
+				return;
+			}
+			mcu_burn(2);
+			if (BIS(flagsA, PWM_R)) {
+				RL_on();
+				pwm_blink_wait(pwm_low_l);
+				RL_off();
+			} else if (BIS(flagsA, PWM_T)) {
+				TL_on();
+				pwm_blink_wait(pwm_low_l);
+				TL_off();
+			} else {
+				SL_on();
+				pwm_blink_wait(pwm_low_l);
+				SL_off();
+			}
+			mcu_burn(1);
+			return;
+		}
+		set_flag(flagsA, PWM_STATE);
+		
+		// pwm_set_fets_h
+		mcu_burn(4);
+		if (BIS(flagsA, PWM_SYNCHRO)) {
+			if (BIS(flagsA, PWM_S)) SH_off();
+			if (BIS(flagsA, PWM_R)) RH_off();
+			if (BIS(flagsA, PWM_T)) TH_off();
+			pwm_dead_delay(6);
+		}
+		if (BIS(flagsA, PWM_S)) SL_on();
+		if (BIS(flagsA, PWM_R)) RL_on();
+		if (BIS(flagsA, PWM_T)) TL_on();
+		mcu_burn(5);
+	}
+	else {
+		
+		// pwm_set_low
+		#if ZC_PWM_SAMPLING
+		if (flag_is_set(flagsB, ZC_SAMPLING)) {
+			// pwm_zc_sample
+			uint8_t acsr = ACSR;
+			if (!(acsr & NB(ACO)) != !(acsr & NB(ACIS0))) mcu_burn(7);
+			else if (flag_is_set(flagsB, AWAIT_PRE_ZC)) {
+				clear_flag(flagsB, AWAIT_PRE_ZC);
+				if (BIS(ACSR, ACIS0)) CBI(ACSR, ACIS0);
+				else SBI(ACSR, ACIS0);
+				mcu_burn(13);
+			}
+			else {
+				// pwm_zc_found
+				_zc_sample_time = TCNT1;
+				clear_flag(flagsB, ZC_SAMPLING);
+				mcu_burn(16);
+			}
+		}
+		else mcu_burn(2);
+		#endif
+		tmp_l = OCR2 + pwm_low_l;
+		OCR2 = tmp_l;
+		pwm_tcnt2_h = pwm_low_h;
+		tmp_h = TCNT2;
+		mcu_burn(6);
+		if (!(pwm_low_l & 0x80) && ((uint8_t)(tmp_l - tmp_h) & 0x80)) {
+			TIFR = NB(OCF2);
+			pwm_tcnt2_h--;
+			mcu_burn(4);
+		}
+		
+		if (BIS(flagsA, PWM_BLINKING)) {
+			// pwm_blinking_l
+			mcu_burn(6);
+			if (BIS(flagsA, PWM_SYNCHRO)) {
+				// pwm_blink_l_sync
+				pwm_fets_l(0);
+				pwm_dead_delay(6);
+				pwm_fets_h(1);
+				pwm_blink_wait(pwm_high_l);
+				pwm_fets_h(0);
+				pwm_dead_delay(6);
+				pwm_fets_l(1);
+				mcu_burn(1);
+				return;
+			}
+			mcu_burn(2);
+			if (BIS(flagsA, PWM_R)) {
+				RL_off();
+				pwm_blink_wait(pwm_high_l);
+				RL_on();
+			} else if (BIS(flagsA, PWM_T)) {
+				TL_off();
+				pwm_blink_wait(pwm_high_l);
+				TL_on();
+			} else {
+				SL_off();
+				pwm_blink_wait(pwm_high_l);
+				SL_on();
+			}
+			mcu_burn(1);
+			return;
+		}
+		clear_flag(flagsA, PWM_STATE);
+		
+		// pwm_set_fets_l
+		mcu_burn(3);
+		if (BIS(flagsA, PWM_S)) SL_off();
+		if (BIS(flagsA, PWM_R)) RL_off();
+		if (BIS(flagsA, PWM_T)) TL_off();
+		mcu_wdt_reset();
+		mcu_burn(2);
+		if (BIS(flagsA, PWM_SYNCHRO)) {
+			pwm_dead_delay(10);
+			if (BIS(flagsA, PWM_S)) SH_on();
+			if (BIS(flagsA, PWM_R)) RH_on();
+			if (BIS(flagsA, PWM_T)) TH_on();
+		}
+	}
+}
+
+#endif /* PWM_ISR_H_ */
@@ -0,0 +1,204 @@
+/*
+ * signal_isr.h
+ *
+ * Host build: C port of the input signal ISRs from signal.s. Keep the two in sync.
+ */
+
+
+#ifndef SIGNAL_ISR_H_
+#define SIGNAL_ISR_H_
+
+#if INPUT_SIGNAL_TYPE == 1
+
+#if RC_PWM_CHANNEL == 0
+ISR(INT0_vect)
+#else
+ISR(INT1_vect)
+#endif
+{
+#if RC_PWM_PROTOCOL == RCP_SERVO
+	mcu_burn(1);
+	if (BIC(RC_PWM_PIN, RC_PWM_P)) {
+		
+		// rcp_falling
+		rcp_pulse_len = TCNT1 - rcp_rise_time;
+		set_flag(flagsB, RCP_RECEIVED);
+		mcu_burn(9);
+	}
+	else {
+		
+		// rcp_rising
+		rcp_rise_time = TCNT1;
+		mcu_burn(5);
+	}
+#else
+	uint8_t t0 = TCNT0;
+	uint16_t t1 = TCNT1;
+	uint8_t frac = t0 - (uint8_t)(t1 << 3);
+	mcu_burn(1);
+	if (BIC(RC_PWM_PIN, RC_PWM_P)) {
+		
+		// rcp_falling
+		rcp_pulse_len = t1 - rcp_rise_time;
+		rcp_pulse_frac = frac - rcp_rise_frac;
+		set_flag(flagsB, RCP_RECEIVED);
+		mcu_burn(22);
+	}
+	else {
+		
+		// rcp_rising
+		rcp_rise_time = t1;
+		rcp_rise_frac = frac;
+		mcu_burn(8);
+	}
+#endif
+}
+
+#elif INPUT_SIGNAL_TYPE == 2
+
+ISR(TWI_vect)
+{
+	uint8_t status = TWSR & 0xF8;
+	mcu_burn(2);
+	switch (status) {
+		case I2C_SR_DATA_ACK: {
+			uint8_t data = TWDR;
+			mcu_burn(2);
+			if (i2c_idx < 2) {
+				i2c_rx[i2c_idx++] = data;
+				mcu_burn(9);
+			}
+			else mcu_burn(3);
+			break;
+		}
+		case I2C_ST_DATA_ACK:
+			mcu_burn(6);
+			TWDR = i2c_tx[0];
+			i2c_tx[0] = i2c_tx[1];
+			i2c_tx[1] = i2c_tx[2];
+			i2c_tx[2] = 0xFF;
+			mcu_burn(9);
+			break;
+		case I2C_SR_SLA_ACK:
+			i2c_idx = 0;
+			i2c_rx[1] = 0;
+			mcu_burn(10);
+			break;
+		case I2C_ST_SLA_ACK:
+			mcu_burn(12);
+			TWDR = motor_status;
+			i2c_tx[0] = motor_faults;
+			motor_faults = 0;
+			i2c_tx[1] = motor_rps >> 8;
+			i2c_tx[2] = motor_rps;
+			mcu_burn(11);
+			break;
+		case I2C_SR_STOP:
+			if (i2c_idx) {
+				i2c_cmd[0] = i2c_rx[0];
+				i2c_cmd[1] = i2c_rx[1];
+				i2c_idx = 0;
+				set_flag(flagsB, RCP_RECEIVED);
+				mcu_burn(25);
+			}
+			else mcu_burn(12);
+			break;
+		case I2C_BUS_ERROR:
+			mcu_burn(9);
+			TWCR = I2C_TWCR_ACK | NB(TWSTO);
+			mcu_burn(7);
+			return;
+		default:
+			mcu_burn(8);
+	}
+	TWCR = I2C_TWCR_ACK;
+	mcu_burn(7);
+}
+
+#elif INPUT_SIGNAL_TYPE == 3
+
+// The line went back to its idle level, low unless it's inverted for telemetry
+#if DSHOT_TELEMETRY
+	#define dshot_pulse_over() BIS(DSHOT_PIN, DSHOT_P)
+#else
+	#define dshot_pulse_over() BIC(DSHOT_PIN, DSHOT_P)
+#endif
+
+static void dshot_wait_rising()
+{
+	clear_flag(flagsA, DSHOT_FRAME);
+	TCCR1B = DSHOT_TCCR1B_RISING;
+	TIFR = NB(ICF1);
+}
+
+ISR(TIMER1_CAPT_vect)
+{
+	uint16_t icr = ICR1;
+	if (flag_is_set(flagsA, DSHOT_FRAME)) {
+		
+		// dshot_falling
+		uint8_t d = (uint8_t)icr - (uint8_t)dshot_last;
+		uint16_t data = dshot_data;
+		dshot_last = icr;
+		if (!(data & 1)) d += DSHOT_PREV_1;
+		mcu_burn(24);
+		if (d >= DSHOT_D_MAX) {
+			dshot_wait_rising();
+			return;
+		}
+		uint8_t done = data >> 15;
+		data = data << 1 | (d < DSHOT_THRESHOLD);
+		if (done) {
+			dshot_frame = data;
+			set_flag(flagsB, RCP_RECEIVED);
+			mcu_burn(9);
+			dshot_wait_rising();
+			return;
+		}
+		dshot_data = data;
+		mcu_burn(6);
+	}
+	else {
+		
+		// dshot_rising
+		mcu_burn(1);
+		TCCR1B = DSHOT_TCCR1B_FALLING;
+		TIFR = NB(ICF1);
+		mcu_burn(3);
+		uint8_t now = TCNT1L;
+		uint8_t missed = 0;
+		if (dshot_pulse_over() && !(TIFR & NB(ICF1))) {
+			// The falling edge of bit 0 is lost, it was a 0 if that's early enough
+			mcu_burn(2);
+			if ((uint8_t)(now - (uint8_t)icr) >= DSHOT_H_MAX) {
+				dshot_last = icr;
+				mcu_burn(13);
+				dshot_wait_rising();
+				return;
+			}
+			mcu_burn(6);
+			missed = 1;
+		}
+		uint16_t last = dshot_last;
+		dshot_last = icr;
+		mcu_burn(21);
+		if ((uint16_t)(icr - last) < DSHOT_IDLE) {
+			dshot_wait_rising();
+			return;
+		}
+		if (missed) {
+			dshot_last = (icr & 0xFF00) | (uint8_t)(icr + DSHOT_PREV_1);
+			dshot_data = 3;
+		}
+		else {
+			dshot_last = (icr & 0xFF00) | (uint8_t)(icr - DSHOT_FIRST);
+			dshot_data = 1;
+		}
+		set_flag(flagsA, DSHOT_FRAME);
+		mcu_burn(14);
+	}
+}
+
+#endif
+
+#endif /* SIGNAL_ISR_H_ */
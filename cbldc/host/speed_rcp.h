@@ -0,0 +1,38 @@
+/*
+ * speed_rcp.h
+ *
+ * Host build: C port of speed_reciprocal() in speed.s, bit-exact. speedbench runs both.
+ */
+
+#ifndef SPEED_RCP_H_
+#define SPEED_RCP_H_
+
+static uint16_t _rcp_mul_hi16(uint16_t a, uint16_t b)
+{
+	return ((uint32_t)a * b) >> 16;
+}
+
+uint16_t speed_reciprocal(uint16_t t)
+{
+	if (t < _SPEED_RCP_T_MIN) return 0xFFFF;
+	uint8_t shift = 16 - _SPEED_RCP_SHIFT;
+	uint16_t m = t;
+	while (!(m & 0x8000)) {
+		m <<= 1;
+		shift--;
+	}
+
+	int32_t seed = _SPEED_RCP_SEED - (uint16_t)(m << 1);
+	uint16_t y = seed < 0? 0 : seed;
+	uint8_t i;
+	for (i = 0; i < 3; i++) {
+		uint16_t e = -(m + _rcp_mul_hi16(m, y));
+		y += e + _rcp_mul_hi16(y, e);
+	}
+
+	uint32_t p = _SPEED_RCP_K + _rcp_mul_hi16(_SPEED_RCP_K, y);
+	if (shift) p = ((p >> (shift - 1)) + 1) >> 1;
+	return p > 0xFFFF? 0xFFFF : p;
+}
+
+#endif /* SPEED_RCP_H_ */
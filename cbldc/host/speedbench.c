@@ -0,0 +1,198 @@
+/*
+ * speedbench.c
+ *
+ * Host build: accuracy, flash size and cycles of the two com_time_to_rps() of speed.h.
+ *
+ * The lookup tables of the configured board (F_CPU, TIMER_PRESCALER, SPEED_LUT_SPLIT and
+ * SPEED_LUT_STEP) and the Newton-Raphson reciprocal of speed.s are compared to the exact
+ * TICKS_PER_SECOND / 6 / t for every commutation time t, separately for the direct and the
+ * interpolated range of the tables and the slower times they clamp. The tables come from a model
+ * of the same integer maths, checked against the firmware when SPEED_RECIPROCAL is 0. The asm
+ * reciprocal runs in the avrasm interpreter for every t, which counts its cycles and checks it
+ * against the C port of host/speed_rcp.h. The model then gives the flash size and error of other
+ * splits and steps at this F_CPU, or another one, to tune the tables per board.
+ *
+ * usage: speedbench [-f F_CPU] speed.i
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "../bldc.h"
+#include "../timer.h"
+#include "../tools/arithmetic.h"
+#define GLOBALS_H_							// speed.h needs nothing else of it
+#include "../speed.h"
+#include "speed_rcp.h"
+#include "avrasm.h"
+
+#ifndef _SPEED_LUT_END
+#define _SPEED_LUT_END 32768						// speed.h leaves the tables out with SPEED_RECIPROCAL
+#endif
+
+/* Errors in rps, the unit of the result: even the exact speed rounded is 0.5 off at worst.
+The relative error only counts from RPS_REL_MIN up, below it that rounding dominates. */
+#define RPS_REL_MIN 100
+
+// Cycles of the table lookup, for comparison. It's C, so they are estimated, not measured: the
+// range check, the index and a word read (lpm) directly, the call of com_time_to_rps_low(), the
+// index maths, two word reads and mul16_frac8_sum_mul16_frac8 (19 cycles) interpolated.
+#define LUT_CYCLES_DIRECT 16
+#define LUT_CYCLES_INTERPOLATED 70
+
+typedef struct {
+	double max;								// [rps]
+	double sum;
+	double max_rel;							// [%]
+	long n;
+	uint16_t worst_t;
+} stats;
+
+static void stats_add(stats* s, uint32_t ticks, uint16_t t, uint16_t rps)
+{
+	double exact = ticks / 6.0 / t;
+	double e = fabs(rps - exact);
+	if (e > s->max) {
+		s->max = e;
+		s->worst_t = t;
+	}
+	if (exact >= RPS_REL_MIN && e / exact * 100 > s->max_rel) s->max_rel = e / exact * 100;
+	s->sum += e;
+	s->n++;
+}
+
+// com_time_to_rps() for any split and step, the same integer maths as speed.h
+static uint16_t model_entry(uint32_t num, uint32_t t)
+{
+	uint32_t v = (num + 3 * t) / (6 * t);
+	return v > 65535? 65535 : v;
+}
+
+static uint16_t model(uint16_t t, uint32_t ticks, uint16_t split, uint16_t step)
+{
+	if (t < split) return t? model_entry(ticks, t) : 65535;
+	if (t >= _SPEED_LUT_END) return ticks / 6 / _SPEED_LUT_END;
+	uint32_t num = ticks * (256UL / step);
+	uint16_t i = (t - split) / step;
+	uint8_t r = (t - split) % step;
+	uint16_t L = model_entry(num, split + (uint32_t)i * step);
+	uint16_t R = model_entry(num, split + (uint32_t)(i + 1) * step);
+	return mul16_frac8_sum_mul16_frac8(L, step - r, R, r);
+}
+
+// First commutation time of which the speed fits 16 bits
+static uint16_t first_t(uint32_t ticks)
+{
+	uint16_t t = 1;
+	while (ticks / 6.0 / t > 65535) t++;
+	return t;
+}
+
+// Flash of the two tables
+static uint16_t table_bytes(uint16_t split, uint16_t step)
+{
+	return 2 * (split + (_SPEED_LUT_END - split) / step + 1);
+}
+
+static void print_range(const char* method, const char* range, uint16_t from, uint16_t to, const stats* s)
+{
+	printf("%-11s %-13s %6u..%-6u %10.2f %10.3f %8u %8.3f\n", method, range, from, to,
+		s->max, s->sum / s->n, s->worst_t, s->max_rel);
+}
+
+int main(int argc, char** argv)
+{
+	stats lut[3] = {{0}}, rcp[3] = {{0}};
+	uint32_t ticks = TICKS_PER_SECOND;
+	const char* asm_file = 0;
+	long cycles_min = 0, cycles_max = 0;
+	double cycles_sum = 0;
+	uint32_t t;
+	int i, fail = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-f") && i + 1 < argc) ticks = strtoul(argv[++i], 0, 10) / TIMER_PRESCALER;
+		else if (argv[i][0] != '-' && !asm_file) asm_file = argv[i];
+		else break;
+	}
+	if (i != argc || !asm_file) {
+		fprintf(stderr, "usage: %s [-f F_CPU] speed.i\n", argv[0]);
+		return 2;
+	}
+	if (avrasm_load(asm_file)) return 1;
+
+	printf("F_CPU %lu, TIMER_PRESCALER %d, SPEED_LUT_SPLIT %d, SPEED_LUT_STEP %d, SPEED_RECIPROCAL %d\n",
+		(unsigned long)F_CPU, TIMER_PRESCALER, SPEED_LUT_SPLIT, SPEED_LUT_STEP, SPEED_RECIPROCAL);
+	printf("flash: tables %u bytes, speed_reciprocal %d bytes\n\n",
+		table_bytes(SPEED_LUT_SPLIT, SPEED_LUT_STEP), 2 * avrasm_words());
+
+	for (t = 0; t <= 0xFFFF; t++) {
+		uint16_t tables = model(t, TICKS_PER_SECOND, SPEED_LUT_SPLIT, SPEED_LUT_STEP);
+		#if !SPEED_RECIPROCAL
+		if (com_time_to_rps(t) != tables) {
+			if (!fail) fprintf(stderr, "model differs from com_time_to_rps(%u)\n", t);
+			fail = 1;
+		}
+		#endif
+
+		avrasm_cpu cpu;
+		memset(&cpu, 0, sizeof(cpu));
+		cpu.r[24] = t;
+		cpu.r[25] = t >> 8;
+		long cycles = avrasm_call(&cpu, "speed_reciprocal");
+		uint16_t reciprocal = cpu.r[24] | cpu.r[25] << 8;
+		if (cycles < 0) return 1;
+		if (reciprocal != speed_reciprocal(t) || cpu.r[1]) {
+			if (!fail) fprintf(stderr, "speed.s differs from speed_rcp.h at %u: %u, %u\n", t, reciprocal, speed_reciprocal(t));
+			fail = 1;
+		}
+		if (!t || cycles < cycles_min) cycles_min = cycles;
+		if (cycles > cycles_max) cycles_max = cycles;
+		cycles_sum += cycles;
+
+		if (t < first_t(TICKS_PER_SECOND)) {
+			if (reciprocal != 65535) {
+				if (!fail) fprintf(stderr, "speed_reciprocal(%u) doesn't saturate\n", t);
+				fail = 1;
+			}
+			continue;
+		}
+		int range = t < SPEED_LUT_SPLIT? 0 : t < _SPEED_LUT_END? 1 : 2;
+		stats_add(&lut[range], TICKS_PER_SECOND, t, tables);
+		stats_add(&rcp[range], TICKS_PER_SECOND, t, reciprocal);
+	}
+
+	printf("error against TICKS_PER_SECOND / 6 / t, relative from %d rps up\n", RPS_REL_MIN);
+	printf("%-11s %-13s %13s %10s %10s %8s %8s\n", "", "range", "com time", "max [rps]", "mean [rps]", "at", "max [%]");
+	const char* names[3] = {"direct", "interpolated", "clamped"};
+	uint16_t from[3] = {first_t(TICKS_PER_SECOND), SPEED_LUT_SPLIT, _SPEED_LUT_END};
+	uint16_t to[3] = {SPEED_LUT_SPLIT - 1, _SPEED_LUT_END - 1, 65535};
+	for (i = 0; i < 3; i++) print_range("tables", names[i], from[i], to[i], &lut[i]);
+	for (i = 0; i < 3; i++) print_range("reciprocal", names[i], from[i], to[i], &rcp[i]);
+	printf("(commutation time %u ticks is %.0f eRPM)\n\n", SPEED_LUT_SPLIT, TICKS_PER_SECOND * 10.0 / SPEED_LUT_SPLIT);
+
+	printf("cycles, first instruction to ret, the call not included\n");
+	printf("tables      about %d direct, %d interpolated (estimated, C)\n", LUT_CYCLES_DIRECT, LUT_CYCLES_INTERPOLATED);
+	printf("reciprocal  %ld..%ld, mean %.1f, %.1f us at most\n\n", cycles_min, cycles_max,
+		cycles_sum / 65536, cycles_max * 1e6 / F_CPU);
+
+	// Other table layouts at this F_CPU, or the one given
+	printf("F_CPU %lu\n", (unsigned long)ticks * TIMER_PRESCALER);
+	printf("%6s %6s %7s %10s %10s %8s\n", "split", "step", "bytes", "max [rps]", "mean [rps]", "max [%]");
+	uint16_t split, step;
+	for (split = 128; split < 1024; split *= 2) {
+		for (step = 16; step <= 128 && step <= split; step *= 2) {
+			uint16_t points = (_SPEED_LUT_END - split) / step + 1;
+			stats s = {0};
+			if (points >= 1024) continue;
+			for (t = first_t(ticks); t < _SPEED_LUT_END; t++) stats_add(&s, ticks, t, model(t, ticks, split, step));
+			printf("%6u %6u %7u %10.2f %10.3f %8.3f%s\n", split, step, table_bytes(split, step),
+				s.max, s.sum / s.n, s.max_rel, ticks == TICKS_PER_SECOND && split == SPEED_LUT_SPLIT && step == SPEED_LUT_STEP? "  <-" : "");
+		}
+	}
+	return fail;
+}
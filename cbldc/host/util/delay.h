@@ -0,0 +1,16 @@
+/*
+ * delay.h
+ *
+ * Host build replacement of <util/delay.h>. Delays burn simulated cycles.
+ */
+
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+#include <avr/io.h>
+
+#define _delay_us(us) mcu_delay((uint32_t)((us) * (F_CPU / 1000000.0)))
+#define _delay_ms(ms) mcu_delay((uint32_t)((ms) * (F_CPU / 1000.0)))
+
+#endif /* HOST_UTIL_DELAY_H_ */
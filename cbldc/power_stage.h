@@ -257,6 +257,17 @@ inline void power_stage_init()
 	TL_off();
 }
 
+// All FETs off, the phases float. The PWM must be at 0 already.
+inline void power_stage_off()
+{
+	RH_off();
+	SH_off();
+	TH_off();
+	RL_off();
+	SL_off();
+	TL_off();
+}
+
 #endif /* !ASSEMBLER */
 
 #endif /* POWER_STAGE_H_ */
\ No newline at end of file
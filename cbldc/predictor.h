@@ -0,0 +1,108 @@
+/*
+ * predictor.h
+ *
+ * ZC time and commutation period estimation for run(), see ZC_PREDICTOR in bldc.h.
+ *
+ *  0  The two tap IIR: period = (period + measured period) / 2, ZC = previous ZC + period.
+ *  1  PLL with a first order loop filter. The error of the measured ZC against the predicted
+ *     one moves the ZC by ZC_PLL_KP and the period by ZC_PLL_KI. No lag at a constant speed.
+ *  2  PLL with a second order loop filter, an acceleration term corrected by ZC_PLL_KA as well.
+ *     No lag at a constant acceleration.
+ *
+ * Gains are in 1/256. Period and acceleration are int24_t with 8 fraction bits, so small
+ * corrections accumulate instead of being rounded away. No branches besides the clamps. The error
+ * one keeps a late ZC (after a timeout) from throwing the loop off. The period stays within
+ * _PRED_PERIOD_MIN.._PRED_PERIOD_MAX and the acceleration within a quarter of it per commutation,
+ * so a run of bad ZCs can't wind them up past what the timer and run() handle.
+ */
+
+
+#ifndef PREDICTOR_H_
+#define PREDICTOR_H_
+
+#include <avr/io.h>
+#include "bldc.h"
+#include "timer.h"
+#include "tools/arithmetic.h"
+
+#if ZC_PREDICTOR < 0 || ZC_PREDICTOR > 2
+	#error Invalid constant: ZC_PREDICTOR. 0, 1 or 2 allowed.
+#endif
+
+// Period window [ticks]: twice RPM_MAX, and half the Timer1 range for the ZC timeout of run()
+#define _PRED_PERIOD_MIN ((int16_t)(10UL * TICKS_PER_SECOND / RPM_MAX / 2))
+#define _PRED_PERIOD_MAX (TIMER_MAX / 2)
+
+struct {
+	uint16_t zc;								// Estimated time of the last ZC
+	int24_t period;								// [ticks / 256]
+	#if ZC_PREDICTOR == 2
+	int24_t accel;								// [ticks / 256] per commutation
+	#endif
+} _pred;
+
+static void predictor_init(uint16_t zc, uint16_t period)
+{
+	_pred.zc = zc;
+	_pred.period.l_hx.l = 0;
+	_pred.period.l_hx.hx = period;
+	#if ZC_PREDICTOR == 2
+	_pred.accel.l_hx.l = 0;
+	_pred.accel.l_hx.hx = 0;
+	#endif
+}
+
+// Predicted time between the last ZC and the next one
+inline uint16_t predictor_period()
+{
+	return _pred.period.l_hx.hx;
+}
+
+// A ZC has been measured at zc_time. Returns the estimated time of that ZC.
+static uint16_t predictor_update(uint16_t zc_time)
+{
+	#if ZC_PREDICTOR == 0
+
+	uint16_t period = _pred.period.l_hx.hx;
+	uint16_t delta = zc_time - _pred.zc;
+	period += delta;
+	period /= 2;
+	_pred.period.l_hx.hx = period;
+	_pred.zc += period;
+
+	#else
+
+	uint16_t predicted = _pred.zc + _pred.period.l_hx.hx;
+	int16_t e = zc_time - predicted;
+	int16_t e_max = (uint16_t)_pred.period.l_hx.hx >> 2;
+	if (e > e_max) e = e_max;
+	if (e < -e_max) e = -e_max;
+	_pred.zc = predicted + mulsu_16_frac8(e, ZC_PLL_KP);
+	_pred.period = add24_mulsu_16_frac8(_pred.period, e, ZC_PLL_KI);
+	#if ZC_PREDICTOR == 2
+	_pred.accel = add24_mulsu_16_frac8(_pred.accel, e, ZC_PLL_KA);
+	int16_t a_max = (uint16_t)_pred.period.l_hx.hx >> 2;
+	if (_pred.accel.l_hx.hx >= a_max) {
+		_pred.accel.l_hx.l = 0;
+		_pred.accel.l_hx.hx = a_max;
+	}
+	if (_pred.accel.l_hx.hx < -a_max) {
+		_pred.accel.l_hx.l = 0;
+		_pred.accel.l_hx.hx = -a_max;
+	}
+	_pred.period = add24_24(_pred.period, _pred.accel);
+	#endif
+	if (_pred.period.l_hx.hx < _PRED_PERIOD_MIN) {
+		_pred.period.l_hx.l = 0;
+		_pred.period.l_hx.hx = _PRED_PERIOD_MIN;
+	}
+	if (_pred.period.l_hx.hx >= _PRED_PERIOD_MAX) {
+		_pred.period.l_hx.l = 0;
+		_pred.period.l_hx.hx = _PRED_PERIOD_MAX;
+	}
+
+	#endif
+	return _pred.zc;
+}
+
+#endif /* PREDICTOR_H_ */
@@ -18,6 +18,8 @@
  * which causes power "bumps" around max and zero throttle.
  * In blinking mode, we use a single interrupt for generation of one PWM state.
  * We just switch the FETs, wait some time in the loop and switch them again.
+ * Synchronous (complementary) PWM turns the high FET of the PWM phase on in the low state,
+ * in the normal and both blinking modes, with PWM_DEAD_TIME of the board between the two FETs.
 */ 
 
 
@@ -28,15 +30,27 @@
 #include "power_stage.h"
 #include "globals.h"
 
-#ifdef __ASSEMBLER__
-
+// Dead time of synchronous PWM in CPU cycles, padded at compile time (PWM_DEAD_DELAY in pwm.s)
 #define _PWM_DEAD_CYCLES (F_CPU / 1000 * PWM_DEAD_TIME / 1000000)
 
+#ifdef __ASSEMBLER__
+
 .extern CONST_3
 
 #else
 
-#define _PWM_INT_EXEC_TIME 40
+#include <util/delay.h>
+
+// Longest non-blinking TIMER2_OC_INT path including the interrupt entry, in CPU cycles.
+// Measured by "make bench" in host/, which fails if this gets lower than the real thing.
+// The synchronous PWM paths pad the dead time, the part of it over _PWM_DEAD_FREE_CYCLES adds up.
+// The comparator sample of ZC_PWM_SAMPLING at the end of the on-time adds _PWM_ZC_SAMPLE_TIME.
+#define _PWM_INT_BASE_TIME 52
+#define _PWM_DEAD_FREE_CYCLES 9
+#define _PWM_ZC_SAMPLE_TIME 11
+#define _PWM_INT_EXEC_TIME (_PWM_INT_BASE_TIME \
+	+ (_PWM_DEAD_CYCLES > _PWM_DEAD_FREE_CYCLES? _PWM_DEAD_CYCLES - _PWM_DEAD_FREE_CYCLES : 0) \
+	+ (ZC_PWM_SAMPLING? _PWM_ZC_SAMPLE_TIME : 0))
 
 const uint8_t CONST_3 = 3;
 
@@ -48,11 +62,80 @@ inline uint16_t pwm_get_top()
 	return _pwm_top;
 }
 
+// Waits the dead time, between turning one FET off and the other one on in a bridge
+inline void pwm_dead_time()
+{
+	_delay_us(PWM_DEAD_TIME * 0.001);
+}
+
+#if PWM_HARDWARE
+
+// Timer2 in phase correct mode counts 0..255..0 (PWM_HW_PERIOD prescaled clocks),
+// the OC2 output stays high for 2*OCR2 of them.
+uint8_t _pwm_shift;		// duty (CPU cycles) -> OCR2
+
+void pwm_set_top(uint16_t top)
+{
+	// Only the prescaler is adjustable, take the one giving the period closest to top.
+	// It's needed for the beeps, the motor always runs at PWM_HW_PERIOD.
+	static const uint8_t prescaler_log2[] = {0, 3, 5, 6, 7};
+	uint8_t cs = 1;
+	while (cs < sizeof(prescaler_log2) && ((uint32_t)PWM_HW_PERIOD << prescaler_log2[cs]) <= 3UL*top/2) cs++;
+	_pwm_top = top;
+	_pwm_shift = 1 + prescaler_log2[cs-1];
+	TCCR2 = (1<<WGM20)|(1<<COM21)|cs;	// timer2: phase correct PWM, non-inverted OC2
+}
+
+void pwm_set(uint16_t duty)
+{
+	uint16_t ocr = duty >> _pwm_shift;
+	_pwm_val = duty;
+	if (duty >= pwm_get_top() || ocr > 255) ocr = 255;	// OCR2 = 255 keeps OC2 high
+	OCR2 = ocr;											// Double buffered, takes effect at the top
+}
+
+static void pwm_init()
+{
+	OCR2 = 0;
+	SBI(DDRB, PB3);										// OC2 output
+	pwm_set_top(pwm_range);
+	pwm_set(0);
+	// The gate takes care of the PWM state, the low MOSFET pins just follow the commutation.
+	// Synchronous rectification needs a complementary output, there's none here.
+	set_flag(flagsA, PWM_STATE);
+	clear_flags(flagsA, PWM_BLINKING, PWM_SYNCHRO);
+}
+
+#else
+
 inline void pwm_set_top(uint16_t top)
 {
 	_pwm_top = top;
 }
 
+// Ends synchronous PWM: the high FET of the PWM phase goes off, then the dead time passes
+// before a low FET may go on. Called with interrupts disabled.
+static void _pwm_synchro_stop()
+{
+	if (flag_is_set(flagsA, PWM_SYNCHRO)) {
+		clear_flag(flagsA, PWM_SYNCHRO);
+		if (flag_is_set(flagsA, PWM_S))
+			SH_off();
+		if (flag_is_set(flagsA, PWM_R))
+			RH_off();
+		if (flag_is_set(flagsA, PWM_T))
+			TH_off();
+		pwm_dead_time();
+	}
+}
+
+// Synchronous PWM runs in the blinking and normal modes, if it's configured
+inline void _pwm_synchro_start()
+{
+	if (BIS(cfg.flags, CFG_SYNCHRO_PWM)) set_flag(flagsA, PWM_SYNCHRO);
+	else _pwm_synchro_stop();
+}
+
 void pwm_set(uint16_t duty)
 {
 	uint16_t hi, lo;
@@ -67,6 +150,8 @@ void pwm_set(uint16_t duty)
 		if (lo == 0) {
 			// Max power, PWM off
 			CBI(TIMSK, OCIE2);							// Disable the PWM generator
+			cli();
+			_pwm_synchro_stop();						// There's no off-state to rectify
 			set_flag(flagsA, PWM_STATE);
 			if (flag_is_set(flagsA, PWM_S))				// Set low state on FETs
 				SL_on();
@@ -74,9 +159,11 @@ void pwm_set(uint16_t duty)
 				RL_on();
 			if (flag_is_set(flagsA, PWM_T))
 				TL_on();
+			sei();
 		} else {
 			// Low-state-blinking mode
 			cli();
+			_pwm_synchro_start();
 			set_flags(flagsA, PWM_BLINKING, PWM_STATE);
 			pwm_low_l = (uint8_t)(pwm_get_top());		// Set full cycle time as duty
 			pwm_low_h = (uint8_t)(pwm_get_top()>>8);
@@ -90,13 +177,17 @@ void pwm_set(uint16_t duty)
 		// Zero power, PWM off
 		if (hi == 0) {
 			CBI(TIMSK, OCIE2);							// Disable the PWM generator
+			cli();
+			_pwm_synchro_stop();						// The motor coasts
 			clear_flag(flagsA, PWM_STATE);
 			SL_off();									// Set low state on FETs
 			RL_off();
 			TL_off();
+			sei();
 		} else {
 			// High-state-blinking mode
 			cli();
+			_pwm_synchro_start();
 			set_flag(flagsA, PWM_BLINKING);
 			clear_flag(flagsA, PWM_STATE);
 			pwm_high_l = (uint8_t)(pwm_get_top());		// Set full cycle time as duty
@@ -110,6 +201,7 @@ void pwm_set(uint16_t duty)
 	// Normal PWM mode. There are separate interrupts for low and high states.
 	else {
 		cli();
+		_pwm_synchro_start();
 		clear_flag(flagsA, PWM_BLINKING);
 		pwm_low_l = (uint8_t)(lo);						// Set low and high state times
 		pwm_low_h = (uint8_t)(lo>>8);
@@ -123,13 +215,14 @@ void pwm_set(uint16_t duty)
 static void pwm_init()
 {
 	OCR2 = 255;
+	clear_flag(flagsA, PWM_SYNCHRO);					// pwm_set() starts it with the PWM
 	pwm_set_top(pwm_range);
 	pwm_set(0);
-	clear_flag(flagsA, PWM_SYNCHRO);
-	if (BIS(cfg.flags, CFG_SYNCHRO_PWM)) set_flag(flagsA, PWM_SYNCHRO);
 	TCCR2 = (1<<CS20);	// timer2: prescaler 0
 }
 
+#endif /* PWM_HARDWARE */
+
 inline uint16_t pwm_get()
 {
 	return _pwm_val;
@@ -139,6 +232,8 @@ inline void SL_pwm()
 {
 	if (flag_is_set(flagsA, PWM_STATE)) {
 		SL_on();
+	} else if (flag_is_set(flagsA, PWM_SYNCHRO)) {
+		SH_on();								// The new PWM phase was off, no dead time needed
 	}	
 	set_flag(flagsA, PWM_S);
 	clear_flags(flagsA, PWM_R, PWM_T);
@@ -148,6 +243,8 @@ inline void RL_pwm()
 {
 	if (flag_is_set(flagsA, PWM_STATE)) {
 		RL_on();
+	} else if (flag_is_set(flagsA, PWM_SYNCHRO)) {
+		RH_on();								// The new PWM phase was off, no dead time needed
 	}	
 	set_flag(flagsA, PWM_R);
 	clear_flags(flagsA, PWM_S, PWM_T);
@@ -157,6 +254,8 @@ inline void TL_pwm()
 {
 	if (flag_is_set(flagsA, PWM_STATE)) {
 		TL_on();
+	} else if (flag_is_set(flagsA, PWM_SYNCHRO)) {
+		TH_on();								// The new PWM phase was off, no dead time needed
 	}
 	clear_flags(flagsA, PWM_S, PWM_R);
 	set_flag(flagsA, PWM_T);
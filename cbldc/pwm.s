@@ -8,38 +8,47 @@
 
  #include "pwm.h"
  #include "led.h"
+ #include "comparator.h"
 
-/*.global TIMER2_OC_INT
-dead_time_delay:
-	.if _PWM_DEAD_CYCLES-7 >= 0
-		.if (_PWM_DEAD_CYCLES-7) & 1
-			nop
-		.endif
-		.if (_PWM_DEAD_CYCLES-7) & 2
-			rjmp	.+0
-		.endif
-		.if (_PWM_DEAD_CYCLES-7) & 4
-			rjmp	.+0
-			rjmp	.+0
-		.endif
-		.if (_PWM_DEAD_CYCLES-7) & 8
-			rcall	dtd_ret
-			nop
-		.endif
-		.if (_PWM_DEAD_CYCLES-7) & 16
-			rcall	dtd_ret
-			rcall	dtd_ret
-			rjmp	.+0
-		.endif
-		.if _PWM_DEAD_CYCLES >= 32
-			.error	"Reduce PWM_DEAD_TIME"
-		.endif
-	.endif*/
-
-.if _PWM_DEAD_CYCLES-6 >= 32
-	.error	"Reduce PWM_DEAD_TIME"
-.endif
+#if !PWM_HARDWARE
 
+; Pads the dead time between turning one FET of a bridge off and the other one on, up to
+; _PWM_DEAD_CYCLES. spent - cycles the code in between takes anyway.
+.macro PWM_DEAD_DELAY spent
+	.if (_PWM_DEAD_CYCLES-\spent) >= 64
+		.error	"Reduce PWM_DEAD_TIME"
+	.endif
+	.if (_PWM_DEAD_CYCLES-\spent) > 0
+		.if (_PWM_DEAD_CYCLES-\spent) & 1
+			nop
+		.endif
+		.if (_PWM_DEAD_CYCLES-\spent) & 2
+			rjmp	.+0
+		.endif
+		.if (_PWM_DEAD_CYCLES-\spent) & 4
+			rjmp	.+0
+			rjmp	.+0
+		.endif
+		.if (_PWM_DEAD_CYCLES-\spent) & 8
+			rcall	dtd_ret
+			nop
+		.endif
+		.if (_PWM_DEAD_CYCLES-\spent) & 16
+			rcall	dtd_ret
+			rcall	dtd_ret
+			rjmp	.+0
+		.endif
+		.if (_PWM_DEAD_CYCLES-\spent) & 32
+			rcall	dtd_ret
+			rcall	dtd_ret
+			rcall	dtd_ret
+			rcall	dtd_ret
+			rjmp	.+0
+			rjmp	.+0
+		.endif
+	.endif
+.endm
+
 dtd_ret:	ret
  ; Timer 2 output compare interrupt service routine
  
@@ -88,27 +97,7 @@ pwm_set_fets_h:	sbrs	flagsA, PWM_SYNCHRO
 		sbrc	flagsA, PWM_T
 		TH_off
 
-		.if (_PWM_DEAD_CYCLES-6) >= 0
-			.if (_PWM_DEAD_CYCLES-6) & 1
-				nop
-			.endif
-			.if (_PWM_DEAD_CYCLES-6) & 2
-				rjmp	.+0
-			.endif
-			.if (_PWM_DEAD_CYCLES-6) & 4
-				rjmp	.+0
-				rjmp	.+0
-			.endif
-			.if (_PWM_DEAD_CYCLES-6) & 8
-				rcall	dtd_ret
-				nop
-			.endif
-			.if (_PWM_DEAD_CYCLES-6) & 16
-				rcall	dtd_ret
-				rcall	dtd_ret
-				rjmp	.+0
-			.endif
-		.endif
+		PWM_DEAD_DELAY 6
 
 pwm_set_fets_h2:
 		sbrc	flagsA, PWM_S
@@ -129,6 +118,8 @@ pwm_ret:	out	_SFR_IO_ADDR(SREG), isreg
 pwm_blinking_h:	mov	tmp_l, pwm_low_l		; Copy the blink time to tmp_l
 		lds	tmp_h, CONST_3			; tmp_h = 3. Can't really use any r16+ register here.
 
+		bst	flagsA, PWM_SYNCHRO		; Complementary PWM
+		brts	pwm_blink_h_sync
 		bst	flagsA, PWM_R			; If R FET does the PWM
 		brts	pwm_blink_h_r
 		bst	flagsA, PWM_T			; If T FET does the PWM
@@ -155,10 +146,49 @@ pwm_blink_h_t:	TL_on
 		out	_SFR_IO_ADDR(SREG), isreg
 		reti
 
+		; Complementary PWM, the high FET is on in the low state. Both switchings of the blink get the dead time.
+pwm_blink_h_sync:
+		sbrc	flagsA, PWM_S
+		SH_off
+		sbrc	flagsA, PWM_R
+		RH_off
+		sbrc	flagsA, PWM_T
+		TH_off
+		PWM_DEAD_DELAY 6
+		sbrc	flagsA, PWM_S
+		SL_on
+		sbrc	flagsA, PWM_R
+		RL_on
+		sbrc	flagsA, PWM_T
+		TL_on
+		sub	tmp_l, tmp_h
+		brpl	.-4
+		sbrc	flagsA, PWM_S
+		SL_off
+		sbrc	flagsA, PWM_R
+		RL_off
+		sbrc	flagsA, PWM_T
+		TL_off
+		PWM_DEAD_DELAY 6
+		sbrc	flagsA, PWM_S
+		SH_on
+		sbrc	flagsA, PWM_R
+		RH_on
+		sbrc	flagsA, PWM_T
+		TH_on
+		out	_SFR_IO_ADDR(SREG), isreg
+		reti
+
 
 
 		; If it was high pwm state, and we will be doing low state now.
-pwm_set_low:	in	tmp_l, _SFR_IO_ADDR(OCR2)	; Calculate and set time of the next high state
+pwm_set_low:
+	#if ZC_PWM_SAMPLING
+		sbrc	flagsB, ZC_SAMPLING		; End of the on-time, sample the comparator?
+		rjmp	pwm_zc_sample
+pwm_zc_sampled:
+	#endif
+		in	tmp_l, _SFR_IO_ADDR(OCR2)	; Calculate and set time of the next high state
 		add	tmp_l, pwm_low_l
 		out	_SFR_IO_ADDR(OCR2), tmp_l
 		mov	pwm_tcnt2_h, pwm_low_h
@@ -197,27 +227,7 @@ pwm_set_fets_l:	sbrc	flagsA, PWM_S
 		reti
 
 		// It is, it's already been 10 cycles. See if we need to add some more.
-		.if (_PWM_DEAD_CYCLES-10) >= 0
-			.if (_PWM_DEAD_CYCLES-10) & 1
-				nop
-			.endif
-			.if (_PWM_DEAD_CYCLES-10) & 2
-				rjmp	.+0
-			.endif
-			.if (_PWM_DEAD_CYCLES-10) & 4
-				rjmp	.+0
-				rjmp	.+0
-			.endif
-			.if (_PWM_DEAD_CYCLES-10) & 8
-				rcall	dtd_ret
-				nop
-			.endif
-			.if (_PWM_DEAD_CYCLES-10) & 16
-				rcall	dtd_ret
-				rcall	dtd_ret
-				rjmp	.+0
-			.endif
-		.endif
+		PWM_DEAD_DELAY 10
 		sbrc	flagsA, PWM_S
 		SH_on					; If R FET does the PWM
 		sbrc	flagsA, PWM_R
@@ -230,6 +240,8 @@ pwm_set_fets_l:	sbrc	flagsA, PWM_S
 pwm_blinking_l:	mov	tmp_l, pwm_high_l
 		lds	tmp_h, CONST_3
 
+		bst	flagsA, PWM_SYNCHRO
+		brts	pwm_blink_l_sync
 		bst	flagsA, PWM_R
 		brts	pwm_blink_l_r
 		bst	flagsA, PWM_T
@@ -254,4 +266,64 @@ pwm_blink_l_t:	TL_off
 		brpl	.-4
 		TL_on
 		out	_SFR_IO_ADDR(SREG), isreg
-		reti
\ No newline at end of file
+		reti
+
+pwm_blink_l_sync:
+		sbrc	flagsA, PWM_S
+		SL_off
+		sbrc	flagsA, PWM_R
+		RL_off
+		sbrc	flagsA, PWM_T
+		TL_off
+		PWM_DEAD_DELAY 6
+		sbrc	flagsA, PWM_S
+		SH_on
+		sbrc	flagsA, PWM_R
+		RH_on
+		sbrc	flagsA, PWM_T
+		TH_on
+		sub	tmp_l, tmp_h
+		brpl	.-4
+		sbrc	flagsA, PWM_S
+		SH_off
+		sbrc	flagsA, PWM_R
+		RH_off
+		sbrc	flagsA, PWM_T
+		TH_off
+		PWM_DEAD_DELAY 6
+		sbrc	flagsA, PWM_S
+		SL_on
+		sbrc	flagsA, PWM_R
+		RL_on
+		sbrc	flagsA, PWM_T
+		TL_on
+		out	_SFR_IO_ADDR(SREG), isreg
+		reti
+
+#if ZC_PWM_SAMPLING
+		; PWM synchronous ZC detection, see comparator.h. The ringing after the FET edges is over by
+		; the end of the on-time. The state awaited is ACO == ACIS0: first PRE-ZC, then ZC.
+pwm_zc_sample:	in	tmp_h, _SFR_IO_ADDR(ACSR)
+		sbrc	tmp_h, ACIS0
+		com	tmp_h				; ACO bit clear if ACO == ACIS0
+		sbrc	tmp_h, ACO
+		rjmp	pwm_zc_sampled			; Not there yet
+
+		sbrs	flagsB, AWAIT_PRE_ZC
+		rjmp	pwm_zc_found
+		cbr	flagsB, 1<<AWAIT_PRE_ZC		; PRE-ZC state, await the ZC state now
+		in	tmp_h, _SFR_IO_ADDR(ACSR)
+		sbrc	tmp_h, ACIS0
+		cbi	_SFR_IO_ADDR(ACSR), ACIS0
+		sbrs	tmp_h, ACIS0
+		sbi	_SFR_IO_ADDR(ACSR), ACIS0
+		rjmp	pwm_zc_sampled
+
+pwm_zc_found:	in	tmp_l, _SFR_IO_ADDR(TCNT1L)
+		in	tmp_h, _SFR_IO_ADDR(TCNT1H)
+		sts	_zc_sample_time, tmp_l
+		sts	_zc_sample_time+1, tmp_h
+		cbr	flagsB, 1<<ZC_SAMPLING		; Publish it, after the time
+		rjmp	pwm_zc_sampled
+#endif
+#endif /* !PWM_HARDWARE */
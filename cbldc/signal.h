@@ -12,6 +12,9 @@
 #include "bldc.h"
 #include "globals.h"
 
+// The ESC answers on the signal wire, see signal_telemetry()
+#define SIGNAL_TELEMETRY (INPUT_SIGNAL_TYPE == 3 && DSHOT_TELEMETRY)
+
 #if INPUT_SIGNAL_TYPE == 1
 
 	#define RC_PWM_PORT	PORTD
@@ -35,11 +38,83 @@
 	#else
 		#error Invalid constant: RC_PWM_CHANNEL. Please select 0 (external interrupt 0) or 1 (external interrupt 1)
 	#endif
+	
+	// Pulse protocols, see RC_PWM_PROTOCOL
+	#define RCP_NONE		0			// Not detected yet
+	#define RCP_SERVO		1
+	#define RCP_ONESHOT125	2
+	#define RCP_ONESHOT42	3
+	#define RCP_MULTISHOT	4
+	
+	#if RC_PWM_PROTOCOL < RCP_NONE || RC_PWM_PROTOCOL > RCP_MULTISHOT
+		#error Invalid constant: RC_PWM_PROTOCOL. Please select 0 (auto), 1 (servo), 2 (OneShot125), 3 (OneShot42) or 4 (Multishot)
+	#endif
 
 #elif INPUT_SIGNAL_TYPE == 2
-	#error I2C not implemented yet!
+
+	#if I2C_PROTOCOL != 1 && I2C_PROTOCOL != 2
+		#error Invalid constant: I2C_PROTOCOL. Please select 1 (8 bit throttle) or 2 (11 bit throttle)
+	#endif
+	
+	#if I2C_SLAVE_ADDRESS < 1 || I2C_SLAVE_ADDRESS > 0x77
+		#error Invalid constant: I2C_SLAVE_ADDRESS. 1-0x77 allowed.
+	#endif
+	
+	// The TWI slave needs the CPU clock 16 times SCL
+	#if F_CPU < 16UL * 400000UL
+		#error I2C at 400 kHz needs F_CPU 6.4 MHz or more
+	#endif
+	
+	// TWCR to go on after an interrupt: clear TWINT, acknowledge our address and the data
+	#define I2C_TWCR_ACK	((1<<TWINT)|(1<<TWEA)|(1<<TWEN)|(1<<TWIE))
+	
+	// TWSR status codes, slave receiver and slave transmitter
+	#define I2C_SR_SLA_ACK		0x60
+	#define I2C_SR_DATA_ACK		0x80
+	#define I2C_SR_STOP			0xA0
+	#define I2C_ST_SLA_ACK		0xA8
+	#define I2C_ST_DATA_ACK		0xB8
+	#define I2C_BUS_ERROR		0x00
+
+#elif INPUT_SIGNAL_TYPE == 3
+
+	// DShot comes in on the Timer1 input capture pin
+	#define DSHOT_PIN	PINB
+	#define DSHOT_DDR	DDRB
+	#define DSHOT_PORT	PORTB
+	#define DSHOT_P		0
+	
+	#if DSHOT_RATE != 150 && DSHOT_RATE != 300
+		#error Invalid constant: DSHOT_RATE. Please select 150 or 300
+	#endif
+	
+	// Bit period in 1/16 of Timer1 ticks (F_CPU/8). A bit starts with a rising edge, the falling edge
+	// comes after 6/16 (0) or 12/16 (1) of the period. All constants below are in Timer1 ticks.
+	#define _DSHOT_T16			(F_CPU * 2 / (DSHOT_RATE * 1000))
+	#define DSHOT_THRESHOLD		((19 * _DSHOT_T16 + 128) / 256)		// Falling edge interval, 0 below, 1 above
+	#define DSHOT_PREV_1		(6 * _DSHOT_T16 / 256)				// The previous bit was 1, its falling edge came later
+	#define DSHOT_FIRST			(10 * _DSHOT_T16 / 256)				// Bit 0 measured from the rising edge
+	#define DSHOT_H_MAX			(11 * _DSHOT_T16 / 256)				// Missed falling edge before this, bit 0 is 0
+	#define DSHOT_D_MAX			(28 * _DSHOT_T16 / 256)				// A falling edge got lost
+	#define DSHOT_IDLE			(64 * _DSHOT_T16 / 256)				// Low time before a frame, more than missed edges can fake
+	
+	#if DSHOT_TELEMETRY
+		// The line is inverted, the pulses are low. Rising and falling are the pulse's edges.
+		#define DSHOT_TCCR1B_RISING		((1<<ICNC1)|(1<<CS11))
+		#define DSHOT_TCCR1B_FALLING	((1<<ICNC1)|(1<<ICES1)|(1<<CS11))
+	#else
+		#define DSHOT_TCCR1B_RISING		((1<<ICNC1)|(1<<ICES1)|(1<<CS11))
+		#define DSHOT_TCCR1B_FALLING	((1<<ICNC1)|(1<<CS11))
+	#endif
+	
+	// Telemetry bit period in 1/16 of Timer1 ticks, 4/5 of the DShot one. The compare interrupt
+	// comes early by a PWM interrupt's time [Timer1 ticks], then the reply with the release.
+	#define _DSHOT_TLM_T16		(F_CPU * 8 / (DSHOT_RATE * 5000UL))
+	#define DSHOT_TLM_EARLY		((_PWM_INT_EXEC_TIME + TIMER_PRESCALER - 1) / TIMER_PRESCALER + 1)
+	#define DSHOT_TLM_TICKS		((int16_t)(DSHOT_TLM_EARLY + 2 + 22 * _DSHOT_TLM_T16 / 16))
+
 #else
-	#error Invalid constant: INPUT_SIGNAL_TYPE. Please select 1 (RC PWM) or 2 (I2C)
+	#error Invalid constant: INPUT_SIGNAL_TYPE. Please select 1 (RC PWM), 2 (I2C) or 3 (DShot)
 #endif
 
 
@@ -51,7 +126,9 @@
 #if INPUT_SIGNAL_TYPE == 1
 	
 	.extern rcp_rise_time
+	.extern rcp_rise_frac
 	.extern rcp_pulse_len
+	.extern rcp_pulse_frac
 	
 	#if RC_PWM_CHANNEL == 0
 		#define RC_PWM_INT __vector_1
@@ -59,7 +136,40 @@
 		#define RC_PWM_INT __vector_2
 	#endif
 	
+	#define rcp_r r30				// Saved by the ISR
+	
 #elif INPUT_SIGNAL_TYPE == 2
+
+	.extern i2c_idx
+	.extern i2c_rx
+	.extern i2c_cmd
+	.extern i2c_tx
+	.extern motor_status
+	.extern motor_faults
+	.extern motor_rps
+	
+	#define I2C_INT __vector_17
+	
+	#define i2c_r r30				// Saved by the ISR
+	
+#elif INPUT_SIGNAL_TYPE == 3
+
+	.extern dshot_last
+	.extern dshot_data
+	.extern dshot_frame
+	
+	#define DSHOT_INT __vector_5
+
+	#define dshot_r r30				// Saved by the ISR
+	#define dshot_r2 r31
+	
+	// Skip if the pulse is still on
+	#if DSHOT_TELEMETRY
+		#define dshot_sbis_pulse sbic
+	#else
+		#define dshot_sbis_pulse sbis
+	#endif
+	
 #else
 #endif
 
@@ -72,6 +182,7 @@
 	#error Clock overflow for 10ms!
 #endif
 
+#include <avr/pgmspace.h>
 #include "timer.h"
 #include "tools/arithmetic.h"
 
@@ -96,9 +207,24 @@ inline uint16_t __signal_to_pwm_range(uint16_t sig)
 	// |                                  RC PWM                                       |
 	// *-------------------------------------------------------------------------------*
 	
+	#if RC_PWM_PROTOCOL != RCP_SERVO && TIMER_PRESCALER != 8
+		#error OneShot and Multishot timing assumes TIMER_PRESCALER 8
+	#endif
+	
 	uint16_t rcp_rise_time;
 	uint16_t rcp_pulse_len;
 	
+	#if RC_PWM_PROTOCOL != RCP_SERVO
+	uint8_t rcp_rise_frac;			// TCNT0 - 8*TCNT1 at the rising edge
+	int8_t rcp_pulse_frac;			// [CPU cycles] Pulse length is 8*rcp_pulse_len + rcp_pulse_frac
+	uint8_t rcp_protocol = RC_PWM_PROTOCOL;
+	uint8_t rcp_detected;			// Protocol of the last pulses while detecting
+	uint8_t rcp_detect_cnt;
+	uint16_t rcp_hist[2];			// Last pulses for the median filter
+	#else
+	#define rcp_protocol RCP_SERVO
+	#endif
+	
 	void __rcp_err()
 	{
 		_signal_val = 0;
@@ -108,15 +234,60 @@ inline uint16_t __signal_to_pwm_range(uint16_t sig)
 		}
 	}	
 	
+	#if RC_PWM_PROTOCOL != RCP_SERVO
+	
+	// Protocol of a pulse by its length, the ranges of the protocols don't overlap
+	static uint8_t rcp_classify(uint16_t len)
+	{
+		if (len < US_TO_TICKS(31)) return RCP_MULTISHOT;
+		if (len < US_TO_TICKS(96)) return RCP_ONESHOT42;
+		if (len < US_TO_TICKS(500)) return RCP_ONESHOT125;
+		return RCP_SERVO;
+	}
+	
+	// Pulse length scaled to the servo range [Timer1 ticks], 0 if it's too short for anything
+	static uint16_t rcp_scale(uint16_t len, int8_t frac)
+	{
+		int16_t cycles = (len << 3) + frac;
+		switch (rcp_protocol) {
+			case RCP_ONESHOT125: return cycles;										// x8
+			case RCP_ONESHOT42: return cycles * 3;									// x24
+			case RCP_MULTISHOT: {
+				// 5-25 us to 1000-2000 us, x50
+				int16_t t = US_TO_TICKS(1000) + (cycles - (int16_t)(5 * (F_CPU / 1000000))) * 25 / 4;
+				return t > 0? t : 0;
+			}
+			default: return len;
+		}
+	}
+	
+	// Median of the last 3 pulses. One pulse delayed by another interrupt moves the short pulses
+	// a lot when scaled to the servo range.
+	static uint16_t rcp_median(uint16_t len)
+	{
+		uint16_t a = rcp_hist[0], b = rcp_hist[1];
+		rcp_hist[0] = b;
+		rcp_hist[1] = len;
+		if (a > b) { uint16_t t = a; a = b; b = t; }
+		if (len <= a) return a;
+		if (len >= b) return b;
+		return len;
+	}
+	
+	#endif
+	
 	// PRE: config must be loaded
 	static void signal_init()
 	{
 		CBI(RC_PWM_DDR, RC_PWM_P);							// RCP pin as input
 		_signal_val = 0;
+		#if RC_PWM_PROTOCOL != RCP_SERVO
+			TCCR0 = NB(CS00);									// Timer0 at the CPU clock, see signal.s
+		#endif
 		cli();
 		SBI(GICR, INTx_BIT);
 		SBI(MCUCR, ISCx0_BIT);
-		SBI(GIFR, INTFx_BIT);
+		GIFR = NB(INTFx_BIT);								// Write-one-to-clear
 		sei();
 		timerB_set_rel(MS_TO_TICKS(10));
 	}
@@ -128,7 +299,29 @@ inline uint16_t __signal_to_pwm_range(uint16_t sig)
 			cli();
 			clear_flag(flagsB, RCP_RECEIVED);			
 			uint16_t len = rcp_pulse_len;
-			sei();				
+			#if RC_PWM_PROTOCOL != RCP_SERVO
+				int8_t frac = rcp_pulse_frac;
+			#endif
+			sei();
+			#if RC_PWM_PROTOCOL != RCP_SERVO
+				uint8_t protocol = rcp_classify(len);
+				if (rcp_protocol == RCP_NONE) {
+					// Take the protocol after a few pulses in a row, no throttle until then
+					if (protocol != rcp_detected) {
+						rcp_detected = protocol;
+						rcp_detect_cnt = 0;
+					}
+					if (++rcp_detect_cnt >= RC_PWM_DETECT_PULSES) {
+						rcp_protocol = protocol;
+						rcp_hist[0] = rcp_hist[1] = rcp_scale(len, frac);
+					}
+					len = 0;
+				}
+				else if (protocol != rcp_protocol) len = 0;
+				if (len && rcp_protocol != RCP_SERVO) {
+					len = rcp_median(rcp_scale(len, frac));
+				}
+			#endif
 			if ((len >= cfg.rcp_min)) {
 				clear_flag(flagsA, SIGNAL_MAX);
 				if (len >= cfg.rcp_max) {
@@ -142,6 +335,9 @@ inline uint16_t __signal_to_pwm_range(uint16_t sig)
 					}
 					time = 0;
 				}
+				#if RC_PWM_DEADBAND
+				else if (time < (int16_t)US_TO_TICKS(RC_PWM_DEADBAND)) time = 0;
+				#endif
 				else if (time >= signal_range) time = signal_range;
 				uint16_t power = __signal_to_pwm_range(time);
 				_signal_val = power;
@@ -150,13 +346,17 @@ inline uint16_t __signal_to_pwm_range(uint16_t sig)
 				__rcp_err();
 
 			}
-			_signal_timeout = RC_PWM_TIMEOUT;
+			_signal_timeout = rcp_protocol == RCP_SERVO? RC_PWM_TIMEOUT : RC_PWM_FAST_TIMEOUT;
 			set_flag(flagsB, SIGNAL_RECEIVED);
 			timerB_set_rel(MS_TO_TICKS(10));
 		}
 		else if (timerB_ready()) {
 			if (--_signal_timeout == 0) {
 				__rcp_err();
+				#if RC_PWM_PROTOCOL == RCP_NONE
+					rcp_protocol = RCP_NONE;					// Detect again, the transmitter may have changed
+					rcp_detect_cnt = 0;
+				#endif
 			}
 			timerB_set_rel(MS_TO_TICKS(10));
 		}
@@ -167,12 +367,256 @@ inline uint16_t __signal_to_pwm_range(uint16_t sig)
 	// |                                    I2C                                        |
 	// *-------------------------------------------------------------------------------*
 	
-	void signal_init()
+	uint8_t i2c_idx;			// Bytes received in this write
+	uint8_t i2c_rx[2];
+	uint8_t i2c_cmd[2];			// Last complete write
+	uint8_t i2c_tx[3];			// Rest of the read: faults, speed high, speed low
+	
+	static void signal_init()
+	{
+		_signal_val = 0;
+		cli();
+		TWAR = I2C_SLAVE_ADDRESS << 1;
+		TWCR = I2C_TWCR_ACK;
+		sei();
+		timerB_set_rel(MS_TO_TICKS(10));
+	}
+
+	void signal_process()
+	{
+		if (flag_is_set(flagsB, RCP_RECEIVED)) {
+			cli();
+			clear_flag(flagsB, RCP_RECEIVED);
+			uint16_t throttle = i2c_cmd[0];
+			#if I2C_PROTOCOL == 2
+				throttle = throttle << 3 | (i2c_cmd[1] & 7);
+			#endif
+			sei();
+			clear_flags(flagsB, SIGNAL_ERROR, SIGNAL_BRAKE);
+			if (throttle >= I2C_RANGE) set_flag(flagsA, SIGNAL_MAX);
+			else clear_flag(flagsA, SIGNAL_MAX);
+			_signal_val = __signal_to_pwm_range(throttle);
+			_signal_timeout = I2C_TIMEOUT;
+			set_flag(flagsB, SIGNAL_RECEIVED);
+			timerB_set_rel(MS_TO_TICKS(10));
+		}
+		else if (timerB_ready()) {
+			if (--_signal_timeout == 0) {
+				_signal_val = 0;
+				set_flags(flagsB, SIGNAL_ERROR, SIGNAL_RECEIVED);
+				motor_fault(FAULT_SIGNAL);
+			}
+			timerB_set_rel(MS_TO_TICKS(10));
+		}
+	}
+	
+#elif INPUT_SIGNAL_TYPE == 3
+	// *-------------------------------------------------------------------------------*
+	// |                                   DShot                                       |
+	// *-------------------------------------------------------------------------------*
+	
+	#if TIMER_PRESCALER != 8
+		#error DShot timing constants assume TIMER_PRESCALER 8
+	#endif
+	
+	uint16_t dshot_last;		// Last captured edge
+	uint16_t dshot_data;		// Bits received so far, inverted, shifted in behind a 1
+	uint16_t dshot_frame;		// Last complete frame, inverted
+	
+	#if DSHOT_TELEMETRY
+		#if (6UL * TIMER_PRESCALER * 1000000) % F_CPU
+			#error DShot telemetry needs F_CPU to give a whole number of microseconds per 6 Timer1 ticks
+		#endif
+		
+		// 4 to 5 bits GCR, no two zeros in a row
+		PROGMEM const uint8_t dshot_gcr[16] = {
+			0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17, 0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+		};
+		
+		uint16_t dshot_tlm_time;	// End of the frame to answer
+		uint32_t dshot_tlm;			// Level changes of the reply, the start bit in bit 20
+		uint8_t dshot_tlm_due;
+		uint16_t dshot_tlm_start;	// Start bit [Timer1 ticks]
+		uint16_t dshot_tlm_edge;	// Next change after the start bit [1/16 ticks]
+		uint16_t dshot_tlm_next;	// The same in Timer1 ticks
+		uint16_t dshot_tlm_ocr;		// Timer B, OCR1B drives the reply meanwhile
+		volatile uint8_t dshot_tlm_bits;	// Bit periods left with the release, 0 - idle
+		
+		// Electrical period [us] as 9 bits shifted left by 3 bits, CRC, then GCR. Each GCR 1 is
+		// a level change on the wire, the start bit is low.
+		static void dshot_telemetry_prepare()
+		{
+			cli();
+			uint16_t com_time = motor_com_time;
+			sei();
+			uint16_t value = 0x0FFF;								// Stopped
+			if (com_time) {
+				uint32_t period = (uint32_t)com_time * (6UL * TIMER_PRESCALER * 1000000 / F_CPU);
+				uint8_t e = 0;
+				while (period > 511) {
+					period >>= 1;
+					e++;
+				}
+				if (e <= 7) value = (uint16_t)e << 9 | (uint16_t)period;
+			}
+			value = value << 4 | (~(value ^ (value >> 4) ^ (value >> 8)) & 0x0F);
+			uint32_t gcr = 0;
+			for (uint8_t i = 0; i < 4; i++) {
+				gcr = gcr << 5 | pgm_read_byte(&(dshot_gcr[value >> 12]));
+				value <<= 4;
+			}
+			dshot_tlm = 1UL << 20 | gcr;
+			dshot_tlm_due = 1;
+		}
+		
+		// The reply goes out from the compare B interrupt, nothing else can drive ICP1. Each call
+		// makes one level change, then sets OCR1B to the next one. It comes DSHOT_TLM_EARLY ticks
+		// ahead and waits for the time, so a PWM interrupt due then doesn't move the edge. The
+		// other interrupts wait a few us at most, not for the whole reply. Without a reply it's a
+		// timer B compare, see timer.h, and there's nothing to do.
+		ISR(TIMER1_COMPB_vect)
+		{
+			uint8_t n = dshot_tlm_bits;
+			if (!n) return;
+			uint16_t next = dshot_tlm_next;
+			while (1) {
+				while ((int16_t)(TCNT1 - next) < 0);
+				if (n == 1) {
+					SBI(DSHOT_PORT, DSHOT_P);						// Idle high, then the pull-up keeps it
+					CBI(DSHOT_DDR, DSHOT_P);
+					OCR1B = dshot_tlm_ocr;
+					dshot_last = TCNT1 - DSHOT_IDLE;				// The line is idle from here on
+					clear_flag(flagsA, DSHOT_FRAME);
+					TCCR1B = DSHOT_TCCR1B_RISING;
+					TIFR = NB(ICF1);
+					dshot_tlm_bits = 0;
+					return;
+				}
+				if (BIS(DSHOT_PORT, DSHOT_P)) CBI(DSHOT_PORT, DSHOT_P);
+				else SBI(DSHOT_PORT, DSHOT_P);
+				SBI(DSHOT_DDR, DSHOT_P);
+				uint32_t gcr = dshot_tlm;
+				uint16_t edge = dshot_tlm_edge;
+				do {
+					edge += _DSHOT_TLM_T16;
+					gcr <<= 1;
+				} while (--n > 1 && !(gcr & (1UL << 20)));
+				dshot_tlm = gcr;
+				dshot_tlm_edge = edge;
+				next = dshot_tlm_start + (edge >> 4);
+				if ((int16_t)(next - TCNT1) >= DSHOT_TLM_EARLY + 2) break;	// Else waits right here
+			}
+			dshot_tlm_next = next;
+			OCR1B = next - DSHOT_TLM_EARLY;
+			dshot_tlm_bits = n;
+		}
+		
+		// Hands the reply to the compare B interrupt. Timer B is kept aside until the release,
+		// timerB_ready() sees the next edge ahead meanwhile. The capture interrupt takes the own
+		// edges for a frame start after too short an idle time and drops them.
+		static void dshot_telemetry_send()
+		{
+			cli();
+			uint16_t start = TCNT1 + DSHOT_TLM_EARLY + 2;
+			dshot_tlm_start = start;
+			dshot_tlm_edge = 0;
+			dshot_tlm_next = start;
+			dshot_tlm_ocr = OCR1B;
+			OCR1B = start - DSHOT_TLM_EARLY;
+			TIFR = NB(OCF1B);									// A pending timer B compare
+			dshot_last = start;
+			dshot_tlm_bits = 22;								// Start bit, 20 bits, release
+			sei();
+		}
+		
+		// Sends the pending reply if the flight controller is listening, and if it fits into
+		// time_left [Timer1 ticks]. Called from signal_process() while the motor is stopped or
+		// braking, from run() while it runs so the waits in the interrupt don't delay a ZC, never
+		// during the start.
+		void signal_telemetry(int16_t time_left)
+		{
+			if (!dshot_tlm_due) return;
+			uint16_t since = timer_get() - dshot_tlm_time;
+			if (since < US_TO_TICKS(DSHOT_TELEMETRY_DELAY)) return;
+			if (since > US_TO_TICKS(DSHOT_TELEMETRY_WINDOW)) {
+				dshot_tlm_due = 0;									// Too late, the next frame may be coming
+				return;
+			}
+			if (time_left < DSHOT_TLM_TICKS) return;
+			dshot_tlm_due = 0;
+			dshot_telemetry_send();
+		}
+	#endif
+	
+	static void signal_init()
 	{
+		CBI(DSHOT_DDR, DSHOT_P);							// DShot pin as input
+		#if DSHOT_TELEMETRY
+		SBI(DSHOT_PORT, DSHOT_P);							// Idle high
+		dshot_tlm_due = 0;
+		dshot_tlm_bits = 0;
+		#endif
+		_signal_val = 0;
+		cli();
+		clear_flag(flagsA, DSHOT_FRAME);
+		TCCR1B = DSHOT_TCCR1B_RISING;
+		TIFR = NB(ICF1);
+		SBI(TIMSK, TICIE1);
+		#if DSHOT_TELEMETRY
+		SBI(TIMSK, OCIE1B);
+		#endif
+		sei();
+		timerB_set_rel(MS_TO_TICKS(10));
 	}
 
-	uint8_t signal_process()
+	void signal_process()
 	{
+		if (flag_is_set(flagsB, RCP_RECEIVED)) {
+			cli();
+			clear_flag(flagsB, RCP_RECEIVED);
+			uint16_t frame = ~dshot_frame;
+			#if DSHOT_TELEMETRY
+			uint16_t frame_end = dshot_last;
+			#endif
+			sei();
+			// 11 bits throttle, telemetry request, 4 bits CRC
+			uint16_t value = frame >> 4;
+			#if DSHOT_TELEMETRY
+			frame ^= 0x0F;											// Inverted CRC
+			#endif
+			if ((uint8_t)((value ^ (value >> 4) ^ (value >> 8)) & 0x0F) != (uint8_t)(frame & 0x0F)) {
+				return;												// Corrupted, wait for the next one
+			}
+			#if DSHOT_TELEMETRY
+			dshot_tlm_time = frame_end;
+			dshot_telemetry_prepare();
+			#endif
+			uint16_t throttle = value >> 1;
+			clear_flags(flagsB, SIGNAL_ERROR, SIGNAL_BRAKE);
+			clear_flag(flagsA, SIGNAL_MAX);
+			if (throttle < DSHOT_THROTTLE_MIN) {
+				throttle = 0;
+			}
+			else {
+				throttle -= DSHOT_THROTTLE_MIN;
+				if (throttle >= DSHOT_RANGE) set_flag(flagsA, SIGNAL_MAX);
+			}
+			_signal_val = __signal_to_pwm_range(throttle);
+			_signal_timeout = DSHOT_TIMEOUT;
+			set_flag(flagsB, SIGNAL_RECEIVED);
+			timerB_set_rel(MS_TO_TICKS(10));
+		}
+		else if (timerB_ready()) {
+			if (--_signal_timeout == 0) {
+				_signal_val = 0;
+				set_flags(flagsB, SIGNAL_ERROR, SIGNAL_RECEIVED);
+				motor_fault(FAULT_SIGNAL);
+			}
+			timerB_set_rel(MS_TO_TICKS(10));
+		}
+		#if DSHOT_TELEMETRY
+		if (motor_status == MOTOR_STOPPED || motor_status == MOTOR_BRAKING) signal_telemetry(INT16_MAX);
+		#endif
 	}
 	
 #else
@@ -14,12 +14,14 @@
 
 ; External Interrupt service routine.
 			
+#if RC_PWM_PROTOCOL == RCP_SERVO
+
 .global RC_PWM_INT
 RC_PWM_INT:	in	isreg, _SFR_IO_ADDR(SREG)
 		sbic	_SFR_IO_ADDR(RC_PWM_PIN), RC_PWM_P
 		rjmp	rcp_rising
 
-		; Falling RC PWM edge received
+		; Falling RC PWM edge received
 rcp_falling:	;sbrc	flagsA, RCP_EXPECTED_STATE
 		;reti
 		in	tmp_l, _SFR_IO_ADDR(TCNT1L)
@@ -46,21 +48,302 @@ rcp_rising:	;sbrs	flagsA, RCP_EXPECTED_STATE
 		;cbr	flagsA, 1<<RCP_EXPECTED_STATE
 		out	_SFR_IO_ADDR(SREG), isreg
 		;LED1_1
+		reti
+
+#else
+
+; The edge time comes from Timer1. For the short pulse protocols it's refined to a CPU cycle with
+; Timer0, which runs at the CPU clock. The two timers share the prescaler, so TCNT0 - 8*TCNT1 only
+; changes with the prescaler phase, and the phase difference of the two edges adds to the pulse
+; length. Both edges read the timers at the same point.
+
+.global RC_PWM_INT
+RC_PWM_INT:	in	tmp_h, _SFR_IO_ADDR(TCNT0)
+		in	tmp_l, _SFR_IO_ADDR(TCNT1L)
+		in	isreg, _SFR_IO_ADDR(SREG)
+		sbic	_SFR_IO_ADDR(RC_PWM_PIN), RC_PWM_P
+		rjmp	rcp_rising
+
+		; Falling RC PWM edge received
+rcp_falling:	;sbrc	flagsA, RCP_EXPECTED_STATE
+		;reti
+		push	rcp_r
+		mov	rcp_r, tmp_l
+		lsl	rcp_r
+		lsl	rcp_r
+		lsl	rcp_r
+		sub	tmp_h, rcp_r
+		lds	rcp_r, rcp_rise_frac
+		sub	tmp_h, rcp_r
+		sts	rcp_pulse_frac, tmp_h		; [CPU cycles] to add to 8*rcp_pulse_len
+		lds	rcp_r, rcp_rise_time
+		sub	tmp_l, rcp_r
+		sts	rcp_pulse_len, tmp_l
+		in	tmp_l, _SFR_IO_ADDR(TCNT1H)	; Latched when TCNT1L was read
+		lds	rcp_r, rcp_rise_time+1
+		sbc	tmp_l, rcp_r
+		sts	rcp_pulse_len+1, tmp_l
+		pop	rcp_r
+		;sbr	flagsA, 1<<RCP_EXPECTED_STATE
+		sbr	flagsB, 1<<RCP_RECEIVED
+		out	_SFR_IO_ADDR(SREG), isreg
+		;LED1_0
+		reti
+
+		; Rising RC PWM edge received
+rcp_rising:	;sbrs	flagsA, RCP_EXPECTED_STATE
+		;reti
+		sts	rcp_rise_time, tmp_l
+		lsl	tmp_l
+		lsl	tmp_l
+		lsl	tmp_l
+		sub	tmp_h, tmp_l
+		sts	rcp_rise_frac, tmp_h
+		in	tmp_l, _SFR_IO_ADDR(TCNT1H)
+		sts	rcp_rise_time+1, tmp_l
+		;cbr	flagsA, 1<<RCP_EXPECTED_STATE
+		out	_SFR_IO_ADDR(SREG), isreg
+		;LED1_1
 		reti
+
+#endif
 
 
 
-#endif  
-; INPUT_SIGNAL_TYPE == 1
-
-
-
-
-
-
-
-
-
+#elif INPUT_SIGNAL_TYPE == 2
+
+; TWI service routine, I2C slave.
+; One interrupt per address, data byte or stop condition, TWSR tells which. The TWI holds SCL
+; low until TWINT is cleared at the end, so the master just waits when another interrupt delays
+; this one. A write is collected in i2c_rx and copied to i2c_cmd at the stop (or repeated start),
+; so signal_process() never sees half of it. A read latches the motor state into i2c_tx and
+; sends it out one byte per interrupt, shifting the rest down.
+
+.global I2C_INT
+I2C_INT:	push	i2c_r
+		in	isreg, _SFR_IO_ADDR(SREG)
+		in	i2c_r, _SFR_IO_ADDR(TWSR)
+		andi	i2c_r, 0xF8			; The status, without the prescaler bits
+		cpi	i2c_r, I2C_SR_DATA_ACK
+		breq	i2c_rx_data
+		cpi	i2c_r, I2C_ST_DATA_ACK
+		breq	i2c_tx_data
+		cpi	i2c_r, I2C_SR_SLA_ACK
+		breq	i2c_rx_start
+		cpi	i2c_r, I2C_ST_SLA_ACK
+		breq	i2c_tx_start
+		cpi	i2c_r, I2C_SR_STOP
+		breq	i2c_rx_stop
+		cpi	i2c_r, I2C_BUS_ERROR
+		breq	i2c_bus_error
+
+		; Anything else is the end of a read or a NACK, wait for the next address
+i2c_ack:	ldi	i2c_r, I2C_TWCR_ACK
+		out	_SFR_IO_ADDR(TWCR), i2c_r
+		pop	i2c_r
+		out	_SFR_IO_ADDR(SREG), isreg
+		reti
+
+		; Data byte received, bytes beyond the protocol's are dropped
+i2c_rx_data:	in	tmp_l, _SFR_IO_ADDR(TWDR)
+		lds	i2c_r, i2c_idx
+		cpi	i2c_r, 1
+		brsh	i2c_rx_low
+		sts	i2c_rx, tmp_l
+		rjmp	i2c_rx_next
+i2c_rx_low:	brne	i2c_ack
+		sts	i2c_rx+1, tmp_l
+i2c_rx_next:	inc	i2c_r
+		sts	i2c_idx, i2c_r
+		rjmp	i2c_ack
+
+		; Data byte sent and acknowledged, the master wants the next one
+i2c_tx_data:	lds	tmp_l, i2c_tx
+		out	_SFR_IO_ADDR(TWDR), tmp_l
+		lds	tmp_l, i2c_tx+1
+		sts	i2c_tx, tmp_l
+		lds	tmp_l, i2c_tx+2
+		sts	i2c_tx+1, tmp_l
+		ldi	i2c_r, 0xFF			; Past the end
+		sts	i2c_tx+2, i2c_r
+		rjmp	i2c_ack
+
+		; Addressed for a write
+i2c_rx_start:	clr	tmp_l
+		sts	i2c_idx, tmp_l
+		sts	i2c_rx+1, tmp_l			; Low bits, if the master sends just one byte
+		rjmp	i2c_ack
+
+		; Addressed for a read, the status goes out now
+i2c_tx_start:	lds	tmp_l, motor_status
+		out	_SFR_IO_ADDR(TWDR), tmp_l
+		lds	tmp_l, motor_faults
+		sts	i2c_tx, tmp_l
+		clr	tmp_l
+		sts	motor_faults, tmp_l
+		lds	tmp_l, motor_rps+1
+		sts	i2c_tx+1, tmp_l
+		lds	tmp_l, motor_rps
+		sts	i2c_tx+2, tmp_l
+		rjmp	i2c_ack
+
+		; End of a write
+i2c_rx_stop:	lds	i2c_r, i2c_idx
+		tst	i2c_r
+		breq	i2c_ack				; Just the address, or already done
+		lds	tmp_l, i2c_rx
+		sts	i2c_cmd, tmp_l
+		lds	tmp_l, i2c_rx+1
+		sts	i2c_cmd+1, tmp_l
+		clr	tmp_l
+		sts	i2c_idx, tmp_l
+		sbr	flagsB, 1<<RCP_RECEIVED
+		rjmp	i2c_ack
+
+		; Illegal start or stop, release the bus
+i2c_bus_error:	ldi	i2c_r, I2C_TWCR_ACK|(1<<TWSTO)
+		out	_SFR_IO_ADDR(TWCR), i2c_r
+		pop	i2c_r
+		out	_SFR_IO_ADDR(SREG), isreg
+		reti
+
+#elif INPUT_SIGNAL_TYPE == 3
+
+; Timer1 input capture service routine, DShot.
+; Waits for the rising edge of the first bit, then captures the falling edges only, so there's
+; one interrupt per bit. The interval between two falling edges is a bit period plus the
+; difference of the two bits' high times. With the previous bit known, that tells the new bit.
+; The rising edge path has to switch the capture to the falling edge before the first bit ends
+; its high state: 3/8 of a bit, 20 cycles in DShot300. If it's late, but not later than a 1
+; would be, the first bit was a 0 and its falling edge is assumed at the nominal time.
+
+.global DSHOT_INT
+DSHOT_INT:	in	tmp_l, _SFR_IO_ADDR(ICR1L)
+		in	tmp_h, _SFR_IO_ADDR(ICR1H)
+		push	dshot_r
+		sbrc	flagsA, DSHOT_FRAME
+		rjmp	dshot_falling
+
+		; Rising edge, first bit of a frame
+dshot_rising:	ldi	dshot_r, DSHOT_TCCR1B_FALLING
+		out	_SFR_IO_ADDR(TCCR1B), dshot_r
+		ldi	dshot_r, 1<<ICF1		; Changing the edge may set the flag
+		out	_SFR_IO_ADDR(TIFR), dshot_r
+		in	isreg, _SFR_IO_ADDR(SREG)
+		push	dshot_r2
+		in	dshot_r2, _SFR_IO_ADDR(TCNT1L)
+		clt					; T = the falling edge of bit 0 was missed
+		dshot_sbis_pulse	_SFR_IO_ADDR(DSHOT_PIN), DSHOT_P
+		rjmp	dshot_rising_low
+
+		; The line must have been idle, otherwise it's some bit in the middle of a frame
+dshot_rising_idle:
+		lds	dshot_r, dshot_last
+		lds	dshot_r2, dshot_last+1
+		sts	dshot_last, tmp_l
+		sts	dshot_last+1, tmp_h
+		sub	tmp_l, dshot_r
+		sbc	tmp_h, dshot_r2
+		ldi	dshot_r, DSHOT_IDLE & 0xFF
+		cp	tmp_l, dshot_r
+		ldi	dshot_r, DSHOT_IDLE >> 8
+		cpc	tmp_h, dshot_r
+		brlo	dshot_rising_bad
+
+		; Pretend there was a 0 before, DSHOT_FIRST makes the first bit's
+		; high time look like a falling edge interval.
+		lds	dshot_r, dshot_last
+		ldi	dshot_r2, 1			; The 1 is shifted out after 16 bits
+		brts	dshot_rising_missed
+		subi	dshot_r, DSHOT_FIRST
+		rjmp	dshot_rising_start
+dshot_rising_missed:
+		subi	dshot_r, -DSHOT_PREV_1		; Nominal falling edge of a 0
+		ldi	dshot_r2, 3			; Bit 0 in, inverted
+dshot_rising_start:
+		sts	dshot_last, dshot_r
+		sts	dshot_data, dshot_r2
+		clr	dshot_r
+		sts	dshot_data+1, dshot_r
+		sbr	flagsA, 1<<DSHOT_FRAME
+		pop	dshot_r2
+		pop	dshot_r
+		out	_SFR_IO_ADDR(SREG), isreg
+		reti
+
+		; The pin is low already. Either the falling edge came after the capture flag was
+		; cleared and it's captured, or it's lost and there's only the time it took.
+dshot_rising_low:
+		in	dshot_r, _SFR_IO_ADDR(TIFR)
+		sbrc	dshot_r, ICF1
+		rjmp	dshot_rising_idle
+		sub	dshot_r2, tmp_l
+		cpi	dshot_r2, DSHOT_H_MAX
+		brsh	dshot_rising_late
+		set
+		rjmp	dshot_rising_idle
+
+dshot_rising_late:
+		sts	dshot_last, tmp_l		; Too late, can't tell the bit
+		sts	dshot_last+1, tmp_h
+
+dshot_rising_bad:
+		ldi	dshot_r, DSHOT_TCCR1B_RISING
+		out	_SFR_IO_ADDR(TCCR1B), dshot_r
+		ldi	dshot_r, 1<<ICF1
+		out	_SFR_IO_ADDR(TIFR), dshot_r
+		pop	dshot_r2
+		pop	dshot_r
+		out	_SFR_IO_ADDR(SREG), isreg
+		reti
+
+		; Falling edge, one per bit
+dshot_falling:	in	isreg, _SFR_IO_ADDR(SREG)
+		lds	dshot_r, dshot_last
+		sts	dshot_last, tmp_l
+		sts	dshot_last+1, tmp_h
+		neg	dshot_r
+		add	dshot_r, tmp_l			; Falling edge interval
+		lds	tmp_l, dshot_data
+		lds	tmp_h, dshot_data+1
+		sbrs	tmp_l, 0			; Bits are stored inverted, 0 means the previous bit was 1
+		subi	dshot_r, -DSHOT_PREV_1
+		cpi	dshot_r, DSHOT_D_MAX
+		brsh	dshot_end			; Lost an edge
+		cpi	dshot_r, DSHOT_THRESHOLD	; C = bit is 0
+		rol	tmp_l
+		rol	tmp_h
+		brcs	dshot_done
+		sts	dshot_data, tmp_l
+		sts	dshot_data+1, tmp_h
+		pop	dshot_r
+		out	_SFR_IO_ADDR(SREG), isreg
+		reti
+
+		; All 16 bits are in
+dshot_done:	sts	dshot_frame, tmp_l
+		sts	dshot_frame+1, tmp_h
+		sbr	flagsB, 1<<RCP_RECEIVED
+dshot_end:	cbr	flagsA, 1<<DSHOT_FRAME
+		ldi	dshot_r, DSHOT_TCCR1B_RISING
+		out	_SFR_IO_ADDR(TCCR1B), dshot_r
+		ldi	dshot_r, 1<<ICF1
+		out	_SFR_IO_ADDR(TIFR), dshot_r
+		pop	dshot_r
+		out	_SFR_IO_ADDR(SREG), isreg
+		reti
+
+#endif  
+; INPUT_SIGNAL_TYPE
+
+
+
+
+
+
+
+
+
 /*#include "signal.h"
 
 #if RC_PWM_PIN_INTERRUPT == 1
@@ -77,6 +360,6 @@ RC_PWM_INT:
 		sts	rcp_edge_time+1, tmp_h
 		;DISABLE_INT
 		;CLEAR_PENDING_INT
-		reti
-
+		reti
+
 #endif  ; RC_PWM_PIN_INTERRUPT*/
\ No newline at end of file
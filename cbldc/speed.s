@@ -0,0 +1,133 @@
+/*
+ * speed.s
+ *
+ * Speed in rps of a commutation time, TICKS_PER_SECOND / 6 / t, without the lookup tables of
+ * speed.h (SPEED_RECIPROCAL). t is normalized to x = m / 2^16 in [0.5, 1) and 1/x is found by
+ * Newton-Raphson steps on the hardware multiplier, then scaled by TICKS_PER_SECOND / 6.
+ * C port in host/speed_rcp.h, "make speedbench-run" in host/ checks it and counts its cycles.
+ */ 
+
+ #include "speed.h"
+
+#if SPEED_RECIPROCAL || !defined(__AVR__)
+
+; The upper 16 bits of a 16 x 16 bit product, exact: r27:r26 = (\a * \b) >> 16. r22 is zero,
+; r18 takes the second byte.
+.macro MUL_HI16 aL, aH, bL, bH
+		mul	\aL, \bL
+		mov	r18, r1
+		mul	\aH, \bH
+		movw	r26, r0
+		mul	\aL, \bH
+		add	r18, r0
+		adc	r26, r1
+		adc	r27, r22
+		mul	\aH, \bL
+		add	r18, r0
+		adc	r26, r1
+		adc	r27, r22
+.endm
+
+; Y = 1 + y / 2^16 is below 1/x. e = 1 - x*Y, Y = Y + Y*e, the error squares and Y stays below.
+; x*Y may reach 1 exactly, e then wraps to 0.
+.macro RCP_STEP
+		MUL_HI16 r24, r25, r20, r21		; x*Y = x + x*y
+		add	r26, r24
+		adc	r27, r25
+		movw	r30, r26
+		com	r31				; e
+		neg	r30
+		sbci	r31, 0xFF
+		MUL_HI16 r20, r21, r30, r31		; Y*e = e + y*e
+		add	r20, r30
+		adc	r21, r31
+		add	r20, r26
+		adc	r21, r27
+.endm
+
+; uint16_t speed_reciprocal(uint16_t t), t in r25:r24, the speed back in r25:r24
+.global speed_reciprocal
+speed_reciprocal:
+		cpi	r24, lo8(_SPEED_RCP_T_MIN)
+		ldi	r23, hi8(_SPEED_RCP_T_MIN)
+		cpc	r25, r23
+		brsh	rcp_begin
+		ldi	r24, 0xFF			; The speed doesn't fit 16 bits
+		ldi	r25, 0xFF
+		ret
+
+rcp_begin:	clr	r22
+		ldi	r23, 16-_SPEED_RCP_SHIFT	; Right shift of the result, less one per bit of t shifted left
+
+		; m = t << s, with the top bit set. t >= _SPEED_RCP_T_MIN keeps the shift count positive.
+		tst	r25
+		brne	rcp_norm
+		mov	r25, r24
+		clr	r24
+		subi	r23, 8
+rcp_norm:	sbrc	r25, 7
+		rjmp	rcp_seed
+		lsl	r24
+		rol	r25
+		dec	r23
+		rjmp	rcp_norm
+
+		; Seed from the tangent of 1/x at x = 0.707: Y = 2.828 - 2x, below 1/x by 17% at most.
+		; y = _SPEED_RCP_SEED - 2 * (m - 0x8000), 0 if negative.
+rcp_seed:	movw	r30, r24
+		lsl	r30
+		rol	r31
+		ldi	r20, lo8(_SPEED_RCP_SEED)
+		ldi	r21, hi8(_SPEED_RCP_SEED)
+		sub	r20, r30
+		sbc	r21, r31
+		brcc	rcp_steps
+		clr	r20
+		clr	r21
+
+		; The error goes from 17% to 3%, 0.09% and then below the last bit of y
+rcp_steps:	ldi	r19, 3
+rcp_step:	RCP_STEP
+		dec	r19
+		brne	rcp_step
+
+		; r19:r27:r26 = K * Y = K + K*y, 17 bits
+		ldi	r30, lo8(_SPEED_RCP_K)
+		ldi	r31, hi8(_SPEED_RCP_K)
+		MUL_HI16 r30, r31, r20, r21
+		clr	r19
+		add	r26, r30
+		adc	r27, r31
+		adc	r19, r22
+
+		; Shift right by r23, rounded: the last bit shifted out is added back
+		tst	r23
+		breq	rcp_done
+		cpi	r23, 9
+		brlo	rcp_shift
+		mov	r26, r27
+		mov	r27, r19
+		clr	r19
+		subi	r23, 8
+rcp_shift:	dec	r23
+		breq	rcp_round
+		lsr	r19
+		ror	r27
+		ror	r26
+		rjmp	rcp_shift
+rcp_round:	lsr	r19
+		ror	r27
+		ror	r26
+		adc	r26, r22
+		adc	r27, r22
+		adc	r19, r22
+
+rcp_done:	movw	r24, r26
+		tst	r19
+		breq	rcp_ret
+		ldi	r24, 0xFF			; Rounded up past 16 bits
+		ldi	r25, 0xFF
+rcp_ret:	clr	r1
+		ret
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * telemetry.h
+ *
+ * Binary telemetry frames on the USART transmitter, see UART_TELEMETRY and UART_BAUD.
+ *
+ * Frame: TLM_SYNC, type, payload, 8-bit sum of type and payload. Little endian.
+ *  TLM_RUN   rps, pwm_get(), gov_error, gov_power, commutations, shortest and longest
+ *            commutation [Timer1 ticks] (16 bits each), late ZCs, ZCs without the pre-ZC
+ *            state (8 bits each), longest demagnetization [Timer1 ticks] (16 bits) and power
+ *            cuts for demag (8 bits). The counts are since the previous run frame.
+ *  TLM_START attempt (1..START_ATTEMPTS), start() result, commutation time handed to run()
+ *  TLM_STOP  run() result
+ *
+ * Nothing waits for the transmitter. Frames go into a ring, telemetry_step() sends at most one
+ * byte per call, and builds a run frame while the motor runs and the ring is empty. Events
+ * that don't fit are dropped.
+ */
+
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <avr/io.h>
+#include "bldc.h"
+#include "globals.h"
+#include "tools/brs.h"
+
+#define TLM_SYNC	0xA5
+#define TLM_RUN		1
+#define TLM_START	2
+#define TLM_STOP	3
+
+#if UART_TELEMETRY
+
+	#include "governor.h"
+	#include "pwm.h"
+
+	#define _UART_UBRR ((F_CPU / 8 + UART_BAUD / 2) / UART_BAUD - 1)			// Double speed
+	#define _UART_BAUD_REAL (F_CPU / 8 / (_UART_UBRR + 1))
+	#if _UART_UBRR > 4095 || _UART_BAUD_REAL * 50 > UART_BAUD * 51 || _UART_BAUD_REAL * 51 < UART_BAUD * 50
+		#error Invalid constant: UART_BAUD. Must be within 2% of F_CPU/8/n
+	#endif
+
+	#define TLM_RING 64						// Power of 2
+
+	uint8_t _tlm_ring[TLM_RING];
+	uint8_t _tlm_head;
+	uint8_t _tlm_tail;
+
+	// Per commutation statistics since the last run frame
+	struct {
+		uint16_t count;
+		uint16_t com_min;
+		uint16_t com_max;
+		uint8_t late;
+		uint8_t no_pre_zc;
+		uint16_t demag_max;
+		uint8_t demag_cuts;
+	} _tlm_stats;
+
+	static void _tlm_frame(const uint8_t* data, uint8_t len)
+	{
+		uint8_t head = _tlm_head;
+		if ((uint8_t)((_tlm_tail - head - 1) & (TLM_RING - 1)) < len + 2) return;
+		uint8_t sum = 0;
+		_tlm_ring[head] = TLM_SYNC;
+		while (len--) {
+			head = (head + 1) & (TLM_RING - 1);
+			_tlm_ring[head] = *data;
+			sum += *data++;
+		}
+		head = (head + 1) & (TLM_RING - 1);
+		_tlm_ring[head] = sum;
+		_tlm_head = (head + 1) & (TLM_RING - 1);
+	}
+
+	static void _tlm_stats_reset()
+	{
+		_tlm_stats.count = 0;
+		_tlm_stats.com_min = 0xFFFF;
+		_tlm_stats.com_max = 0;
+		_tlm_stats.late = 0;
+		_tlm_stats.no_pre_zc = 0;
+		_tlm_stats.demag_max = 0;
+		_tlm_stats.demag_cuts = 0;
+	}
+
+	static void telemetry_init()
+	{
+		UBRRH = _UART_UBRR >> 8;
+		UBRRL = (uint8_t)_UART_UBRR;
+		UCSRA = NB(U2X);
+		UCSRC = NB(URSEL) | NB(UCSZ1) | NB(UCSZ0);		// 8N1
+		UCSRB = NB(TXEN);
+		_tlm_stats_reset();
+	}
+
+	// Background task, bounded: one byte, or one run frame built
+	static void telemetry_step()
+	{
+		if (_tlm_head != _tlm_tail) {
+			if (BIS(UCSRA, UDRE)) {
+				UDR = _tlm_ring[_tlm_tail];
+				_tlm_tail = (_tlm_tail + 1) & (TLM_RING - 1);
+			}
+		}
+		else if (motor_status == MOTOR_RUNNING) {
+			uint8_t f[20];
+			f[0] = TLM_RUN;
+			f[1] = (uint8_t)motor_rps;
+			f[2] = motor_rps >> 8;
+			f[3] = (uint8_t)pwm_get();
+			f[4] = pwm_get() >> 8;
+			f[5] = (uint8_t)gov_error;
+			f[6] = (uint16_t)gov_error >> 8;
+			f[7] = (uint8_t)gov_power;
+			f[8] = gov_power >> 8;
+			f[9] = (uint8_t)_tlm_stats.count;
+			f[10] = _tlm_stats.count >> 8;
+			f[11] = (uint8_t)_tlm_stats.com_min;
+			f[12] = _tlm_stats.com_min >> 8;
+			f[13] = (uint8_t)_tlm_stats.com_max;
+			f[14] = _tlm_stats.com_max >> 8;
+			f[15] = _tlm_stats.late;
+			f[16] = _tlm_stats.no_pre_zc;
+			f[17] = (uint8_t)_tlm_stats.demag_max;
+			f[18] = _tlm_stats.demag_max >> 8;
+			f[19] = _tlm_stats.demag_cuts;
+			_tlm_frame(f, sizeof(f));
+			_tlm_stats_reset();
+		}
+	}
+
+	inline void telemetry_commutation(uint16_t com_duration)
+	{
+		if (_tlm_stats.count != 0xFFFF) _tlm_stats.count++;
+		if (com_duration < _tlm_stats.com_min) _tlm_stats.com_min = com_duration;
+		if (com_duration > _tlm_stats.com_max) _tlm_stats.com_max = com_duration;
+	}
+
+	// The ZC didn't come in 60 degrees, waiting 180 more
+	inline void telemetry_zc_late()
+	{
+		if (_tlm_stats.late != 0xFF) _tlm_stats.late++;
+	}
+
+	// The comparator never left the ZC state, power cut for a commutation
+	inline void telemetry_no_pre_zc()
+	{
+		if (_tlm_stats.no_pre_zc != 0xFF) _tlm_stats.no_pre_zc++;
+	}
+
+	// Measured after each commutation, cut: the power was cut for it
+	inline void telemetry_demag(uint16_t demag, uint8_t cut)
+	{
+		if (demag > _tlm_stats.demag_max) _tlm_stats.demag_max = demag;
+		if (cut && _tlm_stats.demag_cuts != 0xFF) _tlm_stats.demag_cuts++;
+	}
+
+	static void telemetry_start(uint8_t attempt, uint8_t result, uint16_t com_duration)
+	{
+		uint8_t f[] = {TLM_START, attempt, result, (uint8_t)com_duration, com_duration >> 8};
+		_tlm_frame(f, sizeof(f));
+		_tlm_stats_reset();
+	}
+
+	static void telemetry_stop(uint8_t result)
+	{
+		uint8_t f[] = {TLM_STOP, result};
+		_tlm_frame(f, sizeof(f));
+	}
+
+#else
+
+	inline void telemetry_init() {}
+	inline void telemetry_step() {}
+	inline void telemetry_commutation(uint16_t com_duration) {}
+	inline void telemetry_zc_late() {}
+	inline void telemetry_no_pre_zc() {}
+	inline void telemetry_demag(uint16_t demag, uint8_t cut) {}
+	inline void telemetry_start(uint8_t attempt, uint8_t result, uint16_t com_duration) {}
+	inline void telemetry_stop(uint8_t result) {}
+
+#endif
+
+#endif /* TELEMETRY_H_ */
@@ -9,16 +9,16 @@
 #ifndef TIMER_H_
 #define TIMER_H_
 
-#ifndef __ASSEMBLER__
-
-#include "tools/atmega8_tp.h"
-
 #define TIMER_PRESCALER 8
 #define TIMER_MAX 32767
 #define MS_TO_TICKS(ms) ((ms) * (F_CPU / 1000) / TIMER_PRESCALER)
 #define US_TO_TICKS(us) ((us) * (F_CPU / 1000) / TIMER_PRESCALER / 1000)
 #define TICKS_PER_SECOND (F_CPU/TIMER_PRESCALER)
 
+#ifndef __ASSEMBLER__
+
+#include "tools/atmega8_tp.h"
+
 static void timer_init()
 {
 	#if TIMER_PRESCALER == 1
@@ -59,6 +59,9 @@ inline uint8_t timer_ready(uint16_t ocr)
  and "sts" and "lds" are 2 cycles.
  
  Meh, not so sure about it now, since I have to do cli() and sei() every time since ZC interrupt uses TCNT1.
+ 
+ With COMMUTATION_INTERRUPT, run() does enable the compare A interrupt, see commutation.h. OCR1A holds
+ the commutation time then, the ZC timeout is kept in RAM.
  */
 
 // Store Absolute timer unlock time in OCR1A reg
@@ -116,7 +119,7 @@ inline void timerA_wait_ready()
 		cli();
 		tcnt = TCNT1;
 		sei();
-	} while ((ocr - tcnt) > 0);
+	} while ((int16_t)(ocr - tcnt) > 0);
 }
 
 inline void timerA_wait_until(uint16_t time)
@@ -126,7 +129,7 @@ inline void timerA_wait_until(uint16_t time)
 		cli();
 		tcnt = TCNT1;
 		sei();
-	} while (((int16_t)time - tcnt) > 0);
+	} while ((int16_t)(time - tcnt) > 0);
 }
 
 void _noinline_timerA_wait_until(uint16_t time)
@@ -157,7 +160,11 @@ static uint32_t timerAX_get()
 	t.lh.l = timer_get();
 	if ((int16_t)t.lh.l > 0 && BIS(TIFR, TOV1)) {
 		timerAX.cnt_x++;
-		SBI(TIFR, TOV1);
+		
+		// Write-one-to-clear. TIFR is out of reach of sbi, SBI() would be in/ori/out and write
+		// back every flag pending then: a PWM compare (OCF2), a commutation (OCF1A) or a capture
+		// (ICF1) would be lost with TOV1.
+		TIFR = NB(TOV1);
 	}
 	t.lh.h = timerAX.cnt_x;
 	return t.t;
@@ -191,6 +198,8 @@ uint8_t timerAX_ready()
 // |      Timer B     |
 // *------------------*
 
+// With DSHOT_TELEMETRY the compare B interrupt is enabled, a reply borrows OCR1B, see signal.h.
+
 //void timerB_set(uint16_t time)
 //{
 	//cli();
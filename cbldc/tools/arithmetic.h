@@ -6,6 +6,9 @@
  * 
  * A bit more complex arithmetic operations, hard to achieve through C code.
  * Looks like AVR-GCC doesn't know how to use "mul".
+ *
+ * Every kernel has a portable C version for the host build. They must give bit-exact
+ * results, including the overflow behaviour of the asm code.
  */ 
 
 
@@ -19,6 +22,7 @@
 // *------------------*
 
 // a = (a + b) / 2. The 17th bit from addition gets shifted into the result in division.
+#ifdef __AVR__
 #define add16_div2(a, b)\
 asm volatile (\
 	"add %A0, %A1  \n\t"\
@@ -30,15 +34,20 @@ asm volatile (\
 :\
 );\
 
+#else
+#define add16_div2(a, b) a = (uint16_t)(((uint32_t)(a) + (b)) >> 1);
+#endif
+
 __ATTR__ uint16_t sum_16_16_div2(uint16_t a, uint16_t b)
 {
-	
-	
+	add16_div2(a, b);
+	return a;
 }
 
 // result = x * f / 256
 __ATTR__ uint16_t mul_16_frac8(uint16_t x, uint8_t f)
 {
+#ifdef __AVR__
 	uint16_t result;
 	asm volatile (
 	"mul %A1, %2  \n\t"\
@@ -55,11 +64,15 @@ __ATTR__ uint16_t mul_16_frac8(uint16_t x, uint8_t f)
 	: 									// clobbered regs
 	);
 	return result;
+#else
+	return ((uint32_t)x * f) >> 8;
+#endif
 }
 
 // (signed)result = (signed)x * f / 256
 __ATTR__ int16_t mulsu_16_frac8(int16_t x, uint8_t f)
 {
+#ifdef __AVR__
 	int16_t result;
 	asm volatile (
 	"mulsu %B1, %2 \n\t"\
@@ -74,11 +87,15 @@ __ATTR__ int16_t mulsu_16_frac8(int16_t x, uint8_t f)
 	: 									// clobbered regs
 	);
 	return result;
+#else
+	return ((int32_t)x * f) >> 8;
+#endif
 }
 
 // result = x*m + x*f/256;
 __ATTR__ uint16_t mul_16_8_sum_frac8(uint16_t x, uint8_t m, uint8_t f)
 {
+#ifdef __AVR__
 	uint16_t result;
 	asm volatile (
 	// Multiply x * m and store it in "result"
@@ -103,12 +120,16 @@ __ATTR__ uint16_t mul_16_8_sum_frac8(uint16_t x, uint8_t m, uint8_t f)
 	: 									// clobbered regs
 	);
 	return result;
+#else
+	return (uint16_t)((uint32_t)x * m + (((uint32_t)x * f) >> 8));
+#endif
 }
 
 // result = x*m + x*f/256;
 // result = result > 0xFFFF? 0xFFFF : result;
 __ATTR__ uint16_t mul_16_8_sum_frac8_sat16(uint16_t x, uint8_t m, uint8_t f)
 {
+#ifdef __AVR__
 	uint16_t result;
 	asm volatile (
 	// Multiply x * m and store it in "result"
@@ -136,6 +157,12 @@ __ATTR__ uint16_t mul_16_8_sum_frac8_sat16(uint16_t x, uint8_t m, uint8_t f)
 	: 									// clobbered regs
 	);
 	return result;
+#else
+	// Only the carry out of the last addition saturates, the x*m overflow wraps like in asm.
+	uint16_t result = (uint16_t)((uint32_t)x * m + (((uint8_t)x * f) >> 8));
+	uint32_t sum = (uint32_t)result + (uint16_t)((x >> 8) * f);
+	return sum > 0xFFFF? 0xFFFF : sum;
+#endif
 }
 
 /*
@@ -212,6 +239,7 @@ __ATTR__ uint16_t mul_32_16frac24_sat16(uint32_t x, uint16_t f)
 // result = (L*l + R*r)/256
 __ATTR__ uint16_t mul16_frac8_sum_mul16_frac8(uint16_t L, uint8_t l, uint16_t R, uint8_t r)
 {
+#ifdef __AVR__
 	uint16_t result;
 	asm volatile (
 	// L * l
@@ -238,6 +266,9 @@ __ATTR__ uint16_t mul16_frac8_sum_mul16_frac8(uint16_t L, uint8_t l, uint16_t R,
 	: "r31"								// clobbered regs
 	);
 	return result;
+#else
+	return ((uint32_t)L * l + (uint32_t)R * r) >> 8;
+#endif
 }
 
 
@@ -263,6 +294,163 @@ typedef union {
 	} l_hx;
 } int24_t;
 
+#ifndef __AVR__
+// Host side: the value of x, and x set to v, both wrapping at 24 bits like the asm.
+__ATTR__ int32_t _int24_get(int24_t x)
+{
+	return (int32_t)x.l_hx.hx * 256 + x.l_hx.l;
+}
+
+__ATTR__ int24_t _int24_set(int32_t v)
+{
+	int24_t x;
+	x.l_hx.l = (uint8_t)v;
+	x.l_hx.hx = (int16_t)(uint16_t)(v >> 8);
+	return x;
+}
+#endif
+
+// result = a + b
+__ATTR__ int24_t add24_24(int24_t a, int24_t b)
+{
+#ifdef __AVR__
+	asm volatile (
+	"add %0, %3  \n\t"\
+	"adc %1, %4  \n\t"\
+	"adc %2, %5  \n\t"\
+	: "+r"(a.l_h_x.l), "+r"(a.l_h_x.h), "+r"(a.l_h_x.x)\
+	: "r"(b.l_h_x.l), "r"(b.l_h_x.h), "r"(b.l_h_x.x)\
+	:\
+	);
+	return a;
+#else
+	return _int24_set(_int24_get(a) + _int24_get(b));
+#endif
+}
+
+// result = a + (signed)x * m / 256, where a has 8 fraction bits, so x*m is added as it is
+__ATTR__ int24_t add24_mulsu_16_frac8(int24_t a, int16_t x, uint8_t m)
+{
+#ifdef __AVR__
+	asm volatile (
+	"mulsu %B3, %4  \n\t"\
+	"add %1, r0     \n\t"\
+	"adc %2, r1     \n\t"\
+	"mul %A3, %4    \n\t"\
+	"add %0, r0     \n\t"\
+	"adc %1, r1     \n\t"\
+	"clr r1         \n\t"\
+	"adc %2, r1     \n\t"\
+	: "+r"(a.l_h_x.l), "+r"(a.l_h_x.h), "+r"(a.l_h_x.x)\
+	: "a"(x), "a"(m)\
+	:\
+	);
+	return a;
+#else
+	return _int24_set(_int24_get(a) + (int32_t)x * m);
+#endif
+}
+
+
+// *------------------*
+// |  float rounding  |
+// *------------------*
+
+/* Positive numbers held the way a float holds them, m * 2^e with 24 bits of m, the top one set.
+The setup maths (calculate_globals(), governor_init()) used to be floats. These give the very same
+results in integers, every operation rounded to nearest even like the float one, so the soft-float
+library stays out of the image. Zero is m = 0, there are no infinities: callers keep in range. */
+typedef struct {
+	uint32_t m;
+	int8_t e;
+} ufloat;
+
+// Rounds q * 2^e, at least 25 bits, to 24. sticky tells if anything below q was left out.
+static ufloat _uf_round(uint32_t q, uint8_t sticky, int8_t e)
+{
+	while (q >= 1UL<<25) {
+		sticky |= q & 1;
+		q >>= 1;
+		e++;
+	}
+	uint8_t half = q & 1;
+	q >>= 1;
+	e++;
+	if (half && (sticky || (q & 1))) q++;
+	if (q >= 1UL<<24) {						// Rounded up to the next power of 2
+		q >>= 1;
+		e++;
+	}
+	return (ufloat){q, e};
+}
+
+// result = a / b, b below 2^31. uf_div(a, 1) is the float of a.
+static ufloat uf_div(uint32_t a, uint32_t b)
+{
+	uint32_t q = 0, r = 0;
+	int8_t e = 32;							// Bits of a yet to come down
+	if (!a) return (ufloat){0, 0};
+	// Long division, one bit a turn, until 25 bits of quotient
+	while (q < 1UL<<24) {
+		r <<= 1;
+		if (e > 0) {
+			if (a & 0x80000000) r |= 1;
+			a <<= 1;
+		}
+		e--;
+		q <<= 1;
+		if (r >= b) {
+			r -= b;
+			q |= 1;
+		}
+	}
+	return _uf_round(q, r || a, e);
+}
+
+// result = x * y
+static ufloat uf_mul(ufloat x, ufloat y)
+{
+	uint32_t acc = 0;
+	uint8_t sticky = 0, i;
+	if (!x.m || !y.m) return (ufloat){0, 0};
+	// Shift and add over the 24 bits of y, the low 22 shifted out, the 48 bit product keeps 26
+	for (i = 0; i < 24; i++) {
+		if (y.m & 1) acc += x.m;
+		y.m >>= 1;
+		if (i < 22) {
+			sticky |= acc & 1;
+			acc >>= 1;
+		}
+		else x.m <<= 1;
+	}
+	return _uf_round(acc, sticky, x.e + y.e + 22);
+}
+
+// result = x * 2^k
+__ATTR__ ufloat uf_ldexp(ufloat x, int8_t k)
+{
+	x.e += k;
+	return x;
+}
+
+// A float constant, from its bits, so no float maths is compiled in
+__ATTR__ ufloat uf_const(float f)
+{
+	union {
+		float f;
+		uint32_t u;
+	} bits = {f};
+	return (ufloat){(bits.u & 0x7FFFFF) | 0x800000, (int8_t)(((bits.u >> 23) & 0xFF) - 150)};
+}
+
+// result = x, truncated like a float to integer conversion, x below 2^32
+static uint32_t uf_int(ufloat x)
+{
+	if (x.e >= 0) return x.m << x.e;
+	if (x.e <= -24) return 0;
+	return x.m >> -x.e;
+}
+
 /*
 
 // (signed)result = (signed)x * m